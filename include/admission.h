@@ -0,0 +1,46 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+// A train waiting for or holding a slot. The fields up to waited_us are set
+// by admission_acquire; the rest is private to admission.c.
+struct TrainGrant {
+  int ifindex;      // interface the train arrives on
+  int port;         // UDP port of its receiver
+  long rate_kbps;   // rate it is sent at
+  long start_in_us; // time left until the slot starts once granted
+  long waited_us;   // time it waited for the slot
+  struct TrainGrant *next;
+};
+
+// Train admission control of a server. Control sessions are served
+// concurrently, but every timed train (the two trains of a measurement, a
+// sweep cell or a warm-up round) is first granted a slot on the interface it
+// arrives on. Trains of an interface are granted in arrival order while
+// their rates add up to at most budget_kbps; a train that does not fit next
+// to the others waits until they are done and is granted the interface alone
+// if it exceeds the budget on its own. With a budget of 0 every train has its
+// interface to itself. Trains to the same UDP port never overlap, as their
+// receivers would share the port. A slot starts guard_ms after the previous
+// train of the interface was released, so queues left by one train drain
+// before the dispersion of the next one is measured.
+struct Admission;
+
+// Opens the admission control of a server
+struct Admission *admission_open(int budget_kbps, int guard_ms);
+
+// Returns the index of the interface owning the local address of a connected
+// socket, i.e. the one its peer's trains arrive on, or 0 if it is unknown
+int admission_interface(int sock_fd);
+
+// Waits until a train of rate_kbps to port may use ifindex and grants it a
+// slot starting grant->start_in_us later
+void admission_acquire(struct Admission *admission, int ifindex, int port,
+                       long rate_kbps, struct TrainGrant *grant);
+
+// Ends the slot of a granted train once it was received
+void admission_release(struct Admission *admission, struct TrainGrant *grant);
+
+// Frees the admission control, once no session uses it
+void admission_close(struct Admission *admission);
+
+#endif // ADMISSION_H
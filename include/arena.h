@@ -0,0 +1,52 @@
+#include <stddef.h>
+#ifndef ARENA_H
+#define ARENA_H
+
+// Alignment of every block carved from an arena (a cache line, so buffers of
+// different threads never share one)
+#define ARENA_ALIGN 64
+
+// Size of an explicit hugepage backing an arena
+#define ARENA_HUGEPAGE_SIZE (2UL * 1024 * 1024)
+
+// Size a block of size bytes takes in an arena
+#define ARENA_BLOCK(size)                                                      \
+  (((size_t)(size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Buffer of a raw socket: large enough for any IPv4 datagram
+#define PACKET_BUFFER_SIZE 65535
+
+// Memory of one measurement session. It is sized from the config and mapped
+// (and faulted in) once, before anything is timed, and every probe buffer of
+// the session is carved from it with a bump pointer, so no buffer is
+// allocated in a loop, the memory a session takes is known up front and large
+// payloads never land on a thread's stack. Blocks are zeroed when carved and
+// are never freed one by one: arena_reset gives back everything carved since
+// a mark, arena_close the whole arena. Carving is not thread-safe; each
+// session carves its buffers from the thread that sets it up.
+struct Arena {
+  char *base;
+  size_t size;
+  size_t used;
+  int hugepages; // 1 if backed by explicit hugepages
+};
+
+// Maps an arena of at least size bytes, from explicit hugepages if hugepages
+// is set and some are reserved (vm.nr_hugepages), from regular pages
+// otherwise. Returns CD_OK or CD_ERR_RESOURCE.
+int arena_open(struct Arena *arena, size_t size, int hugepages);
+
+// Carves a zeroed block of size bytes. Returns NULL (and prints why) if the
+// arena is exhausted, which means it was sized too small for its session.
+void *arena_alloc(struct Arena *arena, size_t size);
+
+// Marks the current end of the carved blocks
+size_t arena_mark(struct Arena *arena);
+
+// Gives back the blocks carved since mark
+void arena_reset(struct Arena *arena, size_t mark);
+
+// Unmaps an arena
+void arena_close(struct Arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,52 @@
+#include "config.h"
+#include <stdint.h>
+#ifndef CACHE_H
+#define CACHE_H
+
+// File shared by all compdetect invocations when cache_path is not set
+#define CACHE_DEFAULT_PATH "/tmp/compdetect.cache"
+
+// Entries of the cache file and longest verdict an entry can hold
+#define CACHE_SLOTS 512
+#define CACHE_VERDICT_MAX 160
+
+// Slots probed from the home slot of a key before the oldest one is evicted
+#define CACHE_PROBE_SLOTS 8
+
+// Path a verdict is cached for. Addresses are in network byte order.
+struct CacheKey {
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint16_t src_port;
+  uint16_t dst_port;
+  int32_t payload_size;
+};
+
+// Verdict cache in a memory-mapped file. Concurrent processes share it:
+// lookups take a shared flock and stores an exclusive one, so a lookup costs
+// a few microseconds and never sees a half-written entry.
+struct VerdictCache;
+
+// Maps the cache file at path, creating (or resetting, if it has another
+// layout) it when needed. Returns NULL if the file could not be mapped.
+struct VerdictCache *cache_open(const char *path);
+
+// Fills the key of the measurement a client config describes. The source
+// address is the one the kernel picks to reach server_ip_addr. Returns -1 if
+// it could not be found.
+int cache_key(struct CacheKey *key, struct Config *config);
+
+// Copies the verdict cached for key into verdict if it is at most ttl_s
+// seconds old and stores its age in age_s. Returns 1 on a hit, 0 on a miss.
+int cache_lookup(struct VerdictCache *cache, struct CacheKey *key, int ttl_s,
+                 char *verdict, int verdict_size, long *age_s);
+
+// Caches a verdict for key, replacing an older one for the same key or else
+// the oldest entry among the probed slots
+void cache_store(struct VerdictCache *cache, struct CacheKey *key,
+                 const char *verdict);
+
+// Unmaps the cache file
+void cache_close(struct VerdictCache *cache);
+
+#endif // CACHE_H
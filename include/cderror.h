@@ -0,0 +1,18 @@
+#ifndef CDERROR_H
+#define CDERROR_H
+
+// Error codes returned by the phases of every mode instead of exiting the
+// process, so that they can run inside a long-lived agent (see compdetect.h).
+// Phases print the cause with perror before returning one of them.
+#define CD_OK 0
+#define CD_ERR_CONFIG -1    // the configuration cannot be measured
+#define CD_ERR_SOCKET -2    // a socket could not be created, set up or bound
+#define CD_ERR_CONNECT -3   // the control session with the peer failed
+#define CD_ERR_PROTOCOL -4  // the peer did not follow the control protocol
+#define CD_ERR_RESOURCE -5  // out of memory, threads or file descriptors
+#define CD_ERR_NO_RESULT -6 // the server sent no verdict
+
+// Returns a short description of an error code
+const char *cd_strerror(int error);
+
+#endif // CDERROR_H
@@ -1,7 +1,25 @@
+#include "cache.h"
 #include "config.h"
+#ifndef CLIENT_H
+#define CLIENT_H
+
+// Outcome of a client measurement
+struct ClientResult {
+  char verdict[CACHE_VERDICT_MAX]; // verdict of the server, empty in a sweep
+  long cached_age_s;               // age of a cached verdict, -1 if measured
+};
+
+// Measures the path to the server of config without printing the verdict:
+// pre-probing, then the sweep or the warm-up, probing and post-probing phases,
+// unless the verdict cache holds a fresh verdict. Safe to run in several
+// threads at once as long as their configs use distinct src_port_udp ranges.
+// Returns CD_OK or an error code of cderror.h.
+int client_measure(struct Config *config, struct ClientResult *result);
 
 // The run_client function is responsible for running the client component of
 // the network traffic analysis tool. It is expected to initiate the handshake
 // with the server, exchange packets, and perform analysis on the received
-// responses.
-void run_client(struct Config *config);
+// responses. Returns CD_OK or an error code of cderror.h.
+int run_client(struct Config *config);
+
+#endif // CLIENT_H
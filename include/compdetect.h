@@ -0,0 +1,48 @@
+#include "cache.h"
+#include "cderror.h"
+#include "config.h"
+#include "ring.h"
+#ifndef COMPDETECT_H
+#define COMPDETECT_H
+
+// Returned by cd_poll and cd_result while a measurement is running
+#define CD_PENDING 1
+
+// Outcome of a finished client measurement
+struct CdResult {
+  int verdict; // RESULT_NONE, RESULT_COMPRESSION, RESULT_ABORTED or
+               // RESULT_FAILED (no verdict, e.g. a sweep)
+  char text[CACHE_VERDICT_MAX]; // verdict as the client prints it
+  long cached_age_s;            // age of a cached verdict, -1 if measured
+};
+
+// A client measurement started with cd_start
+struct CdMeasurement;
+
+// Prepares the process for measurements: picks the timestamp source once, so
+// later measurements do not recalibrate it. Call it before the first
+// cd_start. Configs are set up with init_config (and parse_config) as usual.
+void cd_init(int use_tsc);
+
+// Starts a client measurement of config in a thread of its own and returns
+// right away. The config is copied, but the strings it points to must outlive
+// the measurement. Measurements in flight at once need distinct source port
+// ranges (src_port_udp to src_port_udp + sender_threads - 1). Returns NULL and
+// sets *error if the measurement could not be started.
+struct CdMeasurement *cd_start(const struct Config *config, int *error);
+
+// Descriptor that becomes readable once the measurement finished, to wait on
+// many measurements with poll or epoll
+int cd_fd(struct CdMeasurement *measurement);
+
+// Returns CD_PENDING while the measurement runs, then CD_OK or its error code
+int cd_poll(struct CdMeasurement *measurement);
+
+// Copies the outcome of a finished measurement into result. Returns what
+// cd_poll returns; result is only filled on CD_OK.
+int cd_result(struct CdMeasurement *measurement, struct CdResult *result);
+
+// Waits until the measurement finished and releases it
+void cd_free(struct CdMeasurement *measurement);
+
+#endif // COMPDETECT_H
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <yaml.h>
 #ifndef CONFIG_H
 #define CONFIG_H
@@ -5,6 +6,37 @@
 // Possible requests types between client / server
 #define SHUTDOWN_RQ 0x01
 #define CONFIG_FILE_RQ 0x10
+#define SWEEP_CELL_RQ 0x20
+#define SWEEP_DONE_RQ 0x21
+#define WARMUP_TRAIN_RQ 0x30
+#define WARMUP_DONE_RQ 0x31
+#define ABORT_RQ 0x41
+#define TRAIN_SLOT_RQ 0x50
+#define RESULT_RQ 0x60
+
+// Frame streamed by the server over the control session while it receives
+// the timed trains
+#define PROGRESS_FRAME 0x40
+
+// Reasons of an ABORT_RQ
+#define ABORT_DECIDED 1 // the verdict can no longer change
+#define ABORT_BROKEN 2  // the path loses too many packets
+
+// Verdicts that start the result the server sends after the probing phase
+#define VERDICT_COMPRESSION "Compression detected!"
+#define VERDICT_NONE "No compression was detected."
+#define VERDICT_ABORTED "Measurement aborted, path is losing packets."
+
+// Reply of the server once it is ready to receive the train of a sweep cell
+// (or of a warm-up round)
+#define SWEEP_READY 0x22
+
+// Reply of the server to TRAIN_SLOT_RQ, followed by a TrainSlot, once the
+// timed trains of the client were granted a slot (see admission.h)
+#define TRAIN_SLOT 0x51
+
+// Maximum number of values in each list of a parameter sweep
+#define SWEEP_MAX 16
 
 // Config struct and methods
 struct Config {
@@ -20,6 +52,133 @@ struct Config {
   int udp_train_size;
   int udp_ttl;
   int rst_timeout_s;
+  int inter_packet_delay_us; // delay between packets of each sender thread
+  int sender_threads;        // client threads (and sockets) per train
+  int receiver_shards;       // server SO_REUSEPORT receiver threads
+  int txtime;                // 1 to pace trains in the qdisc with SO_TXTIME
+  int gso_segments;          // packets coalesced per UDP_SEGMENT send
+  // Parameter sweep: every payload size is tested with every entropy fraction
+  // over one control session. Both lists empty means a regular measurement.
+  int sweep_payload_sizes[SWEEP_MAX];
+  int sweep_payload_count;
+  double sweep_entropy[SWEEP_MAX];
+  int sweep_entropy_count;
+  // Warm-up: trains sent before the timed trains to find the highest rate the
+  // path sustains without loss (see rate.h). 0 trains disables it.
+  int warmup_trains;
+  int warmup_train_size;
+  int warmup_rate_step_pps; // additive increase after a lossless train
+  // Untimed packets every probe socket sends before the first timed train
+  // (see prime.h). 0 only prefaults and locks the buffers.
+  int prime_packets;
+  // Back the session arena of the probe buffers with explicit hugepages
+  // (see arena.h), falling back to regular pages if none are reserved
+  int arena_hugepages;
+  // Live progress of the timed trains over the control session
+  int progress_interval_ms; // 0 disables progress frames and aborts
+  int abort_loss_percent;   // low-train loss that aborts the measurement
+  // Standalone interleaving: pairs of short low/high sub-trains, each between
+  // its own SYN markers. 0 pairs keeps the single low then high sequence.
+  int interleave_pairs;
+  int sub_train_size;    // packets per sub-train
+  int interleave_gap_ms; // minimum gap between sub-trains
+  // Standalone intra-train markers: an extra SYN every marker_interval packets
+  // of each train, each to its own closed port from marker_port_base (0 for
+  // the port after dst_port_tcp_tsyn). 0 packets disables them.
+  int marker_interval;
+  int marker_port_base;
+  // Standalone hop sweep (see hops.h): one pass measures every TTL from
+  // hop_ttl_min to hop_ttl_max. 0 for hop_ttl_max disables it.
+  int hop_ttl_min;
+  int hop_ttl_max;
+  // Verdict cache of the client (see cache.h). 0 seconds disables it.
+  int cache_ttl_s;
+  char *cache_path;
+  int cache_force; // set by -f: measure even if a fresh verdict is cached
+  // Shared-memory ring finished measurements are published to (see ring.h),
+  // NULL to publish nothing
+  char *result_ring;
+  // Scheduler mode (see scheduler.h)
+  char *targets_file;
+  int measure_period_s;      // default period of a target
+  int period_jitter_percent; // uniform jitter of every period
+  int scheduler_workers;     // measurements running at once
+  int global_budget_kbps;    // probe traffic of all targets, 0 = no limit
+  int destination_budget_kbps; // probe traffic per server, 0 = no limit
+  int scheduler_duration_s;    // 0 runs until SIGINT/SIGTERM
+  // Realtime profile (see realtime.h). CPUs are -1 when the role is not pinned
+  int rt_sender_cpu;
+  int rt_receiver_cpu;
+  int rt_rst_cpu;
+  int rt_fifo_priority; // 0 keeps SCHED_OTHER, 1-99 switches to SCHED_FIFO
+  int rt_mlock;
+  int tsc; // 1 to timestamp with the TSC when it is invariant (see tsc.h)
+  int perf; // 1 to profile the send and receive loops (see perf.h)
+  int busy_poll_us; // > 0 spins the receive loops (see sockbuf.h), 0 sleeps
+  // AF_XDP data path of the timed trains (see xdp.h): XDP_OFF, XDP_GENERIC
+  // or XDP_NATIVE. The server steers the probe port of xdp_interface into
+  // it; the client sends through the interface of the route to the server.
+  int xdp;
+  char *xdp_interface;
+  // Concurrent sessions of the server (see admission.h). 0 serves a single
+  // measurement and exits.
+  int concurrent_sessions;
+  int interface_budget_kbps; // trains per interface, 0 = one at a time
+  int admission_guard_ms;    // idle time between trains of an interface
+};
+
+// One cell of a parameter sweep, sent by the client before each train
+struct SweepCell {
+  int payload_size;
+  double entropy; // fraction of each payload filled with random bytes
+  int train_size;
+  int train_id;
+};
+
+// Server's measurement of one sweep cell
+struct SweepResult {
+  int received;
+  int lost;
+  int reordered;
+  int kernel_drops; // lost packets the server kernel dropped (SO_RXQ_OVFL)
+  long dispersion_us;
+};
+
+// One warm-up train, announced by the client before it is sent
+struct WarmupTrain {
+  int train_id;
+  int train_size;
+  int rate_pps; // rate the train is sent at
+};
+
+// Server's feedback on one warm-up train
+struct WarmupFeedback {
+  int received;
+  int lost;
+  int highest_packet_id; // -1 if nothing arrived
+  int kernel_drops;
+  long dispersion_us;
+};
+
+// Slot of the timed trains of a measurement
+struct TrainSlot {
+  uint32_t session_id; // sent back with RESULT_RQ to fetch the verdict
+  long start_in_us;    // time left until the slot starts
+  long waited_us;      // time the trains waited for other sessions' trains
+};
+
+// Progress of a timed train, sent every progress_interval_ms and once more
+// when the train ends
+struct ProgressFrame {
+  int train_id;
+  int received;     // packets received so far
+  int lost;         // packets never received, once done
+  int done;         // 1 once the server stopped waiting for the train
+  long elapsed_us;  // from the first to the latest arrival
+  long mean_gap_us; // running inter-arrival statistics
+  long max_gap_us;
+  long delta_us; // provisional delta_high - delta_low, 0 before the high train
+  int decided;   // 1 if the verdict can no longer change
 };
 
 // Initializes a Config struct with default values
@@ -35,4 +194,9 @@ void free_config(struct Config *config);
 // Prints the values in a Config struct
 void print_config(struct Config *config);
 
+// Hash of the parameters that shape a measurement (ports, sizes, pacing,
+// sweep, warm-up and interleaving), so results of the same setup can be
+// grouped. Strings are left out as they are not valid in a received config.
+uint64_t config_hash(struct Config *config);
+
 #endif // CONFIG_H
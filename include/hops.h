@@ -0,0 +1,28 @@
+#include "config.h"
+#include "standalone.h"
+#include "txtime.h"
+#include <stddef.h>
+#include <stdint.h>
+#ifndef HOPS_H
+#define HOPS_H
+
+// Largest number of TTLs of one hop sweep
+#define MAX_HOPS 64
+
+// The run_hop_sweep function localizes the compressing hop in a single pass.
+// A low-entropy and, after a pause, a high-entropy train are sent at udp_ttl,
+// each bracketed by a head and a tail SYN for every TTL from hop_ttl_min to
+// hop_ttl_max, every SYN to its own closed port. The router at hop h answers
+// the SYNs of TTL h with ICMP time exceeded (the destination, once reached,
+// with an RST); one listener captures both on raw sockets and matches them to
+// their SYN by the port, so the time between the head and tail answers is the
+// dispersion of the train as seen at hop h. The first hop whose high - low
+// difference exceeds THRESHOLD follows the compressing link. The trains and
+// SYNs are sent from sender. Returns CD_OK or an error code.
+int run_hop_sweep(struct Config *config, struct TrainSender *sender,
+                  struct TxTime *txtime, int64_t started_ns);
+
+// Bytes run_hop_sweep carves from the arena of its sender
+size_t hop_sweep_size(void);
+
+#endif // HOPS_H
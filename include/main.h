@@ -1,6 +1,7 @@
 #define CLIENT_APP "client"         // name of client application
 #define SERVER_APP "server"         // name of server application
 #define STANDALONE_APP "standalone" // name of standalone application
+#define SCHEDULER_APP "scheduler"   // name of fleet scheduler application
 
 // Message instructing the user to run the program
 #define RUN_PROGRAM_MSG                                                        \
@@ -12,7 +13,7 @@
   "COMPDETECT - Detect network compression between a source and a "            \
   "destination\n\n"                                                            \
   "SYNOPSIS\n"                                                                 \
-  "  compdetect <yaml_file> [-v] \n\n"                                         \
+  "  compdetect <yaml_file> [-v] [-f]\n\n"                                     \
   "DESCRIPTION\n"                                                              \
   "  Compdetect is a program that detects network compression between a "      \
   "source and a\n"                                                             \
@@ -29,5 +30,9 @@
   "  -v\n"                                                                     \
   "    Run the program in verbose mode. This will print log messages while "   \
   "running.\n\n"                                                               \
+  "  -f\n"                                                                     \
+  "    Force a fresh measurement even if the verdict cache (cache_ttl_s) "     \
+  "holds\n"                                                                    \
+  "    a verdict for the path.\n\n"                                            \
   "  -h\n"                                                                     \
   "    Display the help message.\n"
@@ -0,0 +1,56 @@
+#include <stdint.h>
+#ifndef PERF_H
+#define PERF_H
+
+// Events counted around the send and receive loops
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_CONTEXT_SWITCHES,
+  PERF_PAGE_FAULTS,
+  PERF_EVENTS
+};
+
+// perf_event_open counters of one thread, opened as a single group so that
+// they are started, stopped and read with one syscall each
+struct PerfCounters {
+  int leader; // fd of the group leader, -1 if nothing could be opened
+  int fd[PERF_EVENTS];
+  int slot[PERF_EVENTS]; // position of each event in the group read, or -1
+  int opened;            // events in the group
+};
+
+// Counts of the profiled sections of a loop, summed over its threads and
+// runs. An event the host cannot count stays at -1.
+struct PerfSample {
+  int64_t count[PERF_EVENTS];
+};
+
+// Opens the counters of the calling thread, disabled. With enabled unset (the
+// config's perf option) nothing is opened. Events the kernel refuses (no
+// hardware counters in a VM, perf_event_paranoid) are skipped with a warning;
+// kernel-mode counting is dropped if it is not allowed. Returns the number
+// of events opened.
+int perf_open(struct PerfCounters *counters, int enabled);
+
+// Resets and starts the counters, right before a timed loop
+void perf_start(struct PerfCounters *counters);
+
+// Stops the counters and adds their counts (scaled if the kernel had to
+// multiplex them) to sample
+void perf_stop(struct PerfCounters *counters, struct PerfSample *sample);
+
+// Closes the counters
+void perf_close(struct PerfCounters *counters);
+
+// Clears a sample before its first perf_stop
+void perf_sample_init(struct PerfSample *sample);
+
+// Adds the counts of one sample to another, e.g. of several threads
+void perf_sample_add(struct PerfSample *sum, struct PerfSample *sample);
+
+// Prints the counts of a loop per packet it handled
+void perf_report(const char *loop, struct PerfSample *sample, long packets);
+
+#endif // PERF_H
@@ -0,0 +1,54 @@
+#include <netinet/in.h>
+#include <stddef.h>
+#ifndef PRIME_H
+#define PRIME_H
+
+// Train id of the untimed priming packets. Receivers ignore them, as it is
+// never one of the trains they wait for.
+#define PRIME_TRAIN_ID 0xffff
+
+// Time left after the priming packets for the next hop to be resolved and
+// for the packets queued behind its resolution to leave
+#define PRIME_SETTLE_US 2000
+
+// Sockets whose pending errors are cleared once the priming settled
+#define PRIME_MAX_SOCKETS 64
+
+// Priming stage, run once every socket and buffer of the timed trains is set
+// up and before the first of them. The first packet towards a destination
+// pays for the neighbour resolution of the next hop and the route lookup, and
+// the first write to a buffer for its page faults; priming takes both out of
+// the first timed train by sending a few untimed packets on every socket and
+// by prefaulting and locking every buffer. Its cost is reported on its own,
+// apart from the trains.
+struct Priming {
+  long long started_ns;
+  long faults; // page faults of the process when the stage started
+  int packets;
+  int sockets[PRIME_MAX_SOCKETS]; // connected sockets primed
+  int socket_count;
+  int buffers;
+  size_t locked_bytes;
+  int lock_failures; // buffers mlock refused (RLIMIT_MEMLOCK)
+};
+
+// Starts the priming stage
+void prime_begin(struct Priming *priming);
+
+// Prefaults a buffer and locks it into RAM
+void prime_buffer(struct Priming *priming, void *buf, size_t len);
+
+// Sends packets untimed packets of payload_size bytes from payload (whose
+// probe header is overwritten) on a socket, to dst or, if dst is NULL, to the
+// address the socket is connected to
+void prime_socket(struct Priming *priming, int sock_fd,
+                  const struct sockaddr_in *dst, char *payload,
+                  int payload_size, int packets);
+
+// Waits for the priming packets to settle, clears the errors their ICMP
+// answers left on connected sockets (a closed port would otherwise fail the
+// first send of the train with ECONNREFUSED) and logs the cost of the stage
+// under tag
+void prime_end(struct Priming *priming, const char *tag);
+
+#endif // PRIME_H
@@ -0,0 +1,74 @@
+#include <arpa/inet.h>
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef PROBE_H
+#define PROBE_H
+
+// Train ids of the two trains of a measurement. Sweep cells use their index.
+#define LOW_TRAIN_ID 0
+#define HIGH_TRAIN_ID 1
+
+// Train id of the first warm-up train; warm-up train r uses this + r
+#define WARMUP_FIRST_TRAIN_ID 2
+
+// Version of the probe header (1 was a 16-bit packet id and a train id without
+// a version field, 2 had no send timestamp). Receivers ignore packets of other
+// versions.
+#define PROBE_VERSION 3
+
+// Header at the start of every UDP probe payload, in network byte order. The
+// train id lets the receiver tell the trains apart instead of relying on the
+// order in which packets arrive; the 32-bit sequence number lets trains grow
+// well beyond 65535 packets. send_ns is the sender's clock when the packet
+// was handed to the kernel (or its launch time when paced by the kernel), 0 if
+// the sender does not stamp its packets. Only differences between the stamps
+// of one sender are meaningful, so the two hosts need no synchronized clocks.
+struct ProbeHeader {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t train_id;
+  uint32_t seq;
+  uint64_t send_ns;
+};
+
+// Smallest payload that can carry the probe header
+#define PROBE_HEADER_SIZE ((int)sizeof(struct ProbeHeader))
+
+// Writes the probe header at the start of a payload
+static inline void write_probe_header(char *payload, int train_id,
+                                      uint32_t seq, uint64_t send_ns) {
+  struct ProbeHeader header;
+  header.version = PROBE_VERSION;
+  header.reserved = 0;
+  header.train_id = htons((uint16_t)train_id);
+  header.seq = htonl(seq);
+  header.send_ns = htobe64(send_ns);
+  memcpy(payload, &header, sizeof(header));
+}
+
+// Overwrites the send timestamp of a payload whose header is already written,
+// right before it is sent
+static inline void stamp_probe(char *payload, uint64_t send_ns) {
+  uint64_t stamp = htobe64(send_ns);
+  memcpy(payload + offsetof(struct ProbeHeader, send_ns), &stamp,
+         sizeof(stamp));
+}
+
+// Reads the probe header at the start of a payload. Returns -1 if it was
+// written with another header version.
+static inline int read_probe_header(const char *payload, int *train_id,
+                                    uint32_t *seq, uint64_t *send_ns) {
+  struct ProbeHeader header;
+  memcpy(&header, payload, sizeof(header));
+  if (header.version != PROBE_VERSION) {
+    return -1;
+  }
+  *train_id = ntohs(header.train_id);
+  *seq = ntohl(header.seq);
+  *send_ns = be64toh(header.send_ns);
+  return 0;
+}
+
+#endif // PROBE_H
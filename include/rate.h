@@ -0,0 +1,38 @@
+#ifndef RATE_H
+#define RATE_H
+
+// Bounds of the rate of a probe train, in packets per second
+#define RATE_MIN_PPS 100
+#define RATE_MAX_PPS 1000000
+
+// AIMD rate controller for probe trains. After every warm-up train the server
+// reports how many packets arrived; a lossless train increases the rate by a
+// fixed step and a lossy one halves it. The result is the highest rate that
+// was sent without loss.
+struct RateController {
+  int rate_pps; // rate of the next train
+  int step_pps;
+  int best_pps; // highest lossless rate so far, 0 if none
+};
+
+// Starts the controller at initial_pps
+void rate_init(struct RateController *rate, int initial_pps, int step_pps);
+
+// Feeds back the outcome of a train sent at rate->rate_pps and picks the rate
+// of the next one
+void rate_update(struct RateController *rate, int received, int lost);
+
+// Rate the timed trains should use: the highest lossless rate or, if every
+// train lost packets, the last (decreased) rate
+int rate_result(struct RateController *rate);
+
+// Rate of a train whose senders each wait inter_packet_delay_us between
+// packets, and the inverse conversion. A delay of 0 maps to RATE_MAX_PPS.
+int delay_to_rate(int inter_packet_delay_us, int senders);
+int rate_to_delay(int rate_pps, int senders);
+
+// Bandwidth a train of rate_pps packets of payload_size bytes takes on the
+// wire, counting the IPv4 and UDP headers, in kbit/s
+long train_rate_kbps(int payload_size, int rate_pps);
+
+#endif // RATE_H
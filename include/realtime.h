@@ -0,0 +1,25 @@
+#include "config.h"
+#include <stddef.h>
+#ifndef REALTIME_H
+#define REALTIME_H
+
+// Probe thread roles that can be given their own realtime profile
+#define RT_ROLE_SENDER "sender"
+#define RT_ROLE_RECEIVER "receiver"
+#define RT_ROLE_RST "rst listener"
+
+// Returns non-zero if any option of the realtime block was set in the config
+int realtime_enabled(struct Config *config);
+
+// Applies the realtime profile to the calling thread: pins it to the given CPU
+// (if cpu >= 0), switches it to SCHED_FIFO (if rt_fifo_priority > 0) and locks
+// all process memory (if rt_mlock is set). The policy that was actually
+// granted is printed so that the run output records it. Returns 0 if every
+// requested option was granted and -1 otherwise.
+int apply_realtime_profile(struct Config *config, int cpu, const char *role);
+
+// Touches every page of a buffer so that page faults are taken before a timed
+// train rather than in the middle of it
+void prefault_buffer(void *buf, size_t len);
+
+#endif // REALTIME_H
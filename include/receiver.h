@@ -0,0 +1,119 @@
+#include "arena.h"
+#include "config.h"
+#include "perf.h"
+#include <stdint.h>
+#include <time.h>
+#ifndef RECEIVER_H
+#define RECEIVER_H
+
+// Time a train is allowed to take on top of twice its expected duration
+#define TRAIN_WINDOW_MARGIN_US 1000000L
+
+// Time packets overtaken by the tail of a train are still waited for
+#define TRAIN_TAIL_GRACE_US 20000L
+
+// Time the first packet of a train is waited for (on top of inter_time_s
+// for the trains after the first one)
+#define TRAIN_START_TIMEOUT_US 10000000L
+
+// Why the receiver stopped waiting for a train
+#define TRAIN_TAIL 0     // the tail packet (or every packet) arrived
+#define TRAIN_DEADLINE 1 // the deadline passed first
+#define TRAIN_ABORTED 2  // receiver_abort was called
+
+// Which trains a receive session expects and how long it waits for them.
+// Trains are identified by the train id of the probe header.
+struct TrainSchedule {
+  int first_train_id;
+  int trains;
+  int train_size;
+  long train_window_us;  // from the first packet of a train to its deadline
+  long start_timeout_us; // for the first packet of the first train
+  long gap_timeout_us;   // from the end of a train to the first packet of the
+                         // next one
+};
+
+// Outcome of a received train. It is computed from streaming statistics, so
+// the memory of a receiver does not grow with the train length.
+struct TrainStats {
+  int received;   // distinct packets received
+  int lost;       // packets of the train never received
+  int reordered;  // packets that arrived after a packet with a higher id
+  int duplicates; // packets received more than once (within the last 64K ids)
+  int max_packet_id; // highest packet id received, -1 if none
+  int kernel_drops; // packets dropped by the kernel (SO_RXQ_OVFL) on the
+                    // receiver sockets, part of lost
+  int ended_by;   // TRAIN_TAIL, TRAIN_DEADLINE or TRAIN_ABORTED
+  long dispersion_us;
+  double gap_mean_us; // inter-arrival time of the packets
+  double gap_stddev_us;
+  int stamped; // packets carrying the sender's send timestamp
+  long input_dispersion_us; // dispersion at the sender, from the send stamps
+  long owd_variation_us;    // largest minus smallest one-way delay
+  double owd_jitter_us;     // standard deviation of the one-way delay
+};
+
+// Live progress of a train while a schedule runs
+struct TrainReport {
+  int received;
+  int kernel_drops;
+  int done;         // 1 once the receiver moved past the train
+  long elapsed_us;  // from the first to the latest arrival
+  long mean_gap_us; // mean inter-arrival time so far
+  long max_gap_us;  // largest inter-arrival time so far
+  long send_elapsed_us; // from the first to the latest send stamp so far
+};
+
+// Receiver of probe trains. It owns one SO_REUSEPORT socket and thread per
+// shard, so it can be opened once and run for several schedules (e.g. every
+// cell of a sweep).
+struct Receiver;
+
+// Bytes of arena a receiver of max_payload_size payloads takes, including
+// the progress of runs of up to trains trains
+size_t receiver_arena_size(struct Config *config, int max_payload_size,
+                           int trains);
+
+// Opens a receiver with config->receiver_shards shards bound to port, able to
+// receive payloads up to max_payload_size bytes. The socket buffers are sized
+// to queue max_packets of them. The receiver, its payload buffers and the
+// progress of each run are carved from arena, which must outlive it. Returns
+// NULL if a socket or thread could not be created or the arena is too small.
+struct Receiver *receiver_open(struct Config *config, struct Arena *arena,
+                               int port, int max_payload_size,
+                               int max_packets);
+
+// Receives the trains of a schedule. A train ends shortly after its tail
+// packet arrives (or as soon as every packet did) or, if that never happens,
+// when its deadline passes, so lost packets cost bounded time. One TrainStats
+// per train is written to stats. Returns 0 on success and -1 on error.
+int receiver_run(struct Receiver *receiver, struct TrainSchedule *schedule,
+                 struct TrainStats *stats);
+
+// Snapshots the progress of train (an index into the running schedule) while
+// receiver_run runs in another thread. Returns the index of the train being
+// received (schedule->trains once all ended) or -1 if no schedule is running.
+int receiver_report(struct Receiver *receiver, int train,
+                    struct TrainReport *report);
+
+// Copies the perf_event_open counts of the shards over the last run (all
+// zero unless config->perf was set when the receiver was opened)
+void receiver_perf(struct Receiver *receiver, struct PerfSample *sample);
+
+// Ends the current train and skips the rest of the schedule; receiver_run
+// returns shortly after with the stats of what arrived. Can be called from
+// any thread.
+void receiver_abort(struct Receiver *receiver);
+
+// Stops the shard threads and closes the sockets. Its memory is given back
+// with the arena it was carved from.
+void receiver_close(struct Receiver *receiver);
+
+// Fills a schedule for trains sent with the given client config. The window
+// of a train is derived from its expected duration: udp_train_size packets
+// every inter_packet_delay_us spread over sender_threads senders.
+void schedule_trains(struct TrainSchedule *schedule,
+                     struct Config *client_config, int first_train_id,
+                     int trains);
+
+#endif // RECEIVER_H
@@ -0,0 +1,105 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#ifndef RING_H
+#define RING_H
+
+// Layout of the result ring. Consumers must check magic, version, slots and
+// record_size of the header before reading.
+#define RING_MAGIC 0x43445252 // "CDRR"
+#define RING_VERSION 1
+#define RING_SLOTS 1024
+
+// Verdict of a published measurement
+#define RESULT_NONE 0        // no compression was detected
+#define RESULT_COMPRESSION 1 // compression was detected
+#define RESULT_ABORTED 2     // the client aborted, the path is losing packets
+#define RESULT_FAILED 3      // not enough markers (standalone) to decide
+
+// Side that published a record
+#define RESULT_MODE_SERVER 1
+#define RESULT_MODE_STANDALONE 2
+
+// Outcome of one train of a published measurement
+struct RecordTrain {
+  int32_t received;
+  int32_t lost;
+  int32_t reordered;
+  int32_t kernel_drops;
+};
+
+// One finished measurement. Every field has a fixed size so the layout is the
+// same for any consumer on the host.
+struct ResultRecord {
+  uint64_t seq;         // index of the record in the ring, set on publish
+  uint64_t config_hash; // config_hash of the measurement parameters
+  int64_t started_ns;   // CLOCK_REALTIME
+  int64_t finished_ns;
+  int64_t delta_low_ns; // dispersion of the low-entropy train
+  int64_t delta_high_ns;
+  int64_t threshold_ns; // delta_high - delta_low above which compression
+                        // is reported
+  uint32_t peer_ip;     // client (server mode) or destination (standalone)
+                        // address, network byte order
+  uint16_t dst_port;    // UDP port of the trains
+  uint16_t mode;        // RESULT_MODE_*
+  int32_t verdict;      // RESULT_*
+  int32_t train_size;
+  int32_t payload_size;
+  int32_t reserved;
+  struct RecordTrain low;
+  struct RecordTrain high;
+};
+
+// Start of the shared-memory file
+struct RingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t record_size;
+  _Atomic uint64_t head; // records published so far
+};
+
+// Slot of the ring. seq is 2n + 1 while record n is written into the slot and
+// 2n + 2 once it is complete, so a reader can detect torn or overwritten
+// records without taking a lock.
+struct RingSlot {
+  _Atomic uint64_t seq;
+  struct ResultRecord record;
+};
+
+// Multi-producer, multi-consumer ring of ResultRecords in a POSIX
+// shared-memory file (/dev/shm/<name>). Publishers serialize on a flock,
+// which orders every descriptor of the file: other processes and, as
+// ring_publish_once opens one per record, threads of the same process. A
+// single ResultRing is not shared between threads. Consumers never lock and
+// never slow the publishers down.
+struct ResultRing;
+
+// Maps the ring called name ("/compdetect.results"), creating it if needed.
+// Returns NULL if it could not be mapped.
+struct ResultRing *ring_open(const char *name);
+
+// Publishes a record, overwriting the oldest one once the ring is full
+void ring_publish(struct ResultRing *ring, struct ResultRecord *record);
+
+// Number of records published so far; a consumer starting at this cursor
+// only sees new records
+uint64_t ring_head(struct ResultRing *ring);
+
+// Copies record *cursor into record and advances the cursor. Returns 1 if a
+// record was read, 0 if none is published yet and -1 if the consumer fell
+// more than RING_SLOTS behind, in which case the cursor is moved to the
+// oldest record still in the ring.
+int ring_read(struct ResultRing *ring, uint64_t *cursor,
+              struct ResultRecord *record);
+
+// Unmaps the ring. The shared-memory file stays for other processes.
+void ring_close(struct ResultRing *ring);
+
+// Current CLOCK_REALTIME time in nanoseconds, as stamped on records
+int64_t ring_clock_ns(void);
+
+// Opens the ring called name, publishes one record and closes it
+void ring_publish_once(const char *name, struct ResultRecord *record);
+
+#endif // RING_H
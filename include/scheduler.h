@@ -0,0 +1,34 @@
+#include "config.h"
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Length of a tick of the scheduler's timer wheel
+#define SCHEDULER_TICK_MS 100
+
+// Largest worker pool and longest line of a target list
+#define SCHEDULER_MAX_WORKERS 64
+#define TARGET_LINE_MAX 256
+
+// Burst a bandwidth budget can save up, in seconds of its rate
+#define BUDGET_BURST_S 1.0
+
+// Token bucket of a bandwidth budget. Tokens are bytes; a measurement may
+// drive the bucket negative, and the next one waits until it refilled.
+struct Budget {
+  double rate_bps; // bytes per second, 0 for no limit
+  double tokens;
+  double updated_s; // time of the last refill
+};
+
+// The run_scheduler function re-measures every target of
+// config->targets_file, a list of "server_ip pp_port_tcp [dst_port_udp
+// [period_s]]" lines, forever (or for scheduler_duration_s). Each target is
+// measured every period_s seconds, with jitter, by one of scheduler_workers
+// measurements in flight in this process (see compdetect.h). The rest of the
+// config is the client config of every measurement. Measurements are
+// postponed while they would exceed the global or per-destination bandwidth
+// budget. On SIGINT or SIGTERM it waits for the measurements in flight.
+// Returns CD_OK or an error code of cderror.h.
+int run_scheduler(struct Config *config);
+
+#endif // SCHEDULER_H
@@ -1,3 +1,10 @@
-// The run_server function takes an integer port as input and runs a server on
-// that port. Expected to implement the pre/post and probing phases
-void run_server(int port);
+#include "config.h"
+#ifndef SERVER_H
+#define SERVER_H
+
+// The run_server function takes the server config and runs a server on its
+// pp_port_tcp port. Expected to implement the pre/post and probing phases.
+// Returns CD_OK or an error code of cderror.h.
+int run_server(struct Config *config);
+
+#endif // SERVER_H
@@ -0,0 +1,40 @@
+#ifndef SOCKBUF_H
+#define SOCKBUF_H
+
+// Kernel bookkeeping (skb, headers) charged to a socket buffer per packet on
+// top of its payload
+#define SKB_OVERHEAD_BYTES 1024
+
+// Largest socket buffer requested for a train
+#define SOCKET_BUFFER_MAX (128 * 1024 * 1024)
+
+// Directions of a socket buffer
+#define SOCKBUF_RECEIVE 0
+#define SOCKBUF_SEND 1
+
+// Returns the buffer size (in bytes) needed to queue a whole train of packets
+// without drops, capped at SOCKET_BUFFER_MAX
+int train_buffer_bytes(int train_size, int payload_size);
+
+// Sizes the receive or send buffer of a socket. SO_RCVBUFFORCE/SO_SNDBUFFORCE
+// are tried first, as they are not capped by net.core.[rw]mem_max but need
+// CAP_NET_ADMIN; otherwise SO_RCVBUF/SO_SNDBUF is used. A warning is printed
+// if the kernel granted less than requested. Returns the granted size.
+int size_socket_buffer(int sock_fd, int direction, int bytes);
+
+// Prepares a socket for a receive loop that spins instead of sleeping:
+// SO_BUSY_POLL makes each read of an empty queue poll the device queue for up
+// to busy_poll_us first, and SO_PREFER_BUSY_POLL (Linux 5.11+) keeps softirq
+// processing away from the queue while the loop polls it. Raising
+// SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN; if the kernel
+// refuses either option a warning is printed and the loop still spins.
+// Returns 0 if both were set and -1 otherwise.
+int enable_busy_poll(int sock_fd, int busy_poll_us);
+
+// Spins until sock_fd has a packet queued or timeout_ns passed, peeking with
+// non-blocking reads instead of sleeping so that the packet is read (and
+// timestamped) without a wakeup. Returns 1 if a packet is queued, 0 on
+// timeout and -1 on error, like select.
+int spin_readable(int sock_fd, long long timeout_ns);
+
+#endif // SOCKBUF_H
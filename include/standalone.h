@@ -1,5 +1,84 @@
+#include "arena.h"
 #include "config.h"
+#include "txtime.h"
+#include <stdint.h>
+#include <stdio.h>
+#ifndef STANDALONE_H
+#define STANDALONE_H
+
+// 100ms in nanoseconds as fixed threshold above which compression is assumed to
+// be enabled
+#define THRESHOLD 100000000L
+
+// SYN markers sent inside a train, between its head and tail SYN. Marker k
+// (1-based) goes before packet k * interval, to port first_port + k - 1.
+struct TrainMarkers {
+  char *src_ip;
+  char *dst_ip;
+  unsigned short src_port;
+  int ttl;
+  int interval; // packets between markers, 0 for none
+  unsigned short first_port;
+  int sock; // raw socket of the SYNs
+};
+
+// What the trains and SYNs of a standalone measurement are sent from. It is
+// opened once, before the first timed train, and primed (see prime.h), so no
+// socket is created, no buffer is touched for the first time and no next hop
+// is resolved within a train. Its buffers are carved from its own arena.
+struct TrainSender {
+  int udp_sock;  // connected to the probe port of the destination
+  int syn_sock;  // raw socket (IP_HDRINCL) of the SYNs
+  char *payload; // one payload of payload_size bytes
+  int payload_size;
+  char *listen_buf; // PACKET_BUFFER_SIZE bytes for the RST/ICMP listener
+  FILE *urandom; // source of the high-entropy payloads
+  struct Arena arena;
+};
 
 // The run_standalone() function runs the program in standalone mode, sending
 // packets to a destination and analyzing the response to detect compression.
-void run_standalone(struct Config *config);
+// Returns CD_OK or an error code of cderror.h.
+int run_standalone(struct Config *config);
+
+// Opens and primes the sender of the trains of config, whose socket buffer
+// holds trains of up to train_size packets. Returns CD_OK or an error code.
+int open_train_sender(struct Config *config, int train_size,
+                      struct TrainSender *sender);
+
+// Closes the sockets and unmaps the buffers of a sender
+void close_train_sender(struct TrainSender *sender);
+
+// Checks that the consecutive ports first..last used by what fit in 1-65535,
+// as they are kept in unsigned shorts. Returns CD_OK or (after printing why)
+// CD_ERR_CONFIG.
+int check_port_range(const char *tag, const char *what, long first,
+                     long last);
+
+// Sends a TCP SYN with the given TTL on a raw socket opened by
+// open_train_sender. Returns CD_OK or CD_ERR_SOCKET.
+int send_tcp_syn_packet(int sock, char *src_ip, char *dst_ip,
+                        unsigned short src_port, unsigned short dst_port,
+                        int ttl);
+
+// Send a train of all-zero (low) or random (high) entropy UDP probes from a
+// sender, paced by inter_packet_delay_us or, with txtime enabled, by the
+// qdisc. markers (NULL for none) are sent inside the train.
+void send_udp_low_entropy_packet_train(struct TrainSender *sender,
+                                       int train_size,
+                                       int inter_packet_delay_us,
+                                       struct TxTime *txtime,
+                                       struct TrainMarkers *markers);
+void send_udp_high_entropy_packet_train(struct TrainSender *sender,
+                                        int train_size,
+                                        int inter_packet_delay_us,
+                                        struct TxTime *txtime,
+                                        struct TrainMarkers *markers);
+
+// Publishes the outcome of a standalone measurement to config->result_ring
+void publish_standalone(struct Config *config, int64_t started_ns,
+                        int verdict, int64_t delta_low_ns,
+                        int64_t delta_high_ns, int64_t threshold_ns,
+                        int train_size);
+
+#endif // STANDALONE_H
@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#ifndef TSC_H
+#define TSC_H
+
+// Length of each of the two calibration windows against CLOCK_MONOTONIC_RAW
+#define TSC_CALIBRATION_MS 10
+
+// Reads of the TSC and the clock per calibration sample
+#define TSC_SAMPLE_TRIES 16
+
+// Largest difference between the rates measured in the two windows for the
+// TSC to be considered stable
+#define TSC_MAX_SKEW_PPM 200
+
+// Conversion of TSC ticks to CLOCK_MONOTONIC nanoseconds:
+// ns = base_ns + ((tsc - base_tsc) * mult) >> 32
+struct TscClock {
+  int enabled; // 0 until tsc_init found a usable TSC
+  uint64_t base_tsc;
+  long long base_ns;
+  uint64_t mult;
+};
+
+extern struct TscClock tsc_clock;
+
+// Picks the timestamp source of the hot loops. With use_tsc set, the TSC is
+// used if the CPU reports it invariant and two calibration windows against
+// CLOCK_MONOTONIC_RAW agree on its rate; otherwise (or on other
+// architectures) timestamps fall back to clock_gettime. Call it once, before
+// any thread takes timestamps. Returns 1 if the TSC is used.
+int tsc_init(int use_tsc);
+
+// tsc_init for processes that run several measurements, possibly at once: the
+// first call picks the timestamp source and later calls return its outcome
+// without recalibrating under the timestamps of running measurements.
+int tsc_init_once(int use_tsc);
+
+// Current CLOCK_MONOTONIC time in ns. With the TSC this is one rdtsc and a
+// multiply instead of a clock_gettime call; stamps of different threads are
+// comparable as the TSC is invariant and synchronized. Stamps taken right
+// after a syscall need no rdtscp, as the syscall already serializes.
+static inline long long tsc_now_ns(void) {
+#if defined(__x86_64__)
+  if (tsc_clock.enabled) {
+    uint64_t ticks = __rdtsc() - tsc_clock.base_tsc;
+    return tsc_clock.base_ns +
+           (long long)(((unsigned __int128)ticks * tsc_clock.mult) >> 32);
+  }
+#endif
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#endif // TSC_H
@@ -0,0 +1,64 @@
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+#ifndef TXTIME_H
+#define TXTIME_H
+
+// How far ahead (in ns) of the first packet a kernel-paced train is scheduled,
+// so that every sender has queued its first packet before it is due
+#define TXTIME_LEAD_NS 5000000ULL
+
+// Largest number of segments the kernel accepts in a single UDP GSO send
+#define GSO_MAX_SEGMENTS 64
+
+// Largest UDP payload of an IPv4 datagram, which a whole GSO batch must fit in
+#define UDP_MAX_PAYLOAD 65507
+
+// Kernel-timed transmission state. Trains are handed to the kernel with a
+// launch time per send (SO_TXTIME / SCM_TXTIME) and the spacing between
+// packets is enforced by the fq or etf qdisc of the egress interface.
+struct TxTime {
+  int enabled;       // 1 if the egress qdisc supports launch times
+  clockid_t clockid; // CLOCK_MONOTONIC for fq, CLOCK_TAI for etf
+  int gso_segments;  // segments coalesced per send with UDP_SEGMENT
+  char ifname[IF_NAMESIZE];
+  char qdisc[16];
+};
+
+// Detects the egress interface towards dst_ip and whether it has an fq or etf
+// qdisc. The outcome is printed; when the qdisc cannot honour launch times
+// txtime->enabled is 0 and callers fall back to user-space pacing. Returns 0
+// if kernel pacing is available and -1 otherwise.
+int txtime_init(struct TxTime *txtime, const char *dst_ip, int gso_segments);
+
+// Segments per UDP GSO send for trains of payload_size-byte packets sent
+// inter_packet_delay_us apart: gso_segments, capped at GSO_MAX_SEGMENTS and
+// at the batches that fit in one datagram. Every segment of a batch leaves
+// at the launch time of the batch, so spaced trains (inter_packet_delay_us
+// above 0) get one packet per send and only back-to-back trains are batched.
+int txtime_segments(int gso_segments, int payload_size,
+                    int inter_packet_delay_us);
+
+// Enables SO_TXTIME on a socket. On failure kernel pacing is disabled for the
+// whole train (txtime->enabled is reset) and -1 is returned.
+int txtime_enable_socket(struct TxTime *txtime, int sock_fd);
+
+// Current time in ns on the clock the qdisc compares launch times against
+uint64_t txtime_now_ns(struct TxTime *txtime);
+
+// Sleeps until the given launch time, i.e. until the packet scheduled for it
+// has left the qdisc
+void txtime_sleep_until(struct TxTime *txtime, uint64_t launch_ns);
+
+// Sends len bytes with a launch time. If gso_size is non-zero the buffer is
+// split by the kernel into gso_size segments (UDP_SEGMENT), each becoming one
+// UDP packet. dst may be NULL for connected sockets. Returns bytes sent or -1.
+int send_udp_txtime(int sock_fd, struct sockaddr_in *dst, char *buf, int len,
+                    int gso_size, uint64_t launch_ns);
+
+// Drains the socket error queue and returns how many packets the qdisc
+// dropped because their launch time could not be met
+int txtime_drain_errors(int sock_fd);
+
+#endif // TXTIME_H
@@ -0,0 +1,49 @@
+#include <stdint.h>
+#ifndef WHEEL_H
+#define WHEEL_H
+
+// Geometry of the timer wheel: WHEEL_LEVELS levels of WHEEL_SLOTS slots. A
+// timer is kept in the level whose range covers its delay and cascades to the
+// level below when that level wraps around, so adding, removing and expiring a
+// timer cost O(1) however many timers there are.
+#define WHEEL_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 3
+
+// Longest delay of a timer, in ticks. Longer delays are clamped to it.
+#define WHEEL_MAX_TICKS ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+// Timer embedded in the object it schedules. Slots and lists of expired
+// timers are circular lists with a sentinel timer as head.
+struct WheelTimer {
+  struct WheelTimer *next;
+  struct WheelTimer *prev;
+  uint64_t expires; // tick the timer fires at
+  void *data;
+};
+
+// Hierarchical timer wheel. It knows nothing about time: the owner calls
+// wheel_tick once per tick of whatever length it picked.
+struct TimerWheel {
+  uint64_t now; // current tick
+  struct WheelTimer slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+// Initializes an empty wheel at tick 0
+void wheel_init(struct TimerWheel *wheel);
+
+// Initializes an empty list of timers (e.g. the expired list of wheel_tick)
+void wheel_list_init(struct WheelTimer *head);
+
+// Arms a timer to fire ticks ticks from now (at least 1)
+void wheel_add(struct TimerWheel *wheel, struct WheelTimer *timer,
+               uint64_t ticks);
+
+// Disarms a timer, or takes it off the list it is on
+void wheel_remove(struct WheelTimer *timer);
+
+// Advances the wheel by one tick and moves the timers that fire on it to the
+// end of the expired list
+void wheel_tick(struct TimerWheel *wheel, struct WheelTimer *expired);
+
+#endif // WHEEL_H
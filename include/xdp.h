@@ -0,0 +1,134 @@
+#include <net/if.h>
+#include <stdint.h>
+#ifndef XDP_H
+#define XDP_H
+
+// Values of the xdp config key
+#define XDP_OFF 0
+#define XDP_GENERIC 1 // SKB mode: any interface (veth, loopback namespaces),
+                      // packets are copied through an skb
+#define XDP_NATIVE 2  // driver mode: zero-copy when the NIC supports it
+
+// Size of a UMEM frame. A frame holds one whole Ethernet frame, so payloads
+// are limited to XDP_FRAME_SIZE - XDP_HEADERS_SIZE bytes.
+#define XDP_FRAME_SIZE 4096
+
+// Frames of the UMEM of a socket given to the fill ring (receiving) and to
+// the payload pool of the TX ring (sending). Both are powers of two.
+#define XDP_RX_FRAMES 2048
+#define XDP_TX_FRAMES 1024
+
+// Frames queued per TX wakeup when packets are sent back to back, and frames
+// read per RX ring access. The kernel sends up to 32 frames per wakeup in
+// copy mode.
+#define XDP_TX_BATCH 32
+#define XDP_RX_BATCH 64
+
+// Time a sender waits for the kernel to complete its queued frames
+#define XDP_DRAIN_TIMEOUT_NS 1000000000LL
+
+// Ethernet, IPv4 (without options) and UDP headers of a probe frame
+#define XDP_HEADERS_SIZE 42
+
+// Where the frames towards a destination go: the egress interface, the MAC
+// of the next hop and the addresses of the IPv4 header (network order)
+struct XdpPath {
+  int ifindex;
+  char ifname[IF_NAMESIZE];
+  uint8_t src_mac[6];
+  uint8_t dst_mac[6];
+  uint32_t src_ip;
+  uint32_t dst_ip;
+};
+
+// One received frame, pointing into the UMEM until it is released
+struct XdpFrame {
+  char *data;
+  int len;
+};
+
+// AF_XDP socket bound to one queue of an interface. Its UMEM is a single
+// mmap'd area shared by the fill and RX rings (frames the kernel writes
+// received packets to) and by the TX and completion rings (frames the sender
+// builds packets in), so a packet is never copied in user space.
+struct XdpSocket;
+
+// XDP program steering the UDP packets to one port into the AF_XDP sockets
+// of the queues they arrive on. Everything else (other ports, other
+// protocols, IPv4 options, fragments) is passed on to the kernel stack.
+struct XdpSteering;
+
+// Resolves the path towards dst_ip from the kernel routing and neighbour
+// tables. If the next hop has no neighbour entry yet, one datagram is sent
+// to dst_ip's discard port to have the kernel resolve it. Returns 0 on
+// success and -1 otherwise.
+int xdp_resolve_path(const char *dst_ip, struct XdpPath *path);
+
+// Opens an AF_XDP socket on queue of ifindex in the given mode with rx_frames
+// frames posted for receiving and tx_frames for sending (either may be 0 to
+// skip its rings). Returns NULL (and prints why) if the kernel refuses it,
+// e.g. without CAP_NET_ADMIN or if the queue does not exist.
+struct XdpSocket *xdp_open(int ifindex, int queue, int mode, int rx_frames,
+                           int tx_frames);
+
+// Descriptor of the socket, readable (poll/epoll) once frames were received
+int xdp_fd(struct XdpSocket *xsk);
+
+// Peeks up to max received frames without copying them. They stay valid
+// until xdp_rx_release. Returns the number of frames.
+int xdp_rx_peek(struct XdpSocket *xsk, struct XdpFrame *frames, int max);
+
+// Hands the frames of the last xdp_rx_peek back to the fill ring
+void xdp_rx_release(struct XdpSocket *xsk, int count);
+
+// Packets the kernel dropped because the RX or fill ring of the socket was
+// full or empty (XDP_STATISTICS)
+uint32_t xdp_rx_dropped(struct XdpSocket *xsk);
+
+// Returns a free frame of the payload pool to build a packet in, reclaiming
+// the frames of sent packets first, or NULL if every frame is in flight
+char *xdp_tx_frame(struct XdpSocket *xsk);
+
+// Queues len bytes of a frame returned by xdp_tx_frame on the TX ring
+void xdp_tx_submit(struct XdpSocket *xsk, char *frame, int len);
+
+// Has the kernel send the queued frames (a sendto when the ring asks for a
+// wakeup, which in copy mode transmits them right away)
+void xdp_tx_flush(struct XdpSocket *xsk);
+
+// Flushes and waits up to timeout_ns until every queued frame was sent.
+// Returns the number of frames still in flight.
+int xdp_tx_drain(struct XdpSocket *xsk, long long timeout_ns);
+
+// Closes the socket and unmaps its UMEM and rings
+void xdp_close(struct XdpSocket *xsk);
+
+// Writes the Ethernet, IPv4 and UDP headers of a probe frame carrying
+// payload_size bytes. The IPv4 header has DF set and an id of ip_id; the UDP
+// checksum is left at 0 (allowed over IPv4) so that nothing has to be
+// computed over the payload after its send stamp. Returns XDP_HEADERS_SIZE.
+int xdp_write_headers(char *frame, struct XdpPath *path, int src_port,
+                      int dst_port, int payload_size, uint16_t ip_id);
+
+// Finds the UDP payload of a received IPv4 frame. Returns its length and
+// points *payload at it, or -1 if the frame is not IPv4/UDP.
+int xdp_udp_payload(char *frame, int len, char **payload);
+
+// Loads the steering program for UDP port and attaches it to ifindex in the
+// given mode with room for queues sockets. The program is detached when
+// xdp_steer_close is called or the process exits. Returns NULL (and prints
+// why) on failure.
+struct XdpSteering *xdp_steer_open(int ifindex, int port, int mode,
+                                   int queues);
+
+// Steers the packets arriving on queue into xsk. Returns 0 or -1.
+int xdp_steer_add(struct XdpSteering *steering, int queue,
+                  struct XdpSocket *xsk);
+
+// Detaches and unloads the steering program
+void xdp_steer_close(struct XdpSteering *steering);
+
+// Short name of an xdp mode, for the logs
+const char *xdp_mode_name(int mode);
+
+#endif // XDP_H
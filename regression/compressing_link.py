@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+# Compressing bottleneck of the regression harness. Receives the probe trains
+# on LISTEN (host:port), compresses every payload with zlib and forwards it to
+# FORWARD (host:port) after holding it for the time the compressed payload
+# takes on a link of KBPS kbit/s, behind the packets queued before it. Low
+# entropy payloads shrink to a few bytes and cross the link at the sender's
+# pace, high entropy ones keep their size and queue up, so the server sees
+# the dispersion gap of a link that compresses. Stops on SIGTERM.
+#
+# Usage: compressing_link.py LISTEN FORWARD KBPS
+
+import select
+import signal
+import socket
+import sys
+import time
+import zlib
+from collections import deque
+
+
+def address(spec):
+    host, port = spec.rsplit(":", 1)
+    return host, int(port)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: compressing_link.py LISTEN FORWARD KBPS")
+    listen, forward = address(sys.argv[1]), address(sys.argv[2])
+    bytes_per_s = int(sys.argv[3]) * 1000 / 8
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+
+    # SO_REUSEPORT lets the link bind the probe port of its own address next
+    # to the server's wildcard receiver
+    rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    rx.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    rx.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 23)
+    rx.bind(listen)
+    tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    queue = deque()  # (departure, payload), in departure order
+    link_free = 0.0
+    while True:
+        timeout = None
+        if queue:
+            timeout = max(0.0, queue[0][0] - time.monotonic())
+        readable, _, _ = select.select([rx], [], [], timeout)
+        now = time.monotonic()
+        if readable:
+            payload = rx.recv(65535)
+            wire = len(zlib.compress(payload, 1))
+            link_free = max(now, link_free) + wire / bytes_per_s
+            queue.append((link_free, payload))
+        while queue and queue[0][0] <= now:
+            tx.sendto(queue.popleft()[1], forward)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+#!/bin/bash
+#
+# Loopback regression harness. Runs every measurement of matrix.txt (server
+# and client as child processes over 127.0.0.1) RUNS times and records, per
+# measurement:
+#   wall_s     mean wall time of a measurement (server + client)
+#   cpu_s      mean user + system CPU time of both processes
+#   pps        mean rate the server received the timed trains at
+#   agreement  fraction of runs whose verdict matched the expected one
+# and compares them against baseline.txt. Exits non-zero if a metric
+# regressed beyond the tolerance.
+#
+# A measurement whose link column is a rate (kbit/s) instead of "-" sends its
+# trains through compressing_link.py, bound to the server_ip_addr and
+# dst_port_udp of its client config (a 127.0.0.0/8 address other than
+# 127.0.0.1) and forwarding to the server on 127.0.0.1. It needs python3 and
+# is expected to detect compression, so a change that stops detecting it
+# fails the verdict agreement.
+#
+# Baselines depend on the host (CPU, kernel, load), so the stored one only
+# holds for the machine it was recorded on. On another host, build, leave the
+# machine idle and run "make regression_baseline" (or run.sh -u with the RUNS
+# you will compare with), check that every agreement is 1.00 and keep the
+# new baseline.txt for that host.
+#
+# Usage: regression/run.sh [-u]
+#   -u  write the measured metrics to baseline.txt instead of comparing
+#
+# Environment:
+#   RUNS       runs per measurement (default: 3)
+#   TOLERANCE  allowed relative regression of wall_s, cpu_s and pps
+#              (default: 0.25)
+
+cd "$(dirname "$0")" || exit 1
+
+RUNS=${RUNS:-3}
+TOLERANCE=${TOLERANCE:-0.25}
+BIN=../bin/compdetect
+OUT=out
+BASELINE=baseline.txt
+RESULTS=$OUT/results.txt
+
+# Parse the command line arguments
+while getopts "u" arg; do
+  case $arg in
+    u) update_baseline=true;;
+    *) echo "Invalid argument: $OPTARG" >&2; exit 1;;
+  esac
+done
+
+make -C .. --silent || exit 1
+mkdir -p $OUT
+echo "# name wall_s cpu_s pps agreement" > $RESULTS
+
+# Maps the client output to the verdict column of matrix.txt
+verdict_of() {
+  if grep -q "Compression detected!" "$1"; then
+    echo compression
+  elif grep -q "No compression was detected." "$1"; then
+    echo none
+  elif grep -q "Measurement aborted" "$1"; then
+    echo aborted
+  else
+    echo failed
+  fi
+}
+
+# Rate (packets/s) of the timed trains from the verbose server log
+pps_of() {
+  awk '/Received [0-9]+\/[0-9]+ (low|high)-entropy packets/ {
+         for (i = 1; i < NF; i++) if ($i == "Received") split($(i + 1), n, "/")
+         received += n[1]
+       }
+       /delta_(low|high) = / { dispersion += $NF }
+       END { printf "%.0f", (dispersion > 0 ? received * 1e6 / dispersion : 0) }' "$1"
+}
+
+# Value of a top-level key of a config
+config_value() {
+  awk -v key="$2:" '$1 == key { print $2 }' "$1"
+}
+
+# Starts the compressing link of a measurement, if it has one
+start_link() {
+  local client_config=$1 link=$2 log=$3
+  [[ $link == - ]] && return
+  local ip port
+  ip=$(config_value "$client_config" server_ip_addr)
+  port=$(config_value "$client_config" dst_port_udp)
+  ./compressing_link.py "$ip:$port" "127.0.0.1:$port" "$link" \
+    > "$log.link" 2>&1 &
+  link_pid=$!
+  sleep 0.5
+}
+
+# Stops the compressing link started by start_link
+stop_link() {
+  [[ -z $link_pid ]] && return
+  kill "$link_pid" 2> /dev/null
+  wait "$link_pid" 2> /dev/null
+  link_pid=
+}
+
+# Runs one measurement and prints "wall_s cpu_s"
+run_once() {
+  local server_config=$1 client_config=$2 log=$3
+  local TIMEFORMAT="%R %U %S"
+  { time {
+      timeout 120 $BIN "$server_config" -v < /dev/null > "$log.server" 2>&1 &
+      timeout 120 $BIN "$client_config" < /dev/null > "$log.client" 2>&1
+      wait
+    } ; } 2>&1 | awk '{ printf "%.3f %.3f\n", $1, $2 + $3 }'
+}
+
+grep -v '^#' matrix.txt | while read -r name server_config client_config expected link; do
+  [[ -z $name ]] && continue
+  wall=0; cpu=0; pps=0; agree=0
+  for run in $(seq 1 "$RUNS"); do
+    log=$OUT/$name.$run
+    start_link "$client_config" "${link:--}" "$log"
+    read -r run_wall run_cpu < <(run_once "$server_config" "$client_config" "$log")
+    stop_link
+    run_pps=$(pps_of "$log.server")
+    verdict=$(verdict_of "$log.client")
+    [[ $verdict == "$expected" ]] && agree=$((agree + 1))
+    echo "[REGRESSION] $name run $run: ${run_wall}s wall, ${run_cpu}s cpu, $run_pps pps, verdict $verdict" >&2
+    wall=$(awk -v a="$wall" -v b="$run_wall" 'BEGIN { print a + b }')
+    cpu=$(awk -v a="$cpu" -v b="$run_cpu" 'BEGIN { print a + b }')
+    pps=$(awk -v a="$pps" -v b="$run_pps" 'BEGIN { print a + b }')
+  done
+  awk -v name="$name" -v wall="$wall" -v cpu="$cpu" -v pps="$pps" \
+      -v agree="$agree" -v runs="$RUNS" 'BEGIN {
+        printf "%-14s %8.3f %8.3f %10.0f %6.2f\n", name, wall / runs,
+               cpu / runs, pps / runs, agree / runs }' >> $RESULTS
+done
+
+if [[ $update_baseline ]]; then
+  cp $RESULTS $BASELINE
+  echo "[REGRESSION] Baseline updated:"
+  cat $BASELINE
+  exit 0
+fi
+
+if [[ ! -f $BASELINE ]]; then
+  echo "[REGRESSION] [ERROR] No $BASELINE, run with -u to record one" >&2
+  exit 1
+fi
+
+# Compare every measurement against its baseline. CPU time gets 50ms of
+# absolute slack on top of the tolerance, as it is small and noisy.
+awk -v tolerance="$TOLERANCE" '
+  FNR == 1 { file++ }
+  /^#/ { next }
+  file == 1 { wall[$1] = $2; cpu[$1] = $3; pps[$1] = $4; agree[$1] = $5; next }
+  {
+    name = $1
+    if (!(name in wall)) {
+      printf "[REGRESSION] %s: no baseline, skipped\n", name
+      next
+    }
+    status = "ok"
+    if ($2 > wall[name] * (1 + tolerance)) {
+      status = "FAIL"
+      printf "[REGRESSION] %s: wall time %.3fs > baseline %.3fs\n", name, $2, wall[name]
+    }
+    if ($3 > cpu[name] * (1 + tolerance) + 0.05) {
+      status = "FAIL"
+      printf "[REGRESSION] %s: cpu time %.3fs > baseline %.3fs\n", name, $3, cpu[name]
+    }
+    if ($4 < pps[name] * (1 - tolerance)) {
+      status = "FAIL"
+      printf "[REGRESSION] %s: rate %.0f pps < baseline %.0f pps\n", name, $4, pps[name]
+    }
+    if ($5 < agree[name]) {
+      status = "FAIL"
+      printf "[REGRESSION] %s: verdict agreement %.2f < baseline %.2f\n", name, $5, agree[name]
+    }
+    printf "[REGRESSION] %-14s %s\n", name, status
+    failed += status == "FAIL"
+  }
+  END { exit failed > 0 }' $BASELINE $RESULTS
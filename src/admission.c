@@ -0,0 +1,183 @@
+#include "../include/admission.h"
+#include "../include/tsc.h"
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+// Interface trains were granted on, with the end of its last slot
+struct AdmissionInterface {
+  int ifindex;
+  long long released_ns; // 0 if no train was released yet
+  struct AdmissionInterface *next;
+};
+
+struct Admission {
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // broadcast when a train is granted or released
+  long budget_kbps;
+  long long guard_ns;
+  struct TrainGrant *waiting; // in arrival order
+  struct TrainGrant *granted;
+  struct AdmissionInterface *interfaces;
+};
+
+// Opens the admission control
+struct Admission *admission_open(int budget_kbps, int guard_ms) {
+  struct Admission *admission = calloc(1, sizeof(struct Admission));
+  if (admission == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&admission->lock, NULL);
+  pthread_cond_init(&admission->changed, NULL);
+  admission->budget_kbps = budget_kbps;
+  admission->guard_ns = (long long)guard_ms * 1000000;
+  return admission;
+}
+
+// Finds the interface owning the local address of a socket
+int admission_interface(int sock_fd) {
+  struct sockaddr_in local;
+  socklen_t len = sizeof(local);
+  if (getsockname(sock_fd, (struct sockaddr *)&local, &len) < 0) {
+    return 0;
+  }
+  struct ifaddrs *ifaddr;
+  if (getifaddrs(&ifaddr) < 0) {
+    return 0;
+  }
+  int ifindex = 0;
+  for (struct ifaddrs *ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_INET) {
+      continue;
+    }
+    struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
+    if (sin->sin_addr.s_addr == local.sin_addr.s_addr) {
+      ifindex = (int)if_nametoindex(ifa->ifa_name);
+      break;
+    }
+  }
+  freeifaddrs(ifaddr);
+  return ifindex;
+}
+
+// Returns the record of an interface, creating it on first use
+static struct AdmissionInterface *find_interface(struct Admission *admission,
+                                                 int ifindex) {
+  struct AdmissionInterface *iface = admission->interfaces;
+  for (; iface != NULL; iface = iface->next) {
+    if (iface->ifindex == ifindex) {
+      return iface;
+    }
+  }
+  iface = calloc(1, sizeof(struct AdmissionInterface));
+  if (iface != NULL) {
+    iface->ifindex = ifindex;
+    iface->next = admission->interfaces;
+    admission->interfaces = iface;
+  }
+  return iface;
+}
+
+// Unlinks a train from a list
+static void unlink_grant(struct TrainGrant **list, struct TrainGrant *grant) {
+  for (; *list != NULL; list = &(*list)->next) {
+    if (*list == grant) {
+      *list = grant->next;
+      grant->next = NULL;
+      return;
+    }
+  }
+}
+
+// Decides whether a waiting train can be granted its slot now
+static int admissible(struct Admission *admission, struct TrainGrant *grant) {
+  // first come, first served on each interface, so a fast train that does
+  // not fit is not overtaken forever by slower ones
+  for (struct TrainGrant *w = admission->waiting; w != grant; w = w->next) {
+    if (w->ifindex == grant->ifindex) {
+      return 0;
+    }
+  }
+  long rate_kbps = 0;
+  int trains = 0;
+  for (struct TrainGrant *g = admission->granted; g != NULL; g = g->next) {
+    if (g->port == grant->port) {
+      return 0;
+    }
+    if (g->ifindex == grant->ifindex) {
+      rate_kbps += g->rate_kbps;
+      trains++;
+    }
+  }
+  if (trains == 0) {
+    return 1;
+  }
+  return admission->budget_kbps > 0 &&
+         rate_kbps + grant->rate_kbps <= admission->budget_kbps;
+}
+
+// Grants a slot to a train once it is admissible
+void admission_acquire(struct Admission *admission, int ifindex, int port,
+                       long rate_kbps, struct TrainGrant *grant) {
+  long long requested_ns = tsc_now_ns();
+  memset(grant, 0, sizeof(*grant));
+  grant->ifindex = ifindex;
+  grant->port = port;
+  grant->rate_kbps = rate_kbps;
+
+  pthread_mutex_lock(&admission->lock);
+  struct TrainGrant **tail = &admission->waiting;
+  while (*tail != NULL) {
+    tail = &(*tail)->next;
+  }
+  *tail = grant;
+  while (!admissible(admission, grant)) {
+    pthread_cond_wait(&admission->changed, &admission->lock);
+  }
+  unlink_grant(&admission->waiting, grant);
+  grant->next = admission->granted;
+  admission->granted = grant;
+
+  long long now_ns = tsc_now_ns();
+  struct AdmissionInterface *iface = find_interface(admission, ifindex);
+  if (iface != NULL && iface->released_ns != 0 &&
+      iface->released_ns + admission->guard_ns > now_ns) {
+    grant->start_in_us = (iface->released_ns + admission->guard_ns - now_ns) /
+                         1000;
+  }
+  // the next waiter of the interface may fit next to this train
+  pthread_cond_broadcast(&admission->changed);
+  pthread_mutex_unlock(&admission->lock);
+  grant->waited_us = (now_ns - requested_ns) / 1000;
+}
+
+// Ends the slot of a train
+void admission_release(struct Admission *admission, struct TrainGrant *grant) {
+  pthread_mutex_lock(&admission->lock);
+  unlink_grant(&admission->granted, grant);
+  struct AdmissionInterface *iface = find_interface(admission, grant->ifindex);
+  if (iface != NULL) {
+    iface->released_ns = tsc_now_ns();
+  }
+  pthread_cond_broadcast(&admission->changed);
+  pthread_mutex_unlock(&admission->lock);
+}
+
+// Frees the admission control
+void admission_close(struct Admission *admission) {
+  if (admission == NULL) {
+    return;
+  }
+  while (admission->interfaces != NULL) {
+    struct AdmissionInterface *next = admission->interfaces->next;
+    free(admission->interfaces);
+    admission->interfaces = next;
+  }
+  pthread_cond_destroy(&admission->changed);
+  pthread_mutex_destroy(&admission->lock);
+  free(admission);
+}
@@ -0,0 +1,79 @@
+#include "../include/arena.h"
+#include "../include/cderror.h"
+#include "../include/logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Maps and faults in the arena
+int arena_open(struct Arena *arena, size_t size, int hugepages) {
+  memset(arena, 0, sizeof(*arena));
+  void *base = MAP_FAILED;
+  if (hugepages) {
+    size_t huge_size =
+        (size + ARENA_HUGEPAGE_SIZE - 1) & ~(ARENA_HUGEPAGE_SIZE - 1);
+    if (huge_size == 0) {
+      huge_size = ARENA_HUGEPAGE_SIZE;
+    }
+    base = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1,
+                0);
+    if (base != MAP_FAILED) {
+      arena->size = huge_size;
+      arena->hugepages = 1;
+    } else {
+      logger("[ARENA] No hugepages available, using regular pages");
+    }
+  }
+  if (base == MAP_FAILED) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    arena->size = (size + page_size - 1) / page_size * page_size;
+    if (arena->size == 0) {
+      arena->size = page_size;
+    }
+    base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (base == MAP_FAILED) {
+      perror("[ARENA] Failed mapping the session arena");
+      arena->size = 0;
+      return CD_ERR_RESOURCE;
+    }
+  }
+  arena->base = base;
+  logger("[ARENA] %zu bytes mapped for the session (%s pages)", arena->size,
+         arena->hugepages ? "huge" : "regular");
+  return CD_OK;
+}
+
+// Bumps the end of the carved blocks
+void *arena_alloc(struct Arena *arena, size_t size) {
+  size_t block = ARENA_BLOCK(size);
+  if (arena->base == NULL || block > arena->size - arena->used) {
+    printf("[ARENA] [ERROR] %zu bytes requested, %zu of %zu left\n", size,
+           arena->size - arena->used, arena->size);
+    return NULL;
+  }
+  char *p = arena->base + arena->used;
+  arena->used += block;
+  memset(p, 0, size);
+  return p;
+}
+
+// Current end of the carved blocks
+size_t arena_mark(struct Arena *arena) { return arena->used; }
+
+// Rewinds the end of the carved blocks
+void arena_reset(struct Arena *arena, size_t mark) {
+  if (mark <= arena->used) {
+    arena->used = mark;
+  }
+}
+
+// Unmaps the arena
+void arena_close(struct Arena *arena) {
+  if (arena->base != NULL) {
+    munmap(arena->base, arena->size);
+  }
+  memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,220 @@
+#include "../include/cache.h"
+#include "../include/logger.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Identifies the layout of the cache file ("CDVC" and a version)
+#define CACHE_MAGIC 0x43445643
+#define CACHE_VERSION 1
+
+// Start of the cache file
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t entry_size;
+};
+
+// One cached verdict. stored_at is 0 in unused slots.
+struct CacheEntry {
+  struct CacheKey key;
+  int64_t stored_at; // CLOCK_REALTIME seconds, so it survives reboots
+  char verdict[CACHE_VERDICT_MAX];
+};
+
+// Layout of the whole file
+struct CacheFile {
+  struct CacheHeader header;
+  struct CacheEntry entries[CACHE_SLOTS];
+};
+
+struct VerdictCache {
+  int fd;
+  struct CacheFile *file;
+};
+
+// Returns non-zero if the file behind fd has the layout of this build
+static int cache_file_valid(int fd) {
+  struct stat st;
+  struct CacheHeader header;
+  if (fstat(fd, &st) < 0 || st.st_size != (off_t)sizeof(struct CacheFile)) {
+    return 0;
+  }
+  if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+    return 0;
+  }
+  return header.magic == CACHE_MAGIC && header.version == CACHE_VERSION &&
+         header.slots == CACHE_SLOTS &&
+         header.entry_size == sizeof(struct CacheEntry);
+}
+
+// Truncates the file behind fd to an empty cache of this layout
+static int cache_file_reset(int fd) {
+  struct CacheHeader header = {CACHE_MAGIC, CACHE_VERSION, CACHE_SLOTS,
+                               sizeof(struct CacheEntry)};
+  if (ftruncate(fd, 0) < 0 || ftruncate(fd, sizeof(struct CacheFile)) < 0 ||
+      pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+    return -1;
+  }
+  return 0;
+}
+
+// Maps the cache file, creating it if needed
+struct VerdictCache *cache_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror("[CACHE] [ERROR] Could not open cache file");
+    return NULL;
+  }
+
+  // another process may be creating the file: check it under a shared lock
+  // and reset it under an exclusive one
+  flock(fd, LOCK_SH);
+  if (!cache_file_valid(fd)) {
+    flock(fd, LOCK_EX);
+    if (!cache_file_valid(fd) && cache_file_reset(fd) < 0) {
+      perror("[CACHE] [ERROR] Could not initialize cache file");
+      flock(fd, LOCK_UN);
+      close(fd);
+      return NULL;
+    }
+  }
+  flock(fd, LOCK_UN);
+
+  void *map = mmap(NULL, sizeof(struct CacheFile), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    perror("[CACHE] [ERROR] Could not map cache file");
+    close(fd);
+    return NULL;
+  }
+  struct VerdictCache *cache = malloc(sizeof(struct VerdictCache));
+  if (cache == NULL) {
+    perror("[CACHE] [ERROR] Could not allocate cache");
+    munmap(map, sizeof(struct CacheFile));
+    close(fd);
+    return NULL;
+  }
+  cache->fd = fd;
+  cache->file = map;
+  return cache;
+}
+
+// Fills the key of a client measurement
+int cache_key(struct CacheKey *key, struct Config *config) {
+  memset(key, 0, sizeof(*key));
+  struct sockaddr_in dst = {0};
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(config->dst_port_udp);
+  if (inet_pton(AF_INET, config->server_ip_addr, &dst.sin_addr) <= 0) {
+    return -1;
+  }
+
+  // let the kernel pick the source address of a connected UDP socket
+  int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock_fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in src = {0};
+  socklen_t len = sizeof(src);
+  if (connect(sock_fd, (struct sockaddr *)&dst, sizeof(dst)) < 0 ||
+      getsockname(sock_fd, (struct sockaddr *)&src, &len) < 0) {
+    close(sock_fd);
+    return -1;
+  }
+  close(sock_fd);
+
+  key->src_ip = src.sin_addr.s_addr;
+  key->dst_ip = dst.sin_addr.s_addr;
+  key->src_port = htons(config->src_port_udp);
+  key->dst_port = htons(config->dst_port_udp);
+  key->payload_size = config->payload_size;
+  return 0;
+}
+
+// Home slot of a key (FNV-1a of its bytes)
+static int cache_slot(struct CacheKey *key) {
+  const unsigned char *bytes = (const unsigned char *)key;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < sizeof(*key); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash % CACHE_SLOTS;
+}
+
+// Current time in seconds, as stored in the entries
+static int64_t cache_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec;
+}
+
+// Looks up a fresh verdict for key
+int cache_lookup(struct VerdictCache *cache, struct CacheKey *key, int ttl_s,
+                 char *verdict, int verdict_size, long *age_s) {
+  int64_t now = cache_now();
+  int home = cache_slot(key);
+  int hit = 0;
+
+  flock(cache->fd, LOCK_SH);
+  for (int i = 0; i < CACHE_PROBE_SLOTS; i++) {
+    struct CacheEntry *entry =
+        &cache->file->entries[(home + i) % CACHE_SLOTS];
+    if (entry->stored_at == 0 ||
+        memcmp(&entry->key, key, sizeof(*key)) != 0) {
+      continue;
+    }
+    long age = (long)(now - entry->stored_at);
+    if (age >= 0 && age <= ttl_s) {
+      snprintf(verdict, verdict_size, "%s", entry->verdict);
+      *age_s = age;
+      hit = 1;
+    }
+    break;
+  }
+  flock(cache->fd, LOCK_UN);
+  return hit;
+}
+
+// Stores a verdict for key
+void cache_store(struct VerdictCache *cache, struct CacheKey *key,
+                 const char *verdict) {
+  int home = cache_slot(key);
+
+  flock(cache->fd, LOCK_EX);
+  struct CacheEntry *victim = NULL;
+  for (int i = 0; i < CACHE_PROBE_SLOTS; i++) {
+    struct CacheEntry *entry =
+        &cache->file->entries[(home + i) % CACHE_SLOTS];
+    if (entry->stored_at != 0 &&
+        memcmp(&entry->key, key, sizeof(*key)) == 0) {
+      victim = entry;
+      break;
+    }
+    if (victim == NULL || entry->stored_at < victim->stored_at) {
+      victim = entry;
+    }
+  }
+  victim->key = *key;
+  snprintf(victim->verdict, sizeof(victim->verdict), "%s", verdict);
+  victim->stored_at = cache_now();
+  flock(cache->fd, LOCK_UN);
+  logger("[CACHE] Stored verdict in slot %d",
+         (int)(victim - cache->file->entries));
+}
+
+// Unmaps the cache file
+void cache_close(struct VerdictCache *cache) {
+  munmap(cache->file, sizeof(struct CacheFile));
+  close(cache->fd);
+  free(cache);
+}
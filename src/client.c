@@ -1,8 +1,23 @@
+#include "../include/arena.h"
+#include "../include/cache.h"
+#include "../include/cderror.h"
+#include "../include/client.h"
 #include "../include/config.h"
 #include "../include/logger.h"
+#include "../include/perf.h"
+#include "../include/prime.h"
+#include "../include/probe.h"
+#include "../include/rate.h"
+#include "../include/realtime.h"
+#include "../include/sockbuf.h"
+#include "../include/tsc.h"
+#include "../include/txtime.h"
+#include "../include/xdp.h"
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/ip.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,10 +27,52 @@
 #include <time.h>
 #include <unistd.h>
 
+// Fraction of random bytes in the payloads of the two packet trains
+#define LOW_ENTROPY 0.0
+#define HIGH_ENTROPY 1.0
+
+// State of a sender thread. Each sender owns its socket, payload buffer and
+// /dev/urandom descriptor, so the hot loop shares nothing with other senders.
+struct SenderArgs {
+  int thread_id;
+  int threads;
+  int sock_fd;
+  struct sockaddr_in *serv_addr;
+  char *payload;
+  int random_fd;
+  int train_id; // train id written in the probe header of the current train
+  pthread_barrier_t *barrier;
+  pthread_mutex_t *gate;   // held by probing_c until the barrier is set up
+  struct TxTime *txtime;   // kernel pacing, used when txtime->enabled
+  struct XdpSocket *xsk;   // AF_XDP socket the frames are built in, or NULL
+  struct XdpPath *path;    // headers of the AF_XDP frames
+  int src_port;
+  uint16_t ip_id; // IPv4 id of the next AF_XDP frame
+  uint64_t train_start_ns; // launch time of packet 0 of the current train
+  struct Config *config;
+  atomic_int *abort; // abort reason set by the progress monitor, or NULL
+  int sent;          // packets of the current train sent so far
+  int packets[2];    // packets sent of the low and high-entropy train
+  struct PerfSample perf[2]; // counters of the two trains, with config->perf
+};
+
+// State of the progress monitor of probing_c
+struct MonitorArgs {
+  struct Config *config;
+  int control_fd;
+  atomic_int abort; // 0, ABORT_DECIDED or ABORT_BROKEN
+};
+
+// Returns non-zero once the measurement of a sender has been aborted
+static int sender_aborted(struct SenderArgs *sender) {
+  return sender->abort != NULL && atomic_load(sender->abort) != 0;
+}
+
 // The pre_probing_c function creates a TCP socket, connects to a server, sends
 // configuration data, and receives a response. It logs the progress of the
-// pre-probing phase and exits the program if an error occurs.
-void pre_probing_c(struct Config *config) {
+// pre-probing phase. The connected socket is returned so that it can be kept
+// as the control session, or an error code if any step failed.
+int pre_probing_c(struct Config *config) {
   char *server_ip = config->server_ip_addr;
   int dst_port = config->pp_port_tcp;
   int client_fd;
@@ -26,7 +83,7 @@ void pre_probing_c(struct Config *config) {
   // create socket
   if ((client_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     perror("socket failed");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
   }
 
   // set server address
@@ -35,7 +92,8 @@ void pre_probing_c(struct Config *config) {
 
   if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
     perror("invalid address");
-    exit(EXIT_FAILURE);
+    close(client_fd);
+    return CD_ERR_CONFIG;
   }
 
   // connect to server
@@ -43,7 +101,8 @@ void pre_probing_c(struct Config *config) {
   if (connect(client_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
       0) {
     perror("Failed connecting to server");
-    exit(EXIT_FAILURE);
+    close(client_fd);
+    return CD_ERR_CONNECT;
   }
 
   logger("[PRE-PROBING PHASE] Connected to server.");
@@ -53,10 +112,10 @@ void pre_probing_c(struct Config *config) {
   memcpy(buffer + 1, config, sizeof(*config));
 
   // send message to server
-  if (send(client_fd, buffer, sizeof(buffer), 0) < 0) {
-    printf("Oops! Something went wrong sending config data");
+  if (send(client_fd, buffer, sizeof(buffer), MSG_NOSIGNAL) < 0) {
+    printf("Oops! Something went wrong sending config data\n");
     close(client_fd);
-    return;
+    return CD_ERR_CONNECT;
   } else {
     logger("[PRE-PROBING PHASE] Config data sent.");
   }
@@ -66,6 +125,7 @@ void pre_probing_c(struct Config *config) {
   char msg[1024] = "[PRE-PROBING PHASE]";
   strcpy(msg + strlen("[PRE-PROBING PHASE] "), server_res);
   logger(msg);
+  return client_fd;
 }
 
 // The send_udp_packet function sends a UDP packet containing a payload of a
@@ -77,37 +137,27 @@ int send_udp_packet(int server_fd, struct sockaddr_in *servaddr, char *payload,
                      (const struct sockaddr *)servaddr, sizeof(*servaddr));
 }
 
-// This function sends low-entropy and high-entropy packet trains to a server as
-// part of the probing phase of a UDP connection, using the configuration
-// settings provided in a struct Config. It logs the progress of the probing
-// phase and exits the program if an error occurs.
-void probing_c(struct Config *config) {
-  char *server_ip = config->server_ip_addr;
-  int inter_packet_delay_us = 300;
-  int dst_port = config->dst_port_udp;
-  int src_port = config->src_port_udp;
-  int payload_size = config->payload_size;
-  int train_size = config->udp_train_size;
-  int inter_time_s = config->inter_time_s;
+// Creates the UDP socket of a sender thread, bound to the given source port so
+// that every sender is a distinct flow (and can land on a distinct receiver
+// shard on the server). Its send buffer is sized to hold sndbuf_bytes, so the
+// share of a train can be queued back to back. Returns CD_ERR_SOCKET if an
+// error occurs.
+int create_sender_socket(int src_port, int sndbuf_bytes) {
   int sock_fd;
-  struct sockaddr_in serv_addr;
 
   if ((sock_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
     perror("[PROBING PHASE] Socket creation failed");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
   }
 
   int optval = IP_PMTUDISC_DO;
   if (setsockopt(sock_fd, IPPROTO_IP, IP_MTU_DISCOVER, &optval,
                  sizeof(optval)) < 0) {
     perror("[PROBING_PHASE] setsockopt failed");
-    exit(EXIT_FAILURE);
+    close(sock_fd);
+    return CD_ERR_SOCKET;
   }
-
-  memset(&serv_addr, 0, sizeof(serv_addr));
-  serv_addr.sin_family = AF_INET;
-  serv_addr.sin_port = htons(dst_port);
-  serv_addr.sin_addr.s_addr = inet_addr(server_ip);
+  size_socket_buffer(sock_fd, SOCKBUF_SEND, sndbuf_bytes);
 
   // Bind the socket to the source port
   struct sockaddr_in src_addr;
@@ -118,58 +168,552 @@ void probing_c(struct Config *config) {
 
   if (bind(sock_fd, (const struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
     perror("[PROBING PHASE] Error binding socket");
-    exit(EXIT_FAILURE);
-  }
-
-  // Send low entropy packet train
-  logger("[PROBING PHASE] Sending low-entropy packet train");
-  for (int i = 0; i < train_size; i++) {
-    // create low entropic payload
-    char *payload_low = malloc(payload_size);
-    uint16_t packet_id = htons((uint16_t)i);
-    memset(payload_low, 0, payload_size);
-    // insert packet_id
-    memcpy(payload_low, &packet_id, sizeof(packet_id));
-    // send packet
-    int sent = send_udp_packet(sock_fd, &serv_addr, payload_low, payload_size);
+    close(sock_fd);
+    return CD_ERR_SOCKET;
+  }
+  return sock_fd;
+}
+
+// Fills the payload of one packet of the train. The first entropy *
+// payload_size bytes are random and the rest are zeros, so LOW_ENTROPY gives
+// an all-zero payload and HIGH_ENTROPY a fully random one.
+void fill_payload(struct SenderArgs *sender, char *payload, double entropy,
+                  int packet_index) {
+  int payload_size = sender->config->payload_size;
+  int random_bytes = (int)(entropy * payload_size);
+  if (random_bytes > payload_size) {
+    random_bytes = payload_size;
+  }
+  if (random_bytes > 0) {
+    // create high entropic part of the payload
+    read(sender->random_fd, payload, random_bytes);
+  }
+  // create low entropic part of the payload
+  memset(payload + random_bytes, 0, payload_size - random_bytes);
+  // insert probe header, stamped right before the packet is sent
+  write_probe_header(payload, sender->train_id, packet_index, 0);
+}
+
+// Sends this sender's share of one packet train. Packet ids come from the
+// global sequence space of the train: sender k of n sends ids k, k + n, ...
+void send_train_share(struct SenderArgs *sender, double entropy) {
+  struct Config *config = sender->config;
+  int payload_size = config->payload_size;
+  int train_size = config->udp_train_size;
+  int inter_packet_delay_us = config->inter_packet_delay_us;
+  char *payload = sender->payload;
+
+  for (int i = sender->thread_id; i < train_size; i += sender->threads) {
+    if (sender_aborted(sender)) {
+      break;
+    }
+    fill_payload(sender, payload, entropy, i);
+    // send packet, stamped as close to the send as possible
+    stamp_probe(payload, tsc_now_ns());
+    int sent = send_udp_packet(sender->sock_fd, sender->serv_addr, payload,
+                               payload_size);
+    sender->sent++;
     if (sent != payload_size) {
       printf("[PROBING PHASE] Expected bytes sent: %d; Actual bytes sent: %d\n",
              payload_size, sent);
     }
     // buffer time to prevent packet loss
-    usleep(inter_packet_delay_us);
-    free(payload_low);
-  }
-
-  // Wait for inter-measurement time
-  logger("[PROBING PHASE] Sleeping inter-measurement time");
-  sleep(inter_time_s);
-
-  // Send high entropy packet train
-  logger("[PROBING PHASE] Sending high-entropy packet train");
-  for (int i = 0; i < train_size; i++) {
-    // create high entropic payload
-    char *payload_high = malloc(payload_size);
-    uint16_t packet_id = htons((uint16_t)i);
-    int random_fd = open("/dev/urandom", O_RDONLY);
-    read(random_fd, payload_high, payload_size);
-    close(random_fd);
-    // insert packet_id
-    memcpy(payload_high, &packet_id, sizeof(packet_id));
-    // send packet
-    int sent = send_udp_packet(sock_fd, &serv_addr, payload_high, payload_size);
-    if (sent != payload_size) {
+    if (inter_packet_delay_us > 0) {
+      usleep(inter_packet_delay_us);
+    }
+  }
+}
+
+// Kernel-paced variant of send_train_share. Packets are queued with a launch
+// time (global packet i leaves at train_start_ns + i * delay / senders), so
+// spacing comes from the qdisc instead of usleep. In back-to-back trains up
+// to gso_segments consecutive packets of this sender are coalesced into one
+// UDP_SEGMENT send (see txtime_segments). Returns once the last packet of the
+// share is due to leave.
+void send_train_share_txtime(struct SenderArgs *sender, double entropy) {
+  struct Config *config = sender->config;
+  struct TxTime *txtime = sender->txtime;
+  int payload_size = config->payload_size;
+  int train_size = config->udp_train_size;
+  uint64_t gap_ns = (uint64_t)config->inter_packet_delay_us * 1000;
+  int segments = 0;
+  int first_index = sender->thread_id;
+  uint64_t launch_ns = sender->train_start_ns;
+
+  for (int i = sender->thread_id; i < train_size; i += sender->threads) {
+    if (segments == 0 && sender_aborted(sender)) {
+      break;
+    }
+    if (segments == 0) {
+      first_index = i;
+    }
+    fill_payload(sender, sender->payload + segments * payload_size, entropy, i);
+    segments++;
+    if (segments < txtime->gso_segments && i + sender->threads < train_size) {
+      continue;
+    }
+
+    // send batch
+    launch_ns = sender->train_start_ns + first_index * gap_ns / sender->threads;
+    for (int s = 0; s < segments; s++) {
+      stamp_probe(sender->payload + s * payload_size, launch_ns);
+    }
+    int len = segments * payload_size;
+    int sent = send_udp_txtime(sender->sock_fd, sender->serv_addr,
+                               sender->payload, len,
+                               segments > 1 ? payload_size : 0, launch_ns);
+    sender->sent += segments;
+    if (sent != len) {
       printf("[PROBING PHASE] Expected bytes sent: %d; Actual bytes sent: %d\n",
-             payload_size, sent);
+             len, sent);
+    }
+    segments = 0;
+  }
+
+  txtime_sleep_until(txtime, launch_ns);
+  int dropped = txtime_drain_errors(sender->sock_fd);
+  if (dropped > 0) {
+    printf("[TXTIME] [ERROR] qdisc dropped %d packet(s) that missed their "
+           "launch time\n",
+           dropped);
+  }
+}
+
+// AF_XDP variant of send_train_share. Each packet is built in place in a
+// frame of the sender's UMEM (headers, then the payload) and queued on the TX
+// ring, so it is never copied in user space. Frames are handed to the kernel
+// one by one when packets are spaced and XDP_TX_BATCH at a time when they are
+// sent back to back. Returns once every frame of the share was sent.
+void send_train_share_xdp(struct SenderArgs *sender, double entropy) {
+  struct Config *config = sender->config;
+  struct XdpSocket *xsk = sender->xsk;
+  int payload_size = config->payload_size;
+  int train_size = config->udp_train_size;
+  int inter_packet_delay_us = config->inter_packet_delay_us;
+  int queued = 0;
+
+  for (int i = sender->thread_id; i < train_size; i += sender->threads) {
+    if (sender_aborted(sender)) {
+      break;
+    }
+    char *frame = xdp_tx_frame(xsk);
+    if (frame == NULL) {
+      // every frame is in flight, wait for the kernel to complete some
+      xdp_tx_drain(xsk, XDP_DRAIN_TIMEOUT_NS);
+      frame = xdp_tx_frame(xsk);
+      if (frame == NULL) {
+        printf("[XDP] [ERROR] No frame was completed, train cut short\n");
+        break;
+      }
+    }
+    int headers = xdp_write_headers(frame, sender->path, sender->src_port,
+                                    config->dst_port_udp, payload_size,
+                                    sender->ip_id++);
+    fill_payload(sender, frame + headers, entropy, i);
+    // queue packet, stamped as close to the send as possible
+    stamp_probe(frame + headers, tsc_now_ns());
+    xdp_tx_submit(xsk, frame, headers + payload_size);
+    sender->sent++;
+    if (inter_packet_delay_us > 0 || ++queued == XDP_TX_BATCH) {
+      xdp_tx_flush(xsk);
+      queued = 0;
     }
     // buffer time to prevent packet loss
-    usleep(inter_packet_delay_us);
-    free(payload_high);
+    if (inter_packet_delay_us > 0) {
+      usleep(inter_packet_delay_us);
+    }
   }
 
-  // Done sending UDP packets
-  logger("[PROBING PHASE] Sending high-entropy packet train");
-  close(sock_fd);
+  int unsent = xdp_tx_drain(xsk, XDP_DRAIN_TIMEOUT_NS);
+  if (unsent > 0) {
+    printf("[XDP] [ERROR] %d frame(s) were not sent\n", unsent);
+  }
+}
+
+// Sends one of the two trains of the measurement (t is 0 for the low-entropy
+// and 1 for the high-entropy one), counting it with the thread's counters
+static void send_timed_train(struct SenderArgs *sender,
+                             void (*send_share)(struct SenderArgs *, double),
+                             struct PerfCounters *counters, int t) {
+  sender->train_id = t == 0 ? LOW_TRAIN_ID : HIGH_TRAIN_ID;
+  sender->sent = 0;
+  perf_start(counters);
+  send_share(sender, t == 0 ? LOW_ENTROPY : HIGH_ENTROPY);
+  perf_stop(counters, &sender->perf[t]);
+  sender->packets[t] = sender->sent;
+}
+
+// Body of a sender thread. All senders start each train together on a barrier
+// shared with probing_c, which sleeps the inter-measurement time between the
+// low-entropy and the high-entropy train. With config->perf set, each train is
+// counted with perf_event_open counters opened before the first barrier.
+void *sender_thread(void *args) {
+  struct SenderArgs *sender = (struct SenderArgs *)args;
+  struct Config *config = sender->config;
+  struct PerfCounters counters;
+
+  apply_realtime_profile(config,
+                         config->rt_sender_cpu < 0
+                             ? -1
+                             : config->rt_sender_cpu + sender->thread_id,
+                         RT_ROLE_SENDER);
+
+  void (*send_share)(struct SenderArgs *, double) = send_train_share;
+  if (sender->xsk != NULL) {
+    send_share = send_train_share_xdp;
+  } else if (sender->txtime->enabled) {
+    send_share = send_train_share_txtime;
+  }
+  perf_open(&counters, config->perf);
+  pthread_mutex_lock(sender->gate);
+  pthread_mutex_unlock(sender->gate);
+
+  pthread_barrier_wait(sender->barrier); // start low-entropy train
+  send_timed_train(sender, send_share, &counters, 0);
+  pthread_barrier_wait(sender->barrier); // low-entropy train sent
+  pthread_barrier_wait(sender->barrier); // start high-entropy train
+  send_timed_train(sender, send_share, &counters, 1);
+  perf_close(&counters);
+  return NULL;
+}
+
+// Sets the launch time of the first packet of the next train for all senders.
+// Only meaningful with kernel pacing; senders read it after the start barrier.
+void schedule_train(struct SenderArgs *senders, int threads) {
+  if (!senders[0].txtime->enabled) {
+    return;
+  }
+  uint64_t start_ns = txtime_now_ns(senders[0].txtime) + TXTIME_LEAD_NS;
+  for (int i = 0; i < threads; i++) {
+    senders[i].train_start_ns = start_ns;
+  }
+}
+
+// Decides whether the measurement should be aborted after a progress frame:
+// once the server reports the verdict as decided during the high-entropy
+// train, or once the low-entropy train ended with abort_loss_percent or more
+// of its packets lost (0 disables it). Returns the abort reason or 0.
+static int check_progress(struct Config *config, struct ProgressFrame *frame) {
+  int train_size = config->udp_train_size;
+
+  if (frame->train_id == HIGH_TRAIN_ID && frame->decided && !frame->done) {
+    printf("[PROGRESS] Verdict decided after %d high-entropy packets, "
+           "aborting the train.\n",
+           frame->received);
+    return ABORT_DECIDED;
+  }
+  long lost_percent = (long)frame->lost * 100 / train_size;
+  if (frame->train_id == LOW_TRAIN_ID && frame->done &&
+      config->abort_loss_percent > 0 &&
+      lost_percent >= config->abort_loss_percent) {
+    printf("[PROGRESS] Low-entropy train lost %d/%d packets, aborting the "
+           "measurement.\n",
+           frame->lost, train_size);
+    return ABORT_BROKEN;
+  }
+  return 0;
+}
+
+// Body of the progress monitor thread. It reads the frames the server streams
+// over the control session until the server closes it at the end of the
+// probing phase, and sends ABORT_RQ the first time check_progress asks for it.
+void *monitor_thread(void *args) {
+  struct MonitorArgs *monitor = (struct MonitorArgs *)args;
+  char buffer[sizeof(struct ProgressFrame) + 1];
+
+  while (recv(monitor->control_fd, buffer, sizeof(buffer), MSG_WAITALL) ==
+         sizeof(buffer)) {
+    if (buffer[0] != PROGRESS_FRAME) {
+      break;
+    }
+    struct ProgressFrame frame;
+    memcpy(&frame, buffer + 1, sizeof(frame));
+    logger("[PROGRESS] %s-entropy train: %d/%d packets%s, elapsed %ld us, "
+           "mean gap %ld us, max gap %ld us, delta %ld us%s",
+           frame.train_id == LOW_TRAIN_ID ? "low" : "high", frame.received,
+           monitor->config->udp_train_size, frame.done ? " (done)" : "",
+           frame.elapsed_us, frame.mean_gap_us, frame.max_gap_us,
+           frame.delta_us, frame.decided ? " (decided)" : "");
+    if (atomic_load(&monitor->abort) != 0) {
+      continue; // already aborted
+    }
+    int reason = check_progress(monitor->config, &frame);
+    if (reason != 0) {
+      atomic_store(&monitor->abort, reason);
+      char request[2] = {ABORT_RQ, (char)reason};
+      send(monitor->control_fd, request, sizeof(request), MSG_NOSIGNAL);
+    }
+  }
+  return NULL;
+}
+
+// Sleeps the inter-measurement time, returning early if the measurement is
+// aborted
+static void sleep_inter_time(int seconds, atomic_int *abort) {
+  struct timespec step = {.tv_sec = 0, .tv_nsec = 100000000L};
+  for (int i = 0; i < seconds * 10 && atomic_load(abort) == 0; i++) {
+    nanosleep(&step, NULL);
+  }
+}
+
+// Releases the sockets and /dev/urandom descriptors of the first count
+// senders (their payload buffers go with the session arena)
+static void release_senders(struct SenderArgs *senders, int count) {
+  for (int i = 0; i < count; i++) {
+    xdp_close(senders[i].xsk);
+    if (senders[i].random_fd >= 0) {
+      close(senders[i].random_fd);
+    }
+    if (senders[i].sock_fd >= 0) {
+      close(senders[i].sock_fd);
+    }
+  }
+}
+
+// Opens one AF_XDP socket per sender, sender k on queue k of the egress
+// interface towards the server, so that each has its own TX ring. If the
+// path cannot be resolved or a queue refuses the socket, a warning is printed
+// and every sender keeps its UDP socket. Returns 0 if the senders use AF_XDP.
+static int open_xdp_senders(struct Config *config, struct SenderArgs *senders,
+                            int threads, struct XdpPath *path) {
+  if (config->payload_size + XDP_HEADERS_SIZE > XDP_FRAME_SIZE) {
+    printf("[XDP] [ERROR] payload_size must be at most %d bytes with xdp, "
+           "falling back to sockets\n",
+           XDP_FRAME_SIZE - XDP_HEADERS_SIZE);
+    return -1;
+  }
+  if (xdp_resolve_path(config->server_ip_addr, path) < 0) {
+    printf("[XDP] [ERROR] Falling back to sockets\n");
+    return -1;
+  }
+  for (int i = 0; i < threads; i++) {
+    senders[i].xsk =
+        xdp_open(path->ifindex, i, config->xdp, 0, XDP_TX_FRAMES);
+    if (senders[i].xsk == NULL) {
+      printf("[XDP] [ERROR] Cannot open an AF_XDP socket per sender thread "
+             "on %s (one TX queue each), falling back to sockets\n",
+             path->ifname);
+      for (int j = 0; j < i; j++) {
+        xdp_close(senders[j].xsk);
+        senders[j].xsk = NULL;
+      }
+      return -1;
+    }
+    senders[i].path = path;
+  }
+  logger("[XDP] Sending through %d AF_XDP socket(s) on %s (%s mode)",
+         threads, path->ifname, xdp_mode_name(config->xdp));
+  return 0;
+}
+
+// Asks the server for the slot of the timed trains over the control session
+// and sleeps until it starts. Returns CD_OK or an error code.
+static int request_slot(int control_fd, struct TrainSlot *slot) {
+  char request = TRAIN_SLOT_RQ;
+  char reply[sizeof(struct TrainSlot) + 1];
+  if (send(control_fd, &request, 1, MSG_NOSIGNAL) != 1 ||
+      recv(control_fd, reply, sizeof(reply), MSG_WAITALL) != sizeof(reply) ||
+      reply[0] != TRAIN_SLOT) {
+    printf("[PROBING PHASE] [ERROR] Server did not grant a train slot\n");
+    return CD_ERR_PROTOCOL;
+  }
+  memcpy(slot, reply + 1, sizeof(*slot));
+  logger("[PROBING PHASE] Session %u: train slot granted after %ld us, "
+         "starting in %ld us",
+         slot->session_id, slot->waited_us, slot->start_in_us);
+  usleep(slot->start_in_us);
+  return CD_OK;
+}
+
+// This function sends low-entropy and high-entropy packet trains to a server as
+// part of the probing phase of a UDP connection, using the configuration
+// settings provided in a struct Config. Each train is split across
+// sender_threads threads, each with its own socket bound to src_port_udp + k.
+// It logs the progress of the probing phase and returns CD_OK or an error
+// code. Once the senders are set up the trains wait for the slot the server
+// grants them, and session_id is set to the session the server keeps the
+// result under. While the trains are sent a monitor thread follows the
+// server's progress frames on control_fd and stops the senders if it aborts.
+// The senders and their payload buffers are carved from the session arena.
+int probing_c(struct Config *config, struct Arena *arena, int control_fd,
+              uint32_t *session_id) {
+  char *server_ip = config->server_ip_addr;
+  int dst_port = config->dst_port_udp;
+  int src_port = config->src_port_udp;
+  int payload_size = config->payload_size;
+  int inter_time_s = config->inter_time_s;
+  int threads = config->sender_threads > 0 ? config->sender_threads : 1;
+  struct sockaddr_in serv_addr;
+  pthread_barrier_t barrier;
+  pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+  struct TxTime txtime = {0};
+  struct XdpPath path;
+  struct MonitorArgs monitor;
+  pthread_t monitor_tid;
+
+  memset(&monitor, 0, sizeof(monitor));
+  monitor.config = config;
+  monitor.control_fd = control_fd;
+
+  memset(&serv_addr, 0, sizeof(serv_addr));
+  serv_addr.sin_family = AF_INET;
+  serv_addr.sin_port = htons(dst_port);
+  serv_addr.sin_addr.s_addr = inet_addr(server_ip);
+
+  // Kernel pacing: the qdisc spaces the packets and senders of a
+  // back-to-back train coalesce up to gso_segments packets per send, so
+  // their buffers hold a whole batch, also when AF_XDP is requested, as
+  // its senders may fall back to sockets.
+  int segments = 1;
+  int gso_segments =
+      txtime_segments(config->gso_segments, payload_size,
+                      config->inter_packet_delay_us);
+  if (config->txtime && config->gso_segments > gso_segments) {
+    printf("[TXTIME] [WARNING] %d segment(s) per send instead of %d: spaced "
+           "trains send one packet per launch time and a batch must fit in "
+           "one datagram\n",
+           gso_segments, config->gso_segments);
+  }
+  if (config->txtime) {
+    segments = gso_segments;
+  }
+
+  struct SenderArgs *senders =
+      arena_alloc(arena, threads * sizeof(struct SenderArgs));
+  pthread_t *sender_threads = arena_alloc(arena, threads * sizeof(pthread_t));
+  if (senders == NULL || sender_threads == NULL) {
+    return CD_ERR_RESOURCE;
+  }
+
+  // every socket and payload is primed before the slot is requested
+  struct Priming priming;
+  prime_begin(&priming);
+  for (int i = 0; i < threads; i++) {
+    senders[i].thread_id = i;
+    senders[i].threads = threads;
+    senders[i].random_fd = -1;
+    senders[i].sock_fd = create_sender_socket(
+        src_port + i,
+        train_buffer_bytes(config->udp_train_size / threads + 1, payload_size));
+    if (senders[i].sock_fd < 0) {
+      release_senders(senders, i + 1);
+      return senders[i].sock_fd;
+    }
+    senders[i].serv_addr = &serv_addr;
+    senders[i].src_port = src_port + i;
+    // Payload buffer is carved once per sender, outside the timed loops
+    senders[i].payload = arena_alloc(arena, (size_t)segments * payload_size);
+    senders[i].random_fd = open("/dev/urandom", O_RDONLY);
+    if (senders[i].payload == NULL || senders[i].random_fd < 0) {
+      perror("[PROBING PHASE] Failed allocating payload");
+      release_senders(senders, i + 1);
+      return CD_ERR_RESOURCE;
+    }
+    senders[i].barrier = &barrier;
+    senders[i].gate = &gate;
+    senders[i].txtime = &txtime;
+    senders[i].config = config;
+    senders[i].abort = &monitor.abort;
+    perf_sample_init(&senders[i].perf[0]);
+    perf_sample_init(&senders[i].perf[1]);
+    prime_buffer(&priming, senders[i].payload, (size_t)segments * payload_size);
+    // before SO_TXTIME, as etf drops packets without a launch time
+    prime_socket(&priming, senders[i].sock_fd, &serv_addr, senders[i].payload,
+                 payload_size, config->prime_packets);
+  }
+  // the UDP sockets stay open with AF_XDP, keeping the source ports reserved
+  int xdp_open = config->xdp != XDP_OFF &&
+                 open_xdp_senders(config, senders, threads, &path) == 0;
+  // AF_XDP frames bypass the qdisc, so pacing is decided once it is known
+  // whether the senders fell back to sockets
+  if (config->txtime && !xdp_open &&
+      txtime_init(&txtime, server_ip, gso_segments) == 0) {
+    for (int i = 0; i < threads; i++) {
+      txtime_enable_socket(&txtime, senders[i].sock_fd);
+    }
+  }
+  prime_end(&priming, "[PROBING PHASE]");
+  struct TrainSlot slot;
+  int slot_error = request_slot(control_fd, &slot);
+  if (slot_error != CD_OK) {
+    release_senders(senders, threads);
+    return slot_error;
+  }
+  *session_id = slot.session_id;
+
+  int monitoring = config->progress_interval_ms > 0 &&
+                   pthread_create(&monitor_tid, NULL, monitor_thread,
+                                  &monitor) == 0;
+
+  // The barrier is sized once the senders are started, which wait on the
+  // gate until then. If one cannot be started, the ones that were skip their
+  // trains and only meet the barrier.
+  int error = CD_OK;
+  int started = 0;
+  pthread_mutex_lock(&gate);
+  for (; started < threads; started++) {
+    int rc = pthread_create(&sender_threads[started], NULL, sender_thread,
+                            &senders[started]);
+    if (rc != 0) {
+      printf("[PROBING PHASE] pthread_create: %s\n", strerror(rc));
+      atomic_store(&monitor.abort, ABORT_BROKEN);
+      error = CD_ERR_RESOURCE;
+      break;
+    }
+  }
+  pthread_barrier_init(&barrier, NULL, started + 1);
+  pthread_mutex_unlock(&gate);
+
+  if (error == CD_OK) {
+    // Send low entropy packet train
+    logger("[PROBING PHASE] Sending low-entropy packet train on %d sender(s)",
+           threads);
+    schedule_train(senders, threads);
+  }
+  pthread_barrier_wait(&barrier);
+  pthread_barrier_wait(&barrier);
+
+  if (error == CD_OK) {
+    // Wait for inter-measurement time
+    logger("[PROBING PHASE] Sleeping inter-measurement time");
+    sleep_inter_time(inter_time_s, &monitor.abort);
+
+    // Send high entropy packet train
+    logger("[PROBING PHASE] Sending high-entropy packet train on %d "
+           "sender(s)",
+           threads);
+    schedule_train(senders, threads);
+  }
+  pthread_barrier_wait(&barrier);
+  struct PerfSample perf[2];
+  long packets[2] = {0, 0};
+  perf_sample_init(&perf[0]);
+  perf_sample_init(&perf[1]);
+  for (int i = 0; i < started; i++) {
+    pthread_join(sender_threads[i], NULL);
+    for (int t = 0; t < 2; t++) {
+      perf_sample_add(&perf[t], &senders[i].perf[t]);
+      packets[t] += senders[i].packets[t];
+    }
+  }
+  release_senders(senders, threads);
+  pthread_barrier_destroy(&barrier);
+
+  if (error != CD_OK) {
+    // the server would wait for the trains, so the session is cut
+    shutdown(control_fd, SHUT_RDWR);
+  } else {
+    // Done sending UDP packets
+    logger("[PROBING PHASE] High-entropy packet train sent");
+    if (config->perf) {
+      perf_report("low-entropy send", &perf[0], packets[0]);
+      perf_report("high-entropy send", &perf[1], packets[1]);
+    }
+  }
+  if (monitoring) {
+    pthread_join(monitor_tid, NULL); // until the server is done receiving
+  }
+  return error;
 }
 
 // Receives a result from a socket file descriptor and stores it in a buffer,
@@ -184,9 +728,12 @@ char *receive_result(int sockfd, char *buffer, int buffer_size) {
 }
 
 // This function establishes a TCP connection with a server specified by a given
-// IP address and port, then receives a result of the probing phase from the
-// server and prints it to the console.
-void post_probing_c(struct Config *config) {
+// IP address and port, asks for the result of session_id with RESULT_RQ, then
+// receives the result of the probing phase from the server and copies it into
+// verdict. Returns CD_OK, CD_ERR_NO_RESULT if the server did not respond or
+// the error code of a failed step.
+int post_probing_c(struct Config *config, uint32_t session_id, char *verdict,
+                   int verdict_size) {
   char *server_ip = config->server_ip_addr;
   int dst_port = config->pp_port_tcp;
   int server_fd;
@@ -196,7 +743,7 @@ void post_probing_c(struct Config *config) {
 
   if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     perror("socket creation failed");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
   }
 
   memset(&server_addr, 0, sizeof(server_addr));
@@ -206,37 +753,445 @@ void post_probing_c(struct Config *config) {
 
   if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
     perror("inet_pton failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_CONFIG;
   }
 
   if (connect(server_fd, (const struct sockaddr *)&server_addr,
               sizeof(server_addr)) < 0) {
     perror("connect failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_CONNECT;
   }
 
-  char *result = receive_result(server_fd, buffer, buffer_size);
-  if (strcmp(result, "") == 0) {
-    printf("[POST-PROBING PHASE] No response from server.\n");
-  } else {
-    printf("[COMP DETECT] %s\n", result);
+  char request[sizeof(session_id) + 1];
+  request[0] = RESULT_RQ;
+  memcpy(request + 1, &session_id, sizeof(session_id));
+  if (send(server_fd, request, sizeof(request), MSG_NOSIGNAL) < 0) {
+    perror("send failed");
+    close(server_fd);
+    return CD_ERR_CONNECT;
   }
+  char *result = receive_result(server_fd, buffer, buffer_size);
+  snprintf(verdict, verdict_size, "%s", result);
   close(server_fd);
+  return strcmp(result, "") == 0 ? CD_ERR_NO_RESULT : CD_OK;
 }
 
-// This function runs the full client process by calling the pre-probing,
-// probing, and post-probing functions with a brief delay between each phase.
-void run_client(struct Config *config) {
-  sleep(3); // give some time for server to start
-  logger("[INFO] Init Pre-probing phase.");
-  pre_probing_c(config); // <- run pre-probing
-  logger("[INFO] Pre-probing phase completed.");
+// Prints the result matrix of a sweep: one row per payload size and, for each
+// entropy fraction, the dispersion of the train and its effective throughput
+void print_sweep_matrix(struct Config *config, struct SweepResult *results) {
+  printf("[COMP DETECT] Sweep of %d packets per train: dispersion (ms) / "
+         "effective throughput (Mbit/s)\n",
+         config->udp_train_size);
+  printf("%-10s", "payload");
+  for (int e = 0; e < config->sweep_entropy_count; e++) {
+    printf(" | entropy %-11.2f", config->sweep_entropy[e]);
+  }
+  printf("\n");
+  for (int p = 0; p < config->sweep_payload_count; p++) {
+    printf("%-10d", config->sweep_payload_sizes[p]);
+    for (int e = 0; e < config->sweep_entropy_count; e++) {
+      struct SweepResult *result =
+          &results[p * config->sweep_entropy_count + e];
+      double throughput_mbps =
+          result->dispersion_us > 0
+              ? (double)result->received * config->sweep_payload_sizes[p] * 8 /
+                    result->dispersion_us
+              : 0;
+      printf(" | %8.2f / %8.2f", result->dispersion_us / 1000.0,
+             throughput_mbps);
+    }
+    printf("\n");
+  }
+}
+
+// Sets up the single sender used by the trains driven over the control
+// session (sweep cells and warm-up rounds): one socket bound to src_port_udp
+// and a payload buffer for max_payload_size bytes carved from arena, both
+// primed before the first train. The sender reads payload size, train size
+// and delay from train_config, which the caller updates before each train.
+// Returns CD_OK or an error code.
+int open_control_sender(struct SenderArgs *sender, struct Config *config,
+                         struct Arena *arena, struct Config *train_config,
+                         struct sockaddr_in *serv_addr, struct TxTime *txtime,
+                         int max_payload_size, int train_size) {
+  memset(serv_addr, 0, sizeof(*serv_addr));
+  serv_addr->sin_family = AF_INET;
+  serv_addr->sin_port = htons(config->dst_port_udp);
+  serv_addr->sin_addr.s_addr = inet_addr(config->server_ip_addr);
+
+  memset(sender, 0, sizeof(*sender));
+  sender->threads = 1;
+  sender->sock_fd = create_sender_socket(
+      config->src_port_udp, train_buffer_bytes(train_size, max_payload_size));
+  if (sender->sock_fd < 0) {
+    return sender->sock_fd;
+  }
+  sender->serv_addr = serv_addr;
+  sender->payload = arena_alloc(arena, max_payload_size);
+  sender->random_fd = open("/dev/urandom", O_RDONLY);
+  sender->txtime = txtime;
+  sender->config = train_config;
+  if (sender->payload == NULL || sender->random_fd < 0) {
+    perror("[PROBING PHASE] Failed allocating payload");
+    release_senders(sender, 1);
+    return CD_ERR_RESOURCE;
+  }
+  struct Priming priming;
+  prime_begin(&priming);
+  prime_buffer(&priming, sender->payload, max_payload_size);
+  prime_socket(&priming, sender->sock_fd, serv_addr, sender->payload,
+               max_payload_size, config->prime_packets);
+  prime_end(&priming, "[PROBING PHASE]");
+  return CD_OK;
+}
+
+// Releases the resources of open_control_sender
+void close_control_sender(struct SenderArgs *sender) {
+  release_senders(sender, 1);
+}
+
+// The sweep_c function runs every combination of sweep_payload_sizes and
+// sweep_entropy over the control session opened by pre_probing_c. For each
+// cell it announces the payload size and entropy, waits until the server is
+// ready, sends one train and reads back the server's measurement. The UDP
+// socket and the payload buffer (sized for the largest payload) are created
+// once and reused by every cell. Returns CD_OK or an error code.
+int sweep_c(struct Config *config, struct Arena *arena, int control_fd) {
+  struct Config cell_config = *config;
+  struct SenderArgs sender;
+  struct TxTime txtime = {0};
+  struct sockaddr_in serv_addr;
+  int cells = config->sweep_payload_count * config->sweep_entropy_count;
+  struct SweepResult results[SWEEP_MAX * SWEEP_MAX];
+  int max_payload_size = 0;
+
+  for (int p = 0; p < config->sweep_payload_count; p++) {
+    if (config->sweep_payload_sizes[p] > max_payload_size) {
+      max_payload_size = config->sweep_payload_sizes[p];
+    }
+  }
+
+  int error =
+      open_control_sender(&sender, config, arena, &cell_config, &serv_addr,
+                          &txtime, max_payload_size, config->udp_train_size);
+  if (error != CD_OK) {
+    return error;
+  }
+  apply_realtime_profile(config, config->rt_sender_cpu, RT_ROLE_SENDER);
+
+  for (int cell = 0; cell < cells; cell++) {
+    struct SweepCell request;
+    request.payload_size =
+        config->sweep_payload_sizes[cell / config->sweep_entropy_count];
+    request.entropy = config->sweep_entropy[cell % config->sweep_entropy_count];
+    request.train_size = config->udp_train_size;
+    request.train_id = cell;
+    cell_config.payload_size = request.payload_size;
+    sender.train_id = cell;
+
+    // announce cell and wait until the server is ready for its train
+    char buffer[sizeof(struct SweepCell) + 1];
+    char ready = 0;
+    buffer[0] = SWEEP_CELL_RQ;
+    memcpy(buffer + 1, &request, sizeof(request));
+    if (send(control_fd, buffer, sizeof(buffer), MSG_NOSIGNAL) < 0 ||
+        recv(control_fd, &ready, 1, MSG_WAITALL) != 1 || ready != SWEEP_READY) {
+      printf("[SWEEP] Server did not accept cell %d.\n", cell);
+      close_control_sender(&sender);
+      return CD_ERR_PROTOCOL;
+    }
+
+    logger("[SWEEP] Sending train: payload_size=%d entropy=%.2f",
+           request.payload_size, request.entropy);
+    send_train_share(&sender, request.entropy);
+
+    if (recv(control_fd, &results[cell], sizeof(struct SweepResult),
+             MSG_WAITALL) != sizeof(struct SweepResult)) {
+      printf("[SWEEP] No result from server for cell %d.\n", cell);
+      close_control_sender(&sender);
+      return CD_ERR_PROTOCOL;
+    }
+    logger("[SWEEP] Server received %d/%d packets in %ld us (lost %d, "
+           "reordered %d, dropped %d)",
+           results[cell].received, request.train_size,
+           results[cell].dispersion_us, results[cell].lost,
+           results[cell].reordered, results[cell].kernel_drops);
+
+    if (cell < cells - 1) {
+      sleep(config->inter_time_s);
+    }
+  }
+
+  char done = SWEEP_DONE_RQ;
+  send(control_fd, &done, 1, MSG_NOSIGNAL);
+  close_control_sender(&sender);
+
+  print_sweep_matrix(config, results);
+  return CD_OK;
+}
+
+// The warmup_c function runs warmup_trains high-entropy trains of
+// warmup_train_size packets over the control session before the timed
+// trains. Each round announces its rate, sends the train once the server is
+// ready and feeds the server's loss report to an AIMD rate controller that
+// starts at the configured rate. The highest rate sent without loss becomes
+// the inter_packet_delay_us of the timed trains, which is also sent to the
+// server so that their deadlines match. Returns CD_OK or an error code.
+int warmup_c(struct Config *config, struct Arena *arena, int control_fd) {
+  struct Config train_config = *config;
+  struct SenderArgs sender;
+  struct TxTime txtime = {0};
+  struct sockaddr_in serv_addr;
+  struct RateController rate;
+  int threads = config->sender_threads > 0 ? config->sender_threads : 1;
+
+  train_config.udp_train_size = config->warmup_train_size;
+  int error = open_control_sender(&sender, config, arena, &train_config,
+                                  &serv_addr, &txtime, config->payload_size,
+                                  config->warmup_train_size);
+  if (error != CD_OK) {
+    return error;
+  }
+  rate_init(&rate, delay_to_rate(config->inter_packet_delay_us, threads),
+            config->warmup_rate_step_pps);
+
+  for (int round = 0; round < config->warmup_trains; round++) {
+    struct WarmupTrain request;
+    request.train_id = WARMUP_FIRST_TRAIN_ID + round;
+    request.train_size = config->warmup_train_size;
+    request.rate_pps = rate.rate_pps;
+    train_config.inter_packet_delay_us = rate_to_delay(rate.rate_pps, 1);
+    sender.train_id = request.train_id;
+
+    // announce train and wait until the server is ready for it
+    char buffer[sizeof(struct WarmupTrain) + 1];
+    char ready = 0;
+    buffer[0] = WARMUP_TRAIN_RQ;
+    memcpy(buffer + 1, &request, sizeof(request));
+    if (send(control_fd, buffer, sizeof(buffer), MSG_NOSIGNAL) < 0 ||
+        recv(control_fd, &ready, 1, MSG_WAITALL) != 1 || ready != SWEEP_READY) {
+      printf("[WARM-UP] Server did not accept warm-up train %d.\n", round);
+      close_control_sender(&sender);
+      return CD_ERR_PROTOCOL;
+    }
+
+    send_train_share(&sender, HIGH_ENTROPY);
+
+    struct WarmupFeedback feedback;
+    if (recv(control_fd, &feedback, sizeof(feedback), MSG_WAITALL) !=
+        sizeof(feedback)) {
+      printf("[WARM-UP] No feedback from server for warm-up train %d.\n",
+             round);
+      close_control_sender(&sender);
+      return CD_ERR_PROTOCOL;
+    }
+    logger("[WARM-UP] Train %d at %d pps: server received %d/%d packets "
+           "(lost %d, dropped %d, highest id %d)",
+           round, request.rate_pps, feedback.received, request.train_size,
+           feedback.lost, feedback.kernel_drops, feedback.highest_packet_id);
+    rate_update(&rate, feedback.received, feedback.lost);
+  }
+  close_control_sender(&sender);
+
+  config->inter_packet_delay_us = rate_to_delay(rate_result(&rate), threads);
+  char buffer[sizeof(int) + 1];
+  buffer[0] = WARMUP_DONE_RQ;
+  memcpy(buffer + 1, &config->inter_packet_delay_us, sizeof(int));
+  send(control_fd, buffer, sizeof(buffer), MSG_NOSIGNAL);
+  printf("[WARM-UP] Timed trains will be sent at %d pps "
+         "(inter_packet_delay_us = %d)\n",
+         rate_result(&rate), config->inter_packet_delay_us);
+  return CD_OK;
+}
+
+// Returns non-zero if the config asks for a parameter sweep. A sweep needs at
+// least one payload size and one entropy fraction.
+int sweep_enabled(struct Config *config) {
+  return config->sweep_payload_count > 0 && config->sweep_entropy_count > 0;
+}
+
+// Opens the verdict cache of a regular measurement, unless cache_ttl_s is 0,
+// and looks up the path. On a fresh hit (and without -f) the cached verdict
+// and its age are copied into result and 1 is returned, so the measurement can
+// be skipped. Otherwise the cache is left in *cache (NULL if disabled) to
+// store the new verdict.
+static int cached_verdict(struct Config *config, struct VerdictCache **cache,
+                          struct CacheKey *key, struct ClientResult *result) {
+  *cache = NULL;
+  if (config->cache_ttl_s <= 0 || sweep_enabled(config)) {
+    return 0;
+  }
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (cache_key(key, config) < 0) {
+    printf("[CACHE] [ERROR] No route to %s, not using the cache\n",
+           config->server_ip_addr);
+    return 0;
+  }
+  *cache = cache_open(config->cache_path != NULL ? config->cache_path
+                                                 : CACHE_DEFAULT_PATH);
+  if (*cache == NULL || config->cache_force) {
+    return 0;
+  }
+
+  if (!cache_lookup(*cache, key, config->cache_ttl_s, result->verdict,
+                    sizeof(result->verdict), &result->cached_age_s)) {
+    logger("[CACHE] No fresh verdict for this path");
+    return 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  logger("[CACHE] Hit in %ld us",
+         (end.tv_sec - start.tv_sec) * 1000000L +
+             (end.tv_nsec - start.tv_nsec) / 1000);
+  cache_close(*cache);
+  *cache = NULL;
+  return 1;
+}
+
+// Caches the verdict of a measurement. Aborted or missing results are not
+// verdicts on the path and are never cached.
+static void store_verdict(struct VerdictCache *cache, struct CacheKey *key,
+                          const char *verdict) {
+  if (strncmp(verdict, VERDICT_COMPRESSION, strlen(VERDICT_COMPRESSION)) ==
+          0 ||
+      strncmp(verdict, VERDICT_NONE, strlen(VERDICT_NONE)) == 0) {
+    cache_store(cache, key, verdict);
+  }
+}
+
+// Bytes of session arena the senders of a measurement take: the payload
+// buffer of the sweep sender, or those of the warm-up sender and of the
+// probing senders (each holding a GSO batch with kernel pacing) along with
+// their thread state
+static size_t session_arena_size(struct Config *config) {
+  if (sweep_enabled(config)) {
+    int max_payload_size = 0;
+    for (int p = 0; p < config->sweep_payload_count; p++) {
+      if (config->sweep_payload_sizes[p] > max_payload_size) {
+        max_payload_size = config->sweep_payload_sizes[p];
+      }
+    }
+    return ARENA_BLOCK(max_payload_size);
+  }
+  int threads = config->sender_threads > 0 ? config->sender_threads : 1;
+  int segments = 1;
+  if (config->txtime) {
+    segments = txtime_segments(config->gso_segments, config->payload_size,
+                               config->inter_packet_delay_us);
+  }
+  size_t size = ARENA_BLOCK(threads * sizeof(struct SenderArgs)) +
+                ARENA_BLOCK(threads * sizeof(pthread_t)) +
+                threads * ARENA_BLOCK((size_t)segments * config->payload_size);
+  if (config->warmup_trains > 0) {
+    size += ARENA_BLOCK(config->payload_size);
+  }
+  return size;
+}
+
+// Runs the phases of a measurement on an open control session: the sweep, or
+// the warm-up rounds (if any), the probing and the post-probing phase. The
+// buffers of the senders are carved from arena.
+static int measure_session(struct Config *config, struct Arena *arena,
+                           int control_fd, struct ClientResult *result) {
+  if (sweep_enabled(config)) {
+    logger("[INFO] Init Sweep.");
+    int error = sweep_c(config, arena, control_fd); // <- run sweep
+    close(control_fd);
+    logger("[INFO] Sweep completed.");
+    return error;
+  }
+  if (config->warmup_trains > 0) {
+    logger("[INFO] Init Warm-up.");
+    int error = warmup_c(config, arena, control_fd); // <- run warm-up
+    if (error != CD_OK) {
+      close(control_fd);
+      return error;
+    }
+    logger("[INFO] Warm-up completed.");
+  }
   logger("[INFO] Init Probing phase.");
-  sleep(2);          // giving buffer time for server to start UDP server
-  probing_c(config); // <- run probing
+  uint32_t session_id = 0;
+  int error =
+      probing_c(config, arena, control_fd, &session_id); // <- run probing
+  close(control_fd);
+  if (error != CD_OK) {
+    return error;
+  }
   logger("[INFO] Probing phase completed.");
   logger("[INFO] Init Post-probing phase.");
   sleep(2); // giving buffer time for server to re-start TCP server
-  post_probing_c(config); // <- run post-probing
+  error = post_probing_c(config, session_id, result->verdict,
+                         sizeof(result->verdict)); // <- run post-probing
   logger("[INFO] Post-probing phase completed.");
+  return error;
+}
+
+// Measures the path to the server of config and fills result
+int client_measure(struct Config *config, struct ClientResult *result) {
+  result->verdict[0] = '\0';
+  result->cached_age_s = -1;
+  for (int p = 0; p < config->sweep_payload_count; p++) {
+    if (config->sweep_payload_sizes[p] < PROBE_HEADER_SIZE) {
+      printf("Sweep payload sizes must be at least %d bytes.\n",
+             PROBE_HEADER_SIZE);
+      return CD_ERR_CONFIG;
+    }
+  }
+  if (!sweep_enabled(config) && config->payload_size < PROBE_HEADER_SIZE) {
+    printf("payload_size must be at least %d bytes.\n", PROBE_HEADER_SIZE);
+    return CD_ERR_CONFIG;
+  }
+  struct VerdictCache *cache;
+  struct CacheKey key;
+  if (cached_verdict(config, &cache, &key, result)) {
+    return CD_OK;
+  }
+  tsc_init_once(config->tsc); // probes carry their send timestamp
+  struct Arena arena;
+  int error = arena_open(&arena, session_arena_size(config),
+                         config->arena_hugepages);
+  if (error != CD_OK) {
+    if (cache != NULL) {
+      cache_close(cache);
+    }
+    return error;
+  }
+  sleep(3); // give some time for server to start
+  logger("[INFO] Init Pre-probing phase.");
+  int control_fd = pre_probing_c(config); // <- run pre-probing
+  error = control_fd;
+  if (control_fd >= 0) {
+    logger("[INFO] Pre-probing phase completed.");
+    error = measure_session(config, &arena, control_fd, result);
+  }
+  arena_close(&arena);
+  if (cache != NULL) {
+    if (error == CD_OK) {
+      store_verdict(cache, &key, result->verdict);
+    }
+    cache_close(cache);
+  }
+  return error;
+}
+
+// This function runs the full client process by calling the pre-probing,
+// probing, and post-probing functions with a brief delay between each phase.
+// In sweep mode the pre-probing connection stays open as the control session
+// and all cells of the sweep are measured over it; otherwise it carries the
+// warm-up rounds, if any, before the timed trains. With cache_ttl_s set, a
+// fresh cached verdict for the path is printed instead of measuring.
+int run_client(struct Config *config) {
+  struct ClientResult result;
+  int error = client_measure(config, &result);
+  if (error == CD_ERR_NO_RESULT) {
+    printf("[POST-PROBING PHASE] No response from server.\n");
+  } else if (result.cached_age_s >= 0) {
+    printf("[COMP DETECT] %s [cached %lds ago]\n", result.verdict,
+           result.cached_age_s);
+  } else if (error == CD_OK && result.verdict[0] != '\0') {
+    printf("[COMP DETECT] %s\n", result.verdict);
+  }
+  return error;
 }
@@ -0,0 +1,136 @@
+#include "../include/compdetect.h"
+#include "../include/client.h"
+#include "../include/tsc.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// A measurement in flight. The thread owns config and outcome until it sets
+// done, after which only the caller reads them.
+struct CdMeasurement {
+  struct Config config;
+  struct ClientResult outcome;
+  int error;
+  atomic_int done;
+  int event_fd; // written once done is set
+  pthread_t thread;
+};
+
+// Returns a short description of an error code
+const char *cd_strerror(int error) {
+  switch (error) {
+  case CD_OK:
+    return "success";
+  case CD_ERR_CONFIG:
+    return "invalid configuration";
+  case CD_ERR_SOCKET:
+    return "socket error";
+  case CD_ERR_CONNECT:
+    return "control session failed";
+  case CD_ERR_PROTOCOL:
+    return "protocol error";
+  case CD_ERR_RESOURCE:
+    return "out of resources";
+  case CD_ERR_NO_RESULT:
+    return "no response from server";
+  default:
+    return "unknown error";
+  }
+}
+
+// Picks the timestamp source of the process
+void cd_init(int use_tsc) { tsc_init_once(use_tsc); }
+
+// Body of the thread of a measurement
+static void *measurement_thread(void *args) {
+  struct CdMeasurement *measurement = (struct CdMeasurement *)args;
+  measurement->error =
+      client_measure(&measurement->config, &measurement->outcome);
+  atomic_store(&measurement->done, 1);
+  eventfd_write(measurement->event_fd, 1);
+  return NULL;
+}
+
+// Starts a measurement
+struct CdMeasurement *cd_start(const struct Config *config, int *error) {
+  struct CdMeasurement *measurement = calloc(1, sizeof(struct CdMeasurement));
+  if (measurement == NULL) {
+    *error = CD_ERR_RESOURCE;
+    return NULL;
+  }
+  measurement->config = *config;
+  measurement->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (measurement->event_fd < 0) {
+    perror("[COMP DETECT] eventfd");
+    free(measurement);
+    *error = CD_ERR_RESOURCE;
+    return NULL;
+  }
+
+  // the thread inherits a mask without SIGINT and SIGTERM, so the signals of
+  // the embedding process do not interrupt the sleeps of a measurement
+  sigset_t blocked, previous;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGINT);
+  sigaddset(&blocked, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+  int rc = pthread_create(&measurement->thread, NULL, measurement_thread,
+                          measurement);
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+  if (rc != 0) {
+    printf("[COMP DETECT] pthread_create: %s\n", strerror(rc));
+    close(measurement->event_fd);
+    free(measurement);
+    *error = CD_ERR_RESOURCE;
+    return NULL;
+  }
+  *error = CD_OK;
+  return measurement;
+}
+
+// Descriptor readable once the measurement finished
+int cd_fd(struct CdMeasurement *measurement) { return measurement->event_fd; }
+
+// State of a measurement
+int cd_poll(struct CdMeasurement *measurement) {
+  if (!atomic_load(&measurement->done)) {
+    return CD_PENDING;
+  }
+  return measurement->error;
+}
+
+// Outcome of a finished measurement
+int cd_result(struct CdMeasurement *measurement, struct CdResult *result) {
+  int state = cd_poll(measurement);
+  if (state != CD_OK) {
+    return state;
+  }
+  const char *text = measurement->outcome.verdict;
+  snprintf(result->text, sizeof(result->text), "%s", text);
+  result->cached_age_s = measurement->outcome.cached_age_s;
+  if (strncmp(text, VERDICT_COMPRESSION, strlen(VERDICT_COMPRESSION)) == 0) {
+    result->verdict = RESULT_COMPRESSION;
+  } else if (strncmp(text, VERDICT_NONE, strlen(VERDICT_NONE)) == 0) {
+    result->verdict = RESULT_NONE;
+  } else if (strncmp(text, VERDICT_ABORTED, strlen(VERDICT_ABORTED)) == 0) {
+    result->verdict = RESULT_ABORTED;
+  } else {
+    result->verdict = RESULT_FAILED;
+  }
+  return CD_OK;
+}
+
+// Joins and releases a measurement
+void cd_free(struct CdMeasurement *measurement) {
+  if (measurement == NULL) {
+    return;
+  }
+  pthread_join(measurement->thread, NULL);
+  close(measurement->event_fd);
+  free(measurement);
+}
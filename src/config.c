@@ -1,7 +1,10 @@
 #include "../include/config.h"
+#include "../include/cache.h"
 #include "../include/logger.h"
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <yaml.h>
 
 // Initialize fields to default values
@@ -18,6 +21,71 @@ void init_config(struct Config *config) {
   config->udp_train_size = 0;
   config->udp_ttl = 0;
   config->rst_timeout_s = 0;
+  config->inter_packet_delay_us = 300;
+  config->sender_threads = 1;
+  config->receiver_shards = 1;
+  config->txtime = 0;
+  config->gso_segments = 1;
+  config->rt_sender_cpu = -1;
+  config->rt_receiver_cpu = -1;
+  config->rt_rst_cpu = -1;
+  config->rt_fifo_priority = 0;
+  config->rt_mlock = 0;
+  config->tsc = 1;
+  config->perf = 0;
+  config->busy_poll_us = 0;
+  config->xdp = 0;
+  config->xdp_interface = NULL;
+  config->concurrent_sessions = 0;
+  config->interface_budget_kbps = 0;
+  config->admission_guard_ms = 10;
+  config->sweep_payload_count = 0;
+  config->sweep_entropy_count = 0;
+  config->warmup_trains = 0;
+  config->warmup_train_size = 100;
+  config->warmup_rate_step_pps = 500;
+  config->prime_packets = 2;
+  config->arena_hugepages = 0;
+  config->progress_interval_ms = 1000;
+  config->abort_loss_percent = 50;
+  config->interleave_pairs = 0;
+  config->sub_train_size = 500;
+  config->interleave_gap_ms = 50;
+  config->marker_interval = 0;
+  config->marker_port_base = 0;
+  config->hop_ttl_min = 1;
+  config->hop_ttl_max = 0;
+  config->cache_ttl_s = 0;
+  config->cache_path = NULL;
+  config->cache_force = 0;
+  config->result_ring = NULL;
+  config->targets_file = NULL;
+  config->measure_period_s = 3600;
+  config->period_jitter_percent = 10;
+  config->scheduler_workers = 4;
+  config->global_budget_kbps = 0;
+  config->destination_budget_kbps = 0;
+  config->scheduler_duration_s = 0;
+}
+
+// Parses a comma separated list of payload sizes ("500,1000,1400")
+static int parse_int_list(char *value, int *list) {
+  int count = 0;
+  for (char *item = strtok(value, ", "); item != NULL && count < SWEEP_MAX;
+       item = strtok(NULL, ", ")) {
+    list[count++] = atoi(item);
+  }
+  return count;
+}
+
+// Parses a comma separated list of entropy fractions ("0,0.5,1")
+static int parse_double_list(char *value, double *list) {
+  int count = 0;
+  for (char *item = strtok(value, ", "); item != NULL && count < SWEEP_MAX;
+       item = strtok(NULL, ", ")) {
+    list[count++] = atof(item);
+  }
+  return count;
 }
 
 // Parse yaml file
@@ -101,6 +169,201 @@ struct Config *parse_config(struct Config *config, char *filename) {
                  0) {
         yaml_parser_parse(&parser, &event);
         config->rst_timeout_s = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "inter_packet_delay_us") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->inter_packet_delay_us = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "sender_threads") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->sender_threads = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "receiver_shards") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->receiver_shards = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "txtime") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->txtime = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "gso_segments") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->gso_segments = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "sweep_payload_sizes") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->sweep_payload_count = parse_int_list(
+            (char *)event.data.scalar.value, config->sweep_payload_sizes);
+      } else if (strcmp((char *)event.data.scalar.value, "sweep_entropy") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->sweep_entropy_count = parse_double_list(
+            (char *)event.data.scalar.value, config->sweep_entropy);
+      } else if (strcmp((char *)event.data.scalar.value, "warmup_trains") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->warmup_trains = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "warmup_train_size") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->warmup_train_size = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "warmup_rate_step_pps") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->warmup_rate_step_pps = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "prime_packets") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->prime_packets = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "arena_hugepages") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->arena_hugepages = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "progress_interval_ms") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->progress_interval_ms = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "abort_loss_percent") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->abort_loss_percent = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "interleave_pairs") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->interleave_pairs = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "sub_train_size") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->sub_train_size = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "interleave_gap_ms") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->interleave_gap_ms = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "marker_interval") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->marker_interval = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "marker_port_base") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->marker_port_base = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "hop_ttl_min") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->hop_ttl_min = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "hop_ttl_max") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->hop_ttl_max = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "cache_ttl_s") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->cache_ttl_s = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "cache_path") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->cache_path =
+            malloc(strlen((char *)event.data.scalar.value) + 1);
+        if (!config->cache_path) {
+          printf("Failed to allocate memory for cache path\n");
+          free_config(config); // Free memory allocated for Config struct
+          return NULL;
+        }
+        strcpy(config->cache_path, (char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "result_ring") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->result_ring =
+            malloc(strlen((char *)event.data.scalar.value) + 1);
+        if (!config->result_ring) {
+          printf("Failed to allocate memory for result ring name\n");
+          free_config(config); // Free memory allocated for Config struct
+          return NULL;
+        }
+        strcpy(config->result_ring, (char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "targets_file") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->targets_file =
+            malloc(strlen((char *)event.data.scalar.value) + 1);
+        if (!config->targets_file) {
+          printf("Failed to allocate memory for targets file\n");
+          free_config(config); // Free memory allocated for Config struct
+          return NULL;
+        }
+        strcpy(config->targets_file, (char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "measure_period_s") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->measure_period_s = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "period_jitter_percent") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->period_jitter_percent = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "scheduler_workers") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->scheduler_workers = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "global_budget_kbps") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->global_budget_kbps = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "destination_budget_kbps") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->destination_budget_kbps = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "scheduler_duration_s") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->scheduler_duration_s = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "rt_sender_cpu") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->rt_sender_cpu = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "rt_receiver_cpu") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->rt_receiver_cpu = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "rt_rst_cpu") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->rt_rst_cpu = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "rt_fifo_priority") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->rt_fifo_priority = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "rt_mlock") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->rt_mlock = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "tsc") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->tsc = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "perf") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->perf = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "busy_poll_us") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->busy_poll_us = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "xdp") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->xdp = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value, "xdp_interface") ==
+                 0) {
+        yaml_parser_parse(&parser, &event);
+        config->xdp_interface =
+            malloc(strlen((char *)event.data.scalar.value) + 1);
+        if (!config->xdp_interface) {
+          printf("Failed to allocate memory for xdp interface\n");
+          free_config(config); // Free memory allocated for Config struct
+          return NULL;
+        }
+        strcpy(config->xdp_interface, (char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "concurrent_sessions") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->concurrent_sessions = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "interface_budget_kbps") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->interface_budget_kbps = atoi((char *)event.data.scalar.value);
+      } else if (strcmp((char *)event.data.scalar.value,
+                        "admission_guard_ms") == 0) {
+        yaml_parser_parse(&parser, &event);
+        config->admission_guard_ms = atoi((char *)event.data.scalar.value);
       }
 
       break;
@@ -118,6 +381,10 @@ struct Config *parse_config(struct Config *config, char *filename) {
 void free_config(struct Config *config) {
   free(config->mode);
   free(config->server_ip_addr);
+  free(config->cache_path);
+  free(config->result_ring);
+  free(config->targets_file);
+  free(config->xdp_interface);
   free(config);
 }
 
@@ -137,5 +404,98 @@ void print_config(struct Config *config) {
   logger("inter_time_s: %d", config->inter_time_s);
   logger("udp_train_size: %d", config->udp_train_size);
   logger("udp_ttl: %d", config->udp_ttl);
-  logger("rst_timeout_s: %d\n", config->rst_timeout_s);
+  logger("rst_timeout_s: %d", config->rst_timeout_s);
+  logger("inter_packet_delay_us: %d", config->inter_packet_delay_us);
+  logger("sender_threads: %d", config->sender_threads);
+  logger("receiver_shards: %d", config->receiver_shards);
+  logger("txtime: %d", config->txtime);
+  logger("gso_segments: %d", config->gso_segments);
+  logger("sweep_payload_sizes: %d value(s)", config->sweep_payload_count);
+  logger("sweep_entropy: %d value(s)", config->sweep_entropy_count);
+  logger("warmup_trains: %d", config->warmup_trains);
+  logger("warmup_train_size: %d", config->warmup_train_size);
+  logger("warmup_rate_step_pps: %d", config->warmup_rate_step_pps);
+  logger("prime_packets: %d", config->prime_packets);
+  logger("arena_hugepages: %d", config->arena_hugepages);
+  logger("progress_interval_ms: %d", config->progress_interval_ms);
+  logger("abort_loss_percent: %d", config->abort_loss_percent);
+  logger("interleave_pairs: %d", config->interleave_pairs);
+  logger("sub_train_size: %d", config->sub_train_size);
+  logger("interleave_gap_ms: %d", config->interleave_gap_ms);
+  logger("marker_interval: %d", config->marker_interval);
+  logger("marker_port_base: %d", config->marker_port_base);
+  logger("hop_ttl_min: %d", config->hop_ttl_min);
+  logger("hop_ttl_max: %d", config->hop_ttl_max);
+  logger("cache_ttl_s: %d", config->cache_ttl_s);
+  logger("cache_path: %s", config->cache_path != NULL ? config->cache_path
+                                                       : CACHE_DEFAULT_PATH);
+  logger("result_ring: %s",
+         config->result_ring != NULL ? config->result_ring : "(none)");
+  logger("targets_file: %s",
+         config->targets_file != NULL ? config->targets_file : "(none)");
+  logger("measure_period_s: %d", config->measure_period_s);
+  logger("period_jitter_percent: %d", config->period_jitter_percent);
+  logger("scheduler_workers: %d", config->scheduler_workers);
+  logger("global_budget_kbps: %d", config->global_budget_kbps);
+  logger("destination_budget_kbps: %d", config->destination_budget_kbps);
+  logger("scheduler_duration_s: %d", config->scheduler_duration_s);
+  logger("rt_sender_cpu: %d", config->rt_sender_cpu);
+  logger("rt_receiver_cpu: %d", config->rt_receiver_cpu);
+  logger("rt_rst_cpu: %d", config->rt_rst_cpu);
+  logger("rt_fifo_priority: %d", config->rt_fifo_priority);
+  logger("rt_mlock: %d", config->rt_mlock);
+  logger("tsc: %d", config->tsc);
+  logger("perf: %d", config->perf);
+  logger("busy_poll_us: %d", config->busy_poll_us);
+  logger("xdp: %d", config->xdp);
+  logger("xdp_interface: %s", config->xdp_interface != NULL
+                                   ? config->xdp_interface
+                                   : "(none)");
+  logger("concurrent_sessions: %d", config->concurrent_sessions);
+  logger("interface_budget_kbps: %d", config->interface_budget_kbps);
+  logger("admission_guard_ms: %d\n", config->admission_guard_ms);
+}
+
+// Folds the bytes of a field into an FNV-1a hash
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+#define HASH_FIELD(hash, field) hash_bytes(hash, &(field), sizeof(field))
+
+// Hashes the measurement parameters of a config
+uint64_t config_hash(struct Config *config) {
+  uint64_t hash = 14695981039346656037ULL;
+  hash = HASH_FIELD(hash, config->src_port_udp);
+  hash = HASH_FIELD(hash, config->dst_port_udp);
+  hash = HASH_FIELD(hash, config->dst_port_tcp_hsyn);
+  hash = HASH_FIELD(hash, config->dst_port_tcp_tsyn);
+  hash = HASH_FIELD(hash, config->payload_size);
+  hash = HASH_FIELD(hash, config->inter_time_s);
+  hash = HASH_FIELD(hash, config->udp_train_size);
+  hash = HASH_FIELD(hash, config->udp_ttl);
+  hash = HASH_FIELD(hash, config->inter_packet_delay_us);
+  hash = HASH_FIELD(hash, config->sender_threads);
+  hash = HASH_FIELD(hash, config->txtime);
+  hash = HASH_FIELD(hash, config->gso_segments);
+  hash = HASH_FIELD(hash, config->xdp);
+  hash = hash_bytes(hash, config->sweep_payload_sizes,
+                    config->sweep_payload_count * sizeof(int));
+  hash = hash_bytes(hash, config->sweep_entropy,
+                    config->sweep_entropy_count * sizeof(double));
+  hash = HASH_FIELD(hash, config->warmup_trains);
+  hash = HASH_FIELD(hash, config->warmup_train_size);
+  hash = HASH_FIELD(hash, config->warmup_rate_step_pps);
+  hash = HASH_FIELD(hash, config->interleave_pairs);
+  hash = HASH_FIELD(hash, config->sub_train_size);
+  hash = HASH_FIELD(hash, config->interleave_gap_ms);
+  hash = HASH_FIELD(hash, config->marker_interval);
+  hash = HASH_FIELD(hash, config->marker_port_base);
+  hash = HASH_FIELD(hash, config->hop_ttl_min);
+  hash = HASH_FIELD(hash, config->hop_ttl_max);
+  return hash;
 }
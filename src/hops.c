@@ -0,0 +1,370 @@
+#include "../include/hops.h"
+#include "../include/cderror.h"
+#include "../include/logger.h"
+#include "../include/realtime.h"
+#include "../include/ring.h"
+#include "../include/standalone.h"
+#include "../include/tsc.h"
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Answers to the SYNs of one TTL. Index t is the train (0 low, 1 high).
+struct HopProbe {
+  long long head_ns[2]; // arrival of the answers (tsc_now_ns)
+  long long tail_ns[2];
+  int head_seen[2];
+  int tail_seen[2];
+  uint32_t responder; // address that answered, network byte order
+  int reached;        // answered by an RST from the destination
+};
+
+// State shared by the sender and the listener of a hop sweep. The SYNs of
+// train t and TTL ttl_min + i go to port_base + 2 * (t * hops + i) (head)
+// and the port after it (tail).
+struct HopSweep {
+  int hops;
+  int ttl_min;
+  unsigned short port_base;
+  unsigned short src_port;
+  char src_ip[INET_ADDRSTRLEN];
+  uint32_t dst_addr; // network byte order
+  int tcp_sock;      // raw sockets the answers arrive on
+  int icmp_sock;
+  int timeout_s;
+  int error; // set by the listener if its sockets fail
+  char *buf; // PACKET_BUFFER_SIZE bytes to receive the answers in
+  struct HopProbe hop[MAX_HOPS];
+  struct Config *config;
+};
+
+// Port of the head (or tail) SYN of train t and hop i
+static unsigned short hop_port(struct HopSweep *sweep, int t, int i,
+                               int tail) {
+  return sweep->port_base + 2 * (t * sweep->hops + i) + tail;
+}
+
+// Records the answer to the SYN sent to port. Returns 1 if it is the first
+// answer to a SYN of the sweep and 0 otherwise.
+static int record_answer(struct HopSweep *sweep, unsigned short port,
+                         uint32_t responder, int reached, long long ts_ns) {
+  if (port < sweep->port_base || port >= hop_port(sweep, 2, 0, 0)) {
+    return 0;
+  }
+  int k = port - sweep->port_base;
+  int t = k / (2 * sweep->hops);
+  struct HopProbe *hop = &sweep->hop[(k % (2 * sweep->hops)) / 2];
+  int *seen = k % 2 ? &hop->tail_seen[t] : &hop->head_seen[t];
+  if (*seen) {
+    return 0;
+  }
+  *seen = 1;
+  if (k % 2) {
+    hop->tail_ns[t] = ts_ns;
+  } else {
+    hop->head_ns[t] = ts_ns;
+  }
+  hop->responder = responder;
+  hop->reached = reached;
+  return 1;
+}
+
+// Matches an ICMP time exceeded message to a SYN of the sweep, from the IP
+// and TCP headers it quotes
+static int parse_icmp(struct HopSweep *sweep, char *buf, int len,
+                      long long ts_ns) {
+  struct iphdr *iph = (struct iphdr *)buf;
+  int offset = iph->ihl * 4;
+  if (len < offset + (int)sizeof(struct icmphdr) + (int)sizeof(struct iphdr)) {
+    return 0;
+  }
+  struct icmphdr *icmph = (struct icmphdr *)(buf + offset);
+  if (icmph->type != ICMP_TIME_EXCEEDED || icmph->code != ICMP_EXC_TTL) {
+    return 0;
+  }
+  offset += sizeof(struct icmphdr);
+  struct iphdr *quoted = (struct iphdr *)(buf + offset);
+  offset += quoted->ihl * 4;
+  // only the first 8 bytes of the TCP header (the ports) are quoted for sure
+  if (len < offset + 8 || quoted->protocol != IPPROTO_TCP ||
+      quoted->daddr != sweep->dst_addr) {
+    return 0;
+  }
+  struct tcphdr *tcph = (struct tcphdr *)(buf + offset);
+  if (ntohs(tcph->source) != sweep->src_port) {
+    return 0;
+  }
+  return record_answer(sweep, ntohs(tcph->dest), iph->saddr, 0, ts_ns);
+}
+
+// Matches an RST from the destination to a SYN of the sweep
+static int parse_rst(struct HopSweep *sweep, char *buf, int len,
+                     long long ts_ns) {
+  struct iphdr *iph = (struct iphdr *)buf;
+  int offset = iph->ihl * 4;
+  if (len < offset + (int)sizeof(struct tcphdr) ||
+      iph->saddr != sweep->dst_addr) {
+    return 0;
+  }
+  struct tcphdr *tcph = (struct tcphdr *)(buf + offset);
+  if (!tcph->rst || ntohs(tcph->dest) != sweep->src_port) {
+    return 0;
+  }
+  return record_answer(sweep, ntohs(tcph->source), iph->saddr, 1, ts_ns);
+}
+
+// Listener of a hop sweep. It waits on both raw sockets until every SYN was
+// answered or no answer arrived for timeout_s.
+static void *listen_for_answers(void *args) {
+  struct HopSweep *sweep = (struct HopSweep *)args;
+  struct Config *config = sweep->config;
+  int expected = 4 * sweep->hops;
+  int answers = 0;
+  char *buf = sweep->buf;
+
+  apply_realtime_profile(config, config->rt_rst_cpu, RT_ROLE_RST);
+
+  while (answers < expected) {
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(sweep->tcp_sock, &read_fds);
+    FD_SET(sweep->icmp_sock, &read_fds);
+    struct timeval timeout = {.tv_sec = sweep->timeout_s, .tv_usec = 0};
+    int max_fd = sweep->tcp_sock > sweep->icmp_sock ? sweep->tcp_sock
+                                                    : sweep->icmp_sock;
+    int ready_fds = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+    if (ready_fds < 0) {
+      perror("[HOPS] Listening to answers select");
+      sweep->error = CD_ERR_SOCKET;
+      break;
+    } else if (ready_fds == 0) {
+      printf("[HOPS] [ERROR] Timeout reached, stopping the listener.\n");
+      break;
+    }
+
+    if (FD_ISSET(sweep->icmp_sock, &read_fds)) {
+      int len = recv(sweep->icmp_sock, buf, PACKET_BUFFER_SIZE, 0);
+      long long ts_ns = tsc_now_ns();
+      if (len > 0) {
+        answers += parse_icmp(sweep, buf, len, ts_ns);
+      }
+    }
+    if (FD_ISSET(sweep->tcp_sock, &read_fds)) {
+      int len = recv(sweep->tcp_sock, buf, PACKET_BUFFER_SIZE, 0);
+      long long ts_ns = tsc_now_ns();
+      if (len > 0) {
+        answers += parse_rst(sweep, buf, len, ts_ns);
+      }
+    }
+  }
+  logger("[HOPS] %d/%d SYNs answered", answers, expected);
+  return NULL;
+}
+
+// Finds the source address the kernel routes dst_ip from, as the SYNs are
+// built with their IP header and routers must be able to answer them.
+// Returns -1 if there is no route.
+static int route_source(const char *dst_ip, char *src_ip) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9); // any port, nothing is sent
+  addr.sin_addr.s_addr = inet_addr(dst_ip);
+  int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  socklen_t len = sizeof(addr);
+  if (sock_fd < 0 || connect(sock_fd, (struct sockaddr *)&addr, len) < 0 ||
+      getsockname(sock_fd, (struct sockaddr *)&addr, &len) < 0) {
+    if (sock_fd >= 0) {
+      close(sock_fd);
+    }
+    return -1;
+  }
+  close(sock_fd);
+  inet_ntop(AF_INET, &addr.sin_addr, src_ip, INET_ADDRSTRLEN);
+  return 0;
+}
+
+// Sends one train bracketed by the head and tail SYNs of every TTL
+static void send_hop_train(struct HopSweep *sweep, struct TrainSender *sender,
+                           int t, struct TxTime *txtime) {
+  struct Config *config = sweep->config;
+  char *src_ip = sweep->src_ip;
+  char *dst_ip = config->server_ip_addr;
+
+  for (int i = 0; i < sweep->hops; i++) {
+    send_tcp_syn_packet(sender->syn_sock, src_ip, dst_ip, sweep->src_port,
+                        hop_port(sweep, t, i, 0), sweep->ttl_min + i);
+  }
+  if (t == 0) {
+    send_udp_low_entropy_packet_train(sender, config->udp_train_size,
+                                      config->inter_packet_delay_us, txtime,
+                                      NULL);
+  } else {
+    send_udp_high_entropy_packet_train(sender, config->udp_train_size,
+                                       config->inter_packet_delay_us, txtime,
+                                       NULL);
+  }
+  for (int i = 0; i < sweep->hops; i++) {
+    send_tcp_syn_packet(sender->syn_sock, src_ip, dst_ip, sweep->src_port,
+                        hop_port(sweep, t, i, 1), sweep->ttl_min + i);
+  }
+}
+
+// Logs the dispersion at every hop and reports the first hop past the
+// compressing link
+static void report_hops(struct HopSweep *sweep, int64_t started_ns) {
+  struct Config *config = sweep->config;
+  int to_ms = 1000000;
+  int previous_ttl = 0; // last hop measured below the threshold
+  int found = 0;
+  long long found_low = 0, found_high = 0;
+
+  for (int i = 0; i < sweep->hops; i++) {
+    struct HopProbe *hop = &sweep->hop[i];
+    int ttl = sweep->ttl_min + i;
+    char responder[INET_ADDRSTRLEN] = "*";
+    if (hop->responder != 0) {
+      inet_ntop(AF_INET, &hop->responder, responder, sizeof(responder));
+    }
+    if (!hop->head_seen[0] || !hop->tail_seen[0] || !hop->head_seen[1] ||
+        !hop->tail_seen[1]) {
+      logger("[HOPS] TTL %2d %-15s not enough answers", ttl, responder);
+      continue;
+    }
+    long long low = hop->tail_ns[0] - hop->head_ns[0];
+    long long high = hop->tail_ns[1] - hop->head_ns[1];
+    int compressed = high - low > THRESHOLD;
+    logger("[HOPS] TTL %2d %-15s delta_low = %.2f ms, delta_high = %.2f ms, "
+           "delta_diff = %.2f ms%s",
+           ttl, responder, (double)low / to_ms, (double)high / to_ms,
+           (double)(high - low) / to_ms, hop->reached ? " (destination)" : "");
+    if (compressed && !found) {
+      found = ttl;
+      found_low = low;
+      found_high = high;
+    } else if (!compressed && !found) {
+      previous_ttl = ttl;
+      found_low = low;
+      found_high = high;
+    }
+    if (hop->reached) {
+      break; // higher TTLs reach the destination too
+    }
+  }
+
+  if (found && previous_ttl) {
+    printf("[HOPS] Compression detected between TTL %d and TTL %d.\n",
+           previous_ttl, found);
+  } else if (found) {
+    printf("[HOPS] Compression detected before TTL %d.\n", found);
+  } else if (previous_ttl) {
+    printf("[HOPS] No compression was detected up to TTL %d.\n",
+           previous_ttl);
+  } else {
+    printf("[HOPS] Not enough answers received.\n");
+    publish_standalone(config, started_ns, RESULT_FAILED, 0, 0, THRESHOLD,
+                       config->udp_train_size);
+    return;
+  }
+  publish_standalone(config, started_ns,
+                     found ? RESULT_COMPRESSION : RESULT_NONE, found_low,
+                     found_high, THRESHOLD, config->udp_train_size);
+}
+
+// Closes the raw sockets of a hop sweep; its memory goes with the arena of
+// the sender
+static void free_sweep(struct HopSweep *sweep) {
+  if (sweep->tcp_sock >= 0) {
+    close(sweep->tcp_sock);
+  }
+  if (sweep->icmp_sock >= 0) {
+    close(sweep->icmp_sock);
+  }
+}
+
+size_t hop_sweep_size(void) { return sizeof(struct HopSweep); }
+
+// Runs a hop sweep
+int run_hop_sweep(struct Config *config, struct TrainSender *sender,
+                  struct TxTime *txtime, int64_t started_ns) {
+  struct HopSweep *sweep = arena_alloc(&sender->arena, sizeof(*sweep));
+  pthread_t listener;
+
+  if (sweep == NULL) {
+    return CD_ERR_RESOURCE;
+  }
+  sweep->tcp_sock = -1;
+  sweep->icmp_sock = -1;
+
+  sweep->ttl_min = config->hop_ttl_min > 0 ? config->hop_ttl_min : 1;
+  sweep->hops = config->hop_ttl_max - sweep->ttl_min + 1;
+  if (sweep->hops < 1 || sweep->hops > MAX_HOPS) {
+    printf("[HOPS] [ERROR] hop_ttl_max must be between hop_ttl_min and "
+           "hop_ttl_min + %d.\n",
+           MAX_HOPS - 1);
+    free_sweep(sweep);
+    return CD_ERR_CONFIG;
+  }
+  long port_base = config->marker_port_base > 0
+                       ? config->marker_port_base
+                       : config->dst_port_tcp_tsyn + 1;
+  if (check_port_range("[HOPS]", "The hop SYNs", port_base,
+                       port_base + 4L * sweep->hops - 1) != CD_OK) {
+    free_sweep(sweep);
+    return CD_ERR_CONFIG;
+  }
+  sweep->port_base = port_base;
+  sweep->src_port = config->pp_port_tcp;
+  if (route_source(config->server_ip_addr, sweep->src_ip) < 0) {
+    perror("[HOPS] No route to the destination");
+    free_sweep(sweep);
+    return CD_ERR_CONFIG;
+  }
+  sweep->dst_addr = inet_addr(config->server_ip_addr);
+  sweep->timeout_s = config->rst_timeout_s;
+  sweep->buf = sender->listen_buf;
+  sweep->config = config;
+
+  // The raw sockets are opened before the first SYN leaves so no answer is
+  // missed
+  sweep->tcp_sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+  sweep->icmp_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+  if (sweep->tcp_sock < 0 || sweep->icmp_sock < 0) {
+    perror("socket");
+    free_sweep(sweep);
+    return CD_ERR_SOCKET;
+  }
+  if (pthread_create(&listener, NULL, listen_for_answers, sweep) != 0) {
+    perror("pthread_create");
+    free_sweep(sweep);
+    return CD_ERR_RESOURCE;
+  }
+  apply_realtime_profile(config, config->rt_sender_cpu, RT_ROLE_SENDER);
+  usleep(1000); // give some buffer time
+
+  logger("[HOPS] Sweeping TTL %d-%d from %s, SYN ports %d-%d",
+         sweep->ttl_min, config->hop_ttl_max, sweep->src_ip, sweep->port_base,
+         hop_port(sweep, 2, 0, 0) - 1);
+  logger("[HOPS] Sending low entropy UDP packet train");
+  send_hop_train(sweep, sender, 0, txtime);
+  logger("[HOPS] Waiting time between packet trains...");
+  sleep(5);
+  logger("[HOPS] Sending high entropy UDP packet train");
+  send_hop_train(sweep, sender, 1, txtime);
+
+  pthread_join(listener, NULL);
+  int error = sweep->error;
+  if (error == CD_OK) {
+    report_hops(sweep, started_ns);
+  }
+  free_sweep(sweep);
+  return error;
+}
@@ -1,7 +1,9 @@
 #include "../include/main.h"
+#include "../include/cderror.h"
 #include "../include/client.h"
 #include "../include/config.h"
 #include "../include/logger.h"
+#include "../include/scheduler.h"
 #include "../include/server.h"
 #include "../include/standalone.h"
 #include <stdbool.h>
@@ -14,25 +16,32 @@
 struct Args {
   char *filename;
   bool verbose;
+  bool force;
 };
 
 // This function parses command line arguments passed to the program and returns
-// a struct containing the parsed arguments. It supports two flags:
-// -v for enabling verbose mode and
+// a struct containing the parsed arguments. It supports three flags:
+// -v for enabling verbose mode,
+// -f for measuring even if the verdict cache has a fresh verdict and
 // -h for displaying help message.
 // It also takes a mandatory positional argument, which is the name of a file.
 struct Args *get_args(int argc, char *argv[]) {
   int opt;
   struct Args *args = malloc(sizeof(struct Args));
   args->verbose = false;
+  args->force = false;
   args->filename = "";
-  while ((opt = getopt(argc, argv, "vh")) != -1) {
+  while ((opt = getopt(argc, argv, "vfh")) != -1) {
     switch (opt) {
     case 'v':
       /* Handle -v (verbose) flag */
       debug_enabled = 1;
       logger("Running in verbose mode");
       break;
+    case 'f':
+      /* Handle -f (force a fresh measurement) flag */
+      args->force = true;
+      break;
     case 'h':
       /* Handle -h (help) flag */
       printf("%s", HELP_MSG);
@@ -48,7 +57,8 @@ struct Args *get_args(int argc, char *argv[]) {
 // file and runs different functions based on the specified mode in the
 // configuration. It initializes the configuration, parses the configuration
 // file, and executes the appropriate function based on the mode. Finally, it
-// frees the allocated memory for the configuration.
+// frees the allocated memory for the configuration and exits with a failure
+// status if the mode returned an error (whose cause the mode printed).
 int main(int argc, char *argv[]) {
   struct Args *args = get_args(argc, argv);
   if (strcmp(args->filename, "") == 0) {
@@ -61,15 +71,20 @@ int main(int argc, char *argv[]) {
     printf("Something went wrong parsing YAML file.\n");
     exit(1);
   }
+  config->cache_force = args->force;
   if (debug_enabled) {
     print_config(config);
   }
+  int error = CD_OK;
   if (strcmp(config->mode, CLIENT_APP) == 0) {
-    run_client(config);
+    error = run_client(config);
   } else if (strcmp(config->mode, SERVER_APP) == 0) {
-    run_server(config->pp_port_tcp);
+    error = run_server(config);
   } else if (strcmp(config->mode, STANDALONE_APP) == 0) {
-    run_standalone(config);
+    error = run_standalone(config);
+  } else if (strcmp(config->mode, SCHEDULER_APP) == 0) {
+    error = run_scheduler(config);
   }
   free_config(config);
+  return error == CD_OK ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,163 @@
+#include "../include/perf.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Type, config and name of every event
+static const struct {
+  uint32_t type;
+  uint64_t config;
+  const char *name;
+} events[PERF_EVENTS] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                           "instructions"},
+    [PERF_CACHE_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+                           "cache misses"},
+    [PERF_CONTEXT_SWITCHES] = {PERF_TYPE_SOFTWARE,
+                               PERF_COUNT_SW_CONTEXT_SWITCHES,
+                               "context switches"},
+    [PERF_PAGE_FAULTS] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,
+                          "page faults"},
+};
+
+// Events already warned about, so each thread does not repeat it
+static atomic_int warned[PERF_EVENTS];
+
+// Opens one event of the calling thread, in the group of leader (-1 to lead
+// it), counting kernel mode too unless that is not allowed
+static int open_event(int event, int leader) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = events[event].type;
+  attr.config = events[event].config;
+  attr.disabled = leader < 0; // members follow their leader
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+  if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+    attr.exclude_kernel = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+  }
+  if (fd < 0 && !atomic_exchange(&warned[event], 1)) {
+    printf("[PERF] [ERROR] Cannot count %s: %s\n", events[event].name,
+           strerror(errno));
+  }
+  return fd;
+}
+
+// Opens the counters of the calling thread
+int perf_open(struct PerfCounters *counters, int enabled) {
+  counters->leader = -1;
+  counters->opened = 0;
+  for (int e = 0; e < PERF_EVENTS; e++) {
+    counters->fd[e] = -1;
+    counters->slot[e] = -1;
+    if (!enabled) {
+      continue;
+    }
+    counters->fd[e] = open_event(e, counters->leader);
+    if (counters->fd[e] >= 0) {
+      if (counters->leader < 0) {
+        counters->leader = counters->fd[e];
+      }
+      counters->slot[e] = counters->opened++;
+    }
+  }
+  return counters->opened;
+}
+
+// Starts the counters
+void perf_start(struct PerfCounters *counters) {
+  if (counters->leader < 0) {
+    return;
+  }
+  ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Stops the counters and adds their counts to sample
+void perf_stop(struct PerfCounters *counters, struct PerfSample *sample) {
+  if (counters->leader < 0) {
+    return;
+  }
+  ioctl(counters->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // nr, time enabled, time running, then one value per event of the group
+  uint64_t values[3 + PERF_EVENTS];
+  if (read(counters->leader, values, sizeof(values)) <
+      (ssize_t)(3 * sizeof(uint64_t))) {
+    return;
+  }
+  double scale = values[2] > 0 && values[2] < values[1]
+                     ? (double)values[1] / values[2]
+                     : 1.0;
+  for (int e = 0; e < PERF_EVENTS; e++) {
+    int slot = counters->slot[e];
+    if (slot < 0 || (uint64_t)slot >= values[0]) {
+      sample->count[e] = -1;
+    } else if (sample->count[e] >= 0) {
+      sample->count[e] += (int64_t)(values[3 + slot] * scale);
+    }
+  }
+}
+
+// Closes the counters
+void perf_close(struct PerfCounters *counters) {
+  for (int e = 0; e < PERF_EVENTS; e++) {
+    if (counters->fd[e] >= 0) {
+      close(counters->fd[e]);
+      counters->fd[e] = -1;
+    }
+  }
+  counters->leader = -1;
+}
+
+// Clears a sample
+void perf_sample_init(struct PerfSample *sample) {
+  memset(sample, 0, sizeof(*sample));
+}
+
+// Adds one sample to another
+void perf_sample_add(struct PerfSample *sum, struct PerfSample *sample) {
+  for (int e = 0; e < PERF_EVENTS; e++) {
+    if (sum->count[e] < 0 || sample->count[e] < 0) {
+      sum->count[e] = -1;
+    } else {
+      sum->count[e] += sample->count[e];
+    }
+  }
+}
+
+// Prints the counts of a loop per packet
+void perf_report(const char *loop, struct PerfSample *sample, long packets) {
+  char line[512];
+  int len = snprintf(line, sizeof(line),
+                     "[PERF] %s: %ld packets, per packet:", loop, packets);
+  for (int e = 0; e < PERF_EVENTS && len < (int)sizeof(line); e++) {
+    if (sample->count[e] < 0) {
+      len += snprintf(line + len, sizeof(line) - len, "%s %s n/a",
+                      e == 0 ? "" : ",", events[e].name);
+    } else {
+      len += snprintf(line + len, sizeof(line) - len, "%s %.3g %s",
+                      e == 0 ? "" : ",",
+                      packets > 0 ? (double)sample->count[e] / packets : 0.0,
+                      events[e].name);
+    }
+  }
+  if (sample->count[PERF_CYCLES] > 0 && sample->count[PERF_INSTRUCTIONS] >= 0 &&
+      len < (int)sizeof(line)) {
+    snprintf(line + len, sizeof(line) - len, " (IPC %.2f)",
+             (double)sample->count[PERF_INSTRUCTIONS] /
+                 sample->count[PERF_CYCLES]);
+  }
+  printf("%s\n", line);
+}
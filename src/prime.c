@@ -0,0 +1,82 @@
+#include "../include/prime.h"
+#include "../include/logger.h"
+#include "../include/probe.h"
+#include "../include/tsc.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Page faults (minor and major) the process took so far
+static long page_faults(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) < 0) {
+    return 0;
+  }
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+// Starts the priming stage
+void prime_begin(struct Priming *priming) {
+  memset(priming, 0, sizeof(*priming));
+  priming->started_ns = tsc_now_ns();
+  priming->faults = page_faults();
+}
+
+// Touches every page of the buffer and locks it
+void prime_buffer(struct Priming *priming, void *buf, size_t len) {
+  if (buf == NULL || len == 0) {
+    return;
+  }
+  long page_size = sysconf(_SC_PAGESIZE);
+  volatile char *p = buf;
+  for (size_t i = 0; i < len; i += page_size) {
+    p[i] = p[i];
+  }
+  p[len - 1] = p[len - 1];
+  priming->buffers++;
+  if (mlock(buf, len) == 0) {
+    priming->locked_bytes += len;
+  } else {
+    priming->lock_failures++;
+  }
+}
+
+// Sends the untimed packets of a socket
+void prime_socket(struct Priming *priming, int sock_fd,
+                  const struct sockaddr_in *dst, char *payload,
+                  int payload_size, int packets) {
+  for (int i = 0; i < packets; i++) {
+    write_probe_header(payload, PRIME_TRAIN_ID, i, 0);
+    int sent = dst != NULL
+                   ? sendto(sock_fd, payload, payload_size, 0,
+                            (const struct sockaddr *)dst, sizeof(*dst))
+                   : send(sock_fd, payload, payload_size, 0);
+    if (sent > 0) {
+      priming->packets++;
+    }
+  }
+  if (packets > 0 && dst == NULL &&
+      priming->socket_count < PRIME_MAX_SOCKETS) {
+    priming->sockets[priming->socket_count++] = sock_fd;
+  }
+}
+
+// Settles the priming packets and logs the cost of the stage
+void prime_end(struct Priming *priming, const char *tag) {
+  if (priming->packets > 0) {
+    usleep(PRIME_SETTLE_US);
+  }
+  for (int i = 0; i < priming->socket_count; i++) {
+    int error;
+    socklen_t len = sizeof(error);
+    getsockopt(priming->sockets[i], SOL_SOCKET, SO_ERROR, &error, &len);
+  }
+  long long elapsed_ns = tsc_now_ns() - priming->started_ns;
+  logger("%s Primed %d packets, %d buffers (%zu bytes locked%s) in %.2f ms, "
+         "%ld page faults",
+         tag, priming->packets, priming->buffers, priming->locked_bytes,
+         priming->lock_failures > 0 ? ", RLIMIT_MEMLOCK reached" : "",
+         elapsed_ns / 1e6, page_faults() - priming->faults);
+}
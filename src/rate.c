@@ -0,0 +1,60 @@
+#include "../include/rate.h"
+
+// Starts the controller at initial_pps
+void rate_init(struct RateController *rate, int initial_pps, int step_pps) {
+  if (initial_pps < RATE_MIN_PPS) {
+    initial_pps = RATE_MIN_PPS;
+  } else if (initial_pps > RATE_MAX_PPS) {
+    initial_pps = RATE_MAX_PPS;
+  }
+  rate->rate_pps = initial_pps;
+  rate->step_pps = step_pps > 0 ? step_pps : 1;
+  rate->best_pps = 0;
+}
+
+// Additive increase after a lossless train, multiplicative decrease otherwise
+void rate_update(struct RateController *rate, int received, int lost) {
+  if (lost == 0 && received > 0) {
+    if (rate->rate_pps > rate->best_pps) {
+      rate->best_pps = rate->rate_pps;
+    }
+    rate->rate_pps += rate->step_pps;
+  } else {
+    rate->rate_pps /= 2;
+  }
+  if (rate->rate_pps < RATE_MIN_PPS) {
+    rate->rate_pps = RATE_MIN_PPS;
+  } else if (rate->rate_pps > RATE_MAX_PPS) {
+    rate->rate_pps = RATE_MAX_PPS;
+  }
+}
+
+// Highest lossless rate, or the last rate if there was none
+int rate_result(struct RateController *rate) {
+  return rate->best_pps > 0 ? rate->best_pps : rate->rate_pps;
+}
+
+// Aggregate rate of senders that each wait inter_packet_delay_us
+int delay_to_rate(int inter_packet_delay_us, int senders) {
+  if (inter_packet_delay_us <= 0) {
+    return RATE_MAX_PPS;
+  }
+  long rate = 1000000L * senders / inter_packet_delay_us;
+  return rate > RATE_MAX_PPS ? RATE_MAX_PPS : (int)rate;
+}
+
+// Delay each of the senders waits between packets to reach rate_pps together
+int rate_to_delay(int rate_pps, int senders) {
+  if (rate_pps >= RATE_MAX_PPS) {
+    return 0;
+  }
+  return (int)(1000000L * senders / rate_pps);
+}
+
+// IPv4 and UDP headers in front of each payload
+#define UDP_HEADERS_SIZE 28
+
+// Bandwidth of a train of rate_pps packets, headers included
+long train_rate_kbps(int payload_size, int rate_pps) {
+  return (long)(payload_size + UDP_HEADERS_SIZE) * 8 * rate_pps / 1000;
+}
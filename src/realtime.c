@@ -0,0 +1,119 @@
+#define _GNU_SOURCE
+#include "../include/realtime.h"
+#include "../include/config.h"
+#include "../include/logger.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Returns non-zero if any option of the realtime block was set in the config
+int realtime_enabled(struct Config *config) {
+  return config->rt_sender_cpu >= 0 || config->rt_receiver_cpu >= 0 ||
+         config->rt_rst_cpu >= 0 || config->rt_fifo_priority > 0 ||
+         config->rt_mlock;
+}
+
+// Locks current and future pages of the process into RAM. mlockall is process
+// wide, so it is only attempted once no matter how many threads ask for it.
+static int lock_memory(void) {
+  static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  static int locked = 0;
+  static int result = 0;
+
+  pthread_mutex_lock(&lock);
+  if (!locked) {
+    locked = 1;
+    result = mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno;
+  }
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+// Applies the realtime profile to the calling thread and prints the policy
+// that was actually granted. Any option that cannot be granted (missing
+// CAP_SYS_NICE / CAP_IPC_LOCK, offline CPU...) is reported and the thread keeps
+// running with whatever it already had.
+int apply_realtime_profile(struct Config *config, int cpu, const char *role) {
+  int status = 0;
+  if (!realtime_enabled(config)) {
+    return 0;
+  }
+
+  // Pin thread to CPU
+  if (cpu >= 0) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (err != 0) {
+      printf("[REALTIME] [ERROR] %s: could not pin to cpu %d: %s\n", role, cpu,
+             strerror(err));
+      status = -1;
+    }
+  }
+
+  // Switch to SCHED_FIFO
+  if (config->rt_fifo_priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = config->rt_fifo_priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+      printf("[REALTIME] [ERROR] %s: SCHED_FIFO priority %d denied: %s\n",
+             role, config->rt_fifo_priority, strerror(err));
+      status = -1;
+    }
+  }
+
+  // Lock memory
+  int mlock_err = 0;
+  if (config->rt_mlock) {
+    mlock_err = lock_memory();
+    if (mlock_err != 0) {
+      printf("[REALTIME] [ERROR] %s: mlockall failed: %s\n", role,
+             strerror(mlock_err));
+      status = -1;
+    }
+  }
+
+  // Report what was actually granted
+  int policy;
+  struct sched_param granted;
+  pthread_getschedparam(pthread_self(), &policy, &granted);
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  char cpus[32] = "any";
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0 &&
+      CPU_COUNT(&cpuset) == 1) {
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &cpuset)) {
+        snprintf(cpus, sizeof(cpus), "%d", i);
+        break;
+      }
+    }
+  }
+  printf("[REALTIME] %s: policy=%s priority=%d cpu=%s memory=%s\n", role,
+         policy == SCHED_FIFO ? "SCHED_FIFO"
+         : policy == SCHED_RR ? "SCHED_RR"
+                              : "SCHED_OTHER",
+         granted.sched_priority, cpus,
+         config->rt_mlock && mlock_err == 0 ? "locked" : "unlocked");
+  return status;
+}
+
+// Writes to one byte of every page in the buffer so that the kernel backs it
+// with physical memory before it is used in a timed loop
+void prefault_buffer(void *buf, size_t len) {
+  long page_size = sysconf(_SC_PAGESIZE);
+  volatile char *p = buf;
+  for (size_t i = 0; i < len; i += page_size) {
+    p[i] = p[i];
+  }
+  if (len > 0) {
+    p[len - 1] = p[len - 1];
+  }
+}
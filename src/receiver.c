@@ -0,0 +1,930 @@
+#include "../include/receiver.h"
+#include "../include/arena.h"
+#include "../include/config.h"
+#include "../include/logger.h"
+#include "../include/perf.h"
+#include "../include/probe.h"
+#include "../include/realtime.h"
+#include "../include/sockbuf.h"
+#include "../include/tsc.h"
+#include "../include/xdp.h"
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Packets tracked by the duplicate window of a train. Packets more than this
+// far behind the highest sequence number seen are counted without checking
+// for duplicates.
+#define DUPLICATE_WINDOW 65536
+#define DUPLICATE_WINDOW_WORDS (DUPLICATE_WINDOW / 64)
+
+// Streaming statistics of a train, updated by every shard under its lock.
+// Memory does not depend on the train length: duplicates are detected in a
+// sliding bitmap of the last DUPLICATE_WINDOW sequence numbers and
+// inter-arrival times are summarized with Welford's online algorithm.
+struct TrainAccumulator {
+  pthread_mutex_t lock;
+  uint64_t window[DUPLICATE_WINDOW_WORDS]; // bit seq % DUPLICATE_WINDOW
+  uint32_t window_base; // lowest sequence number tracked by the window
+  int duplicates;
+  int reordered;
+  long long max_seq; // -1 until the first packet
+  long long head_ns; // arrival of packet 0, 0 if lost
+  long long tail_ns; // arrival of packet train_size - 1, 0 if lost
+  long long prev_ns; // previous arrival, for the inter-arrival times
+  long gaps;         // Welford state of the inter-arrival times (ns)
+  double gap_mean;
+  double gap_m2;
+  uint64_t head_send_ns; // send stamp of packet 0, 0 if lost or unstamped
+  uint64_t tail_send_ns; // send stamp of packet train_size - 1
+  uint64_t send_min_ns;  // earliest and latest send stamps
+  uint64_t send_max_ns;
+  long stamped;       // packets carrying a send stamp
+  long long owd_ref;  // one-way delay of the first of them; the others are
+                      // kept relative to it so the Welford state stays small
+  long long owd_min;  // relative one-way delays (ns)
+  long long owd_max;
+  double owd_mean;
+  double owd_m2;
+};
+
+// Progress of a train, shared by all shards and read by the coordinator
+struct TrainProgress {
+  atomic_int received;
+  atomic_llong first_ns; // arrival of the first packet, 0 until then
+  atomic_int tail_seen;
+  atomic_int kernel_drops; // reported by SO_RXQ_OVFL while it was received
+  atomic_llong last_ns;    // latest arrival
+  atomic_llong max_gap_ns; // largest gap between consecutive arrivals
+  struct TrainAccumulator acc;
+};
+
+// A receiver shard: one socket bound to the probing port and one thread,
+// plus an AF_XDP socket on queue shard_id when the port is steered to it
+struct Shard {
+  int shard_id;
+  int sock_fd;
+  struct XdpSocket *xsk; // NULL without AF_XDP
+  int epoll_fd;
+  char *payload;
+  int count; // packets of the current run received by this shard
+  uint32_t drops;      // drops already charged to a train
+  uint32_t sock_drops; // last SO_RXQ_OVFL counter of the socket
+  uint32_t xsk_drops;  // last XDP_STATISTICS drops of the AF_XDP socket
+  pthread_t thread;
+  struct Receiver *receiver;
+};
+
+struct Receiver {
+  struct Config *config;
+  struct Arena *arena; // the receiver and its buffers are carved from it
+  int shards;
+  struct Shard *shard;
+  struct XdpSteering *steering; // steers the port into the shards, or NULL
+  int max_payload_size;
+  int stop_fd;     // eventfd, readable once the current run is over
+  atomic_int stopping; // set with stop_fd, polled by spinning shards
+  int progress_fd; // eventfd, written by shards when a train makes progress
+  int closing;
+  pthread_mutex_t gate;    // held by receiver_open while it starts the shards
+  pthread_barrier_t start; // shards start receiving a run
+  pthread_barrier_t end;   // shards are done with a run
+  struct TrainSchedule *schedule;
+  struct TrainProgress *progress;
+  atomic_int current; // index of the train being received, -1 between runs
+  atomic_int aborted; // set by receiver_abort, ends the run
+  pthread_mutex_t report_lock; // guards progress against receiver_report
+  struct PerfSample perf; // counters of the shards over the last run
+};
+
+// Creates a non-blocking UDP socket bound to the probing port. SO_REUSEPORT is
+// set so that several receiver shards can bind the same port and let the
+// kernel spread the sender flows between them. The receive buffer is sized to
+// hold rcvbuf_bytes and SO_RXQ_OVFL is enabled so that every packet carries
+// the number of packets the kernel dropped on the socket so far. With
+// busy_poll_us set, the socket is prepared for a spinning shard.
+static int create_shard_socket(int port, int rcvbuf_bytes, int busy_poll_us) {
+  int sock_fd;
+  struct sockaddr_in server_addr;
+
+  if ((sock_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0)) < 0) {
+    perror("[PROBING PHASE] Error creating UDP socket for probing phase");
+    return -1;
+  }
+
+  int optval = 1;
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) <
+      0) {
+    perror("[PROBING PHASE] Failed to set SO_REUSEPORT option");
+    close(sock_fd);
+    return -1;
+  }
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_RXQ_OVFL, &optval, sizeof(optval)) <
+      0) {
+    perror("[PROBING PHASE] Failed to set SO_RXQ_OVFL option");
+    close(sock_fd);
+    return -1;
+  }
+  size_socket_buffer(sock_fd, SOCKBUF_RECEIVE, rcvbuf_bytes);
+  if (busy_poll_us > 0) {
+    enable_busy_poll(sock_fd, busy_poll_us);
+  }
+
+  // set server address
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = INADDR_ANY;
+  server_addr.sin_port = htons(port);
+
+  // bind socket to server address
+  if (bind(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    perror("[PROBING PHASE] Failed binding server socket");
+    close(sock_fd);
+    return -1;
+  }
+  return sock_fd;
+}
+
+// Slides the duplicate window so that it ends at seq, clearing the bits of
+// the sequence numbers that fall out of it
+static void slide_window(struct TrainAccumulator *acc, uint32_t seq) {
+  uint32_t base = seq - DUPLICATE_WINDOW + 1;
+  if (base - acc->window_base >= DUPLICATE_WINDOW) {
+    memset(acc->window, 0, sizeof(acc->window));
+  } else {
+    for (uint32_t s = acc->window_base; s != base; s++) {
+      acc->window[(s % DUPLICATE_WINDOW) / 64] &=
+          ~(1ULL << (s % DUPLICATE_WINDOW % 64));
+    }
+  }
+  acc->window_base = base;
+}
+
+// Adds the send stamp of a packet to the statistics of its train. Its
+// one-way delay is the arrival minus the send stamp: the offset between the
+// two clocks is unknown, but it is the same for every packet, so the
+// variation of the delay is the jitter added between the two hosts.
+static void accumulate_send_stamp(struct TrainAccumulator *acc, uint32_t seq,
+                                  int train_size, long long ts_ns,
+                                  uint64_t send_ns) {
+  if (seq == 0) {
+    acc->head_send_ns = send_ns;
+  } else if (seq == (uint32_t)train_size - 1) {
+    acc->tail_send_ns = send_ns;
+  }
+  if (acc->stamped == 0 || send_ns < acc->send_min_ns) {
+    acc->send_min_ns = send_ns;
+  }
+  if (send_ns > acc->send_max_ns) {
+    acc->send_max_ns = send_ns;
+  }
+
+  long long owd = ts_ns - (long long)send_ns;
+  if (acc->stamped == 0) {
+    acc->owd_ref = owd;
+  }
+  owd -= acc->owd_ref;
+  if (acc->stamped == 0 || owd < acc->owd_min) {
+    acc->owd_min = owd;
+  }
+  if (acc->stamped == 0 || owd > acc->owd_max) {
+    acc->owd_max = owd;
+  }
+  acc->stamped++;
+  double delta = owd - acc->owd_mean;
+  acc->owd_mean += delta / acc->stamped;
+  acc->owd_m2 += delta * (owd - acc->owd_mean);
+}
+
+// Adds one packet to the streaming statistics of its train. Returns 1 if it
+// is the first copy of its sequence number and 0 for a duplicate.
+static int accumulate_packet(struct TrainAccumulator *acc, uint32_t seq,
+                             int train_size, long long ts_ns,
+                             uint64_t send_ns) {
+  if (seq >= acc->window_base + DUPLICATE_WINDOW) {
+    slide_window(acc, seq);
+  }
+  if (seq >= acc->window_base) {
+    uint64_t *word = &acc->window[(seq % DUPLICATE_WINDOW) / 64];
+    uint64_t bit = 1ULL << (seq % DUPLICATE_WINDOW % 64);
+    if (*word & bit) {
+      acc->duplicates++;
+      return 0;
+    }
+    *word |= bit;
+  }
+
+  if ((long long)seq < acc->max_seq) {
+    acc->reordered++;
+  } else {
+    acc->max_seq = seq;
+  }
+  if (seq == 0) {
+    acc->head_ns = ts_ns;
+  } else if (seq == (uint32_t)train_size - 1) {
+    acc->tail_ns = ts_ns;
+  }
+
+  // shards timestamp before taking the lock, so arrivals can be out of order
+  // by a few us; those gaps count as 0
+  if (acc->prev_ns != 0) {
+    double gap = ts_ns > acc->prev_ns ? (double)(ts_ns - acc->prev_ns) : 0;
+    acc->gaps++;
+    double delta = gap - acc->gap_mean;
+    acc->gap_mean += delta / acc->gaps;
+    acc->gap_m2 += delta * (gap - acc->gap_mean);
+  }
+  if (ts_ns > acc->prev_ns) {
+    acc->prev_ns = ts_ns;
+  }
+  if (send_ns != 0) {
+    accumulate_send_stamp(acc, seq, train_size, ts_ns, send_ns);
+  }
+  return 1;
+}
+
+// Records one packet and updates the progress of its train. The coordinator
+// is woken up when a train starts, when its tail arrives and when it is full.
+// Kernel drops since the previous packet of the shard (drops is the sum of
+// the socket's SO_RXQ_OVFL and AF_XDP drop counters) are charged to the train
+// of this packet, as they were queued behind the same packets; drops after
+// the last received packet of a train therefore show up on the next one.
+static void record_packet(struct Shard *shard, char *payload, int len,
+                          long long ts_ns, uint32_t drops) {
+  struct Receiver *receiver = shard->receiver;
+  struct TrainSchedule *schedule = receiver->schedule;
+  int train_id;
+  uint32_t seq;
+  uint64_t send_ns;
+
+  if (len < PROBE_HEADER_SIZE ||
+      read_probe_header(payload, &train_id, &seq, &send_ns) < 0) {
+    return; // not a probe or another header version
+  }
+  int t = train_id - schedule->first_train_id;
+  if (t < 0 || t >= schedule->trains || seq >= (uint32_t)schedule->train_size) {
+    return; // not part of this run
+  }
+  shard->count++;
+
+  struct TrainProgress *progress = &receiver->progress[t];
+  if (drops != shard->drops) {
+    atomic_fetch_add(&progress->kernel_drops, (int)(drops - shard->drops));
+    shard->drops = drops;
+  }
+  pthread_mutex_lock(&progress->acc.lock);
+  int first_copy = accumulate_packet(&progress->acc, seq,
+                                     schedule->train_size, ts_ns, send_ns);
+  pthread_mutex_unlock(&progress->acc.lock);
+  if (!first_copy) {
+    return;
+  }
+  int received = atomic_fetch_add(&progress->received, 1) + 1;
+  int notify = received == schedule->train_size;
+  long long previous_ns = atomic_exchange(&progress->last_ns, ts_ns);
+  if (received == 1) {
+    long long none = 0;
+    atomic_compare_exchange_strong(&progress->first_ns, &none, ts_ns);
+    notify = 1;
+  } else if (previous_ns != 0 && ts_ns > previous_ns) {
+    long long gap_ns = ts_ns - previous_ns;
+    long long max_gap_ns = atomic_load(&progress->max_gap_ns);
+    while (gap_ns > max_gap_ns &&
+           !atomic_compare_exchange_weak(&progress->max_gap_ns, &max_gap_ns,
+                                         gap_ns)) {
+    }
+  }
+  if (seq == (uint32_t)schedule->train_size - 1) {
+    atomic_store(&progress->tail_seen, 1);
+    notify = 1;
+  }
+  if (notify) {
+    eventfd_write(receiver->progress_fd, 1);
+  }
+}
+
+// Reads the SO_RXQ_OVFL counter attached to a received message, or returns
+// the previous value if the kernel did not attach one
+static uint32_t read_drop_counter(struct msghdr *msg, uint32_t previous) {
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+      uint32_t drops;
+      memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+      return drops;
+    }
+  }
+  return previous;
+}
+
+// Reads every packet queued on the socket of a shard
+static void drain_socket(struct Shard *shard) {
+  struct Receiver *receiver = shard->receiver;
+  char control[CMSG_SPACE(sizeof(uint32_t))];
+
+  for (;;) {
+    struct iovec iov = {.iov_base = shard->payload,
+                        .iov_len = receiver->max_payload_size};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int len = recvmsg(shard->sock_fd, &msg, MSG_DONTWAIT);
+    if (len < 0) {
+      break; // drained
+    }
+    shard->sock_drops = read_drop_counter(&msg, shard->sock_drops);
+    record_packet(shard, shard->payload, len, tsc_now_ns(),
+                  shard->sock_drops + shard->xsk_drops);
+  }
+}
+
+// Reads every frame queued on the AF_XDP socket of a shard. Payloads are
+// read in place in the UMEM and their frames go back to the fill ring a
+// batch at a time.
+static void drain_xsk(struct Shard *shard) {
+  struct XdpFrame frames[XDP_RX_BATCH];
+  int received = 0;
+  int n;
+
+  while ((n = xdp_rx_peek(shard->xsk, frames, XDP_RX_BATCH)) > 0) {
+    for (int i = 0; i < n; i++) {
+      char *payload;
+      int len = xdp_udp_payload(frames[i].data, frames[i].len, &payload);
+      if (len >= 0) {
+        record_packet(shard, payload, len, tsc_now_ns(),
+                      shard->sock_drops + shard->xsk_drops);
+      }
+    }
+    xdp_rx_release(shard->xsk, n);
+    received += n;
+  }
+  if (received > 0) {
+    shard->xsk_drops = xdp_rx_dropped(shard->xsk);
+  }
+}
+
+// Reads everything queued on the sockets of a shard
+static void drain_shard(struct Shard *shard) {
+  if (shard->xsk != NULL) {
+    drain_xsk(shard);
+  }
+  drain_socket(shard);
+}
+
+// Receive loop of a shard for one run: waits on its sockets and on the stop
+// eventfd, draining every queued packet on each wakeup
+static void receive_until_stopped(struct Shard *shard) {
+  struct Receiver *receiver = shard->receiver;
+  struct epoll_event events[3];
+
+  for (;;) {
+    int n = epoll_wait(shard->epoll_fd, events, 3, -1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      perror("[PROBING PHASE] epoll_wait");
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.fd == receiver->stop_fd) {
+        return;
+      }
+    }
+    drain_shard(shard);
+  }
+}
+
+// Busy-poll variant of receive_until_stopped: the shard never sleeps, it
+// keeps reading its non-blocking socket until the run is stopped, so every
+// packet is timestamped as soon as it is queued instead of after an interrupt
+// and a wakeup. It keeps its CPU busy for the whole run, so it should be
+// pinned (rt_receiver_cpu) to a core of its own.
+static void spin_until_stopped(struct Shard *shard) {
+  while (!atomic_load_explicit(&shard->receiver->stopping,
+                               memory_order_relaxed)) {
+    drain_shard(shard);
+  }
+}
+
+// Body of a shard thread. The realtime profile is applied once; the thread
+// then serves one run per start barrier until the receiver is closed. With
+// config->perf set, each run is counted with the thread's perf_event_open
+// counters and added to the receiver's sample.
+static void *shard_thread(void *args) {
+  struct Shard *shard = (struct Shard *)args;
+  struct Receiver *receiver = shard->receiver;
+  struct Config *config = receiver->config;
+  struct PerfCounters counters;
+
+  prefault_buffer(shard->payload, receiver->max_payload_size);
+  apply_realtime_profile(config,
+                         config->rt_receiver_cpu < 0
+                             ? -1
+                             : config->rt_receiver_cpu + shard->shard_id,
+                         RT_ROLE_RECEIVER);
+  perf_open(&counters, config->perf);
+  // the barriers are sized once every shard thread was started
+  pthread_mutex_lock(&receiver->gate);
+  pthread_mutex_unlock(&receiver->gate);
+
+  for (;;) {
+    pthread_barrier_wait(&receiver->start);
+    if (receiver->closing) {
+      break;
+    }
+    struct PerfSample sample;
+    perf_sample_init(&sample);
+    perf_start(&counters);
+    if (config->busy_poll_us > 0) {
+      spin_until_stopped(shard);
+    } else {
+      receive_until_stopped(shard);
+    }
+    perf_stop(&counters, &sample);
+    pthread_mutex_lock(&receiver->report_lock);
+    perf_sample_add(&receiver->perf, &sample);
+    pthread_mutex_unlock(&receiver->report_lock);
+    pthread_barrier_wait(&receiver->end);
+  }
+  perf_close(&counters);
+  return NULL;
+}
+
+// Steers the probing port of config->xdp_interface into one AF_XDP socket
+// per shard, shard k taking queue k. The UDP sockets of the shards stay open
+// for the probe packets the program passes on (e.g. those arriving on a queue
+// without a shard). An interface takes a single program, so it also fails
+// while another session steers it. On failure a warning is printed and the
+// shards only use their UDP sockets.
+static void open_xdp_shards(struct Receiver *receiver, int port) {
+  struct Config *config = receiver->config;
+  if (config->xdp_interface == NULL) {
+    printf("[XDP] [ERROR] xdp_interface is not set, falling back to "
+           "sockets\n");
+    return;
+  }
+  int ifindex = (int)if_nametoindex(config->xdp_interface);
+  if (ifindex == 0 ||
+      receiver->max_payload_size + XDP_HEADERS_SIZE > XDP_FRAME_SIZE) {
+    printf("[XDP] [ERROR] Cannot receive payloads of %d bytes on %s, falling "
+           "back to sockets\n",
+           receiver->max_payload_size, config->xdp_interface);
+    return;
+  }
+  receiver->steering =
+      xdp_steer_open(ifindex, port, config->xdp, receiver->shards);
+  for (int i = 0; receiver->steering != NULL && i < receiver->shards; i++) {
+    struct Shard *shard = &receiver->shard[i];
+    shard->xsk = xdp_open(ifindex, i, config->xdp, XDP_RX_FRAMES, 0);
+    if (shard->xsk == NULL ||
+        xdp_steer_add(receiver->steering, i, shard->xsk) < 0) {
+      for (int j = 0; j <= i; j++) {
+        xdp_close(receiver->shard[j].xsk);
+        receiver->shard[j].xsk = NULL;
+      }
+      xdp_steer_close(receiver->steering);
+      receiver->steering = NULL;
+    }
+  }
+  if (receiver->steering == NULL) {
+    printf("[XDP] [ERROR] Falling back to sockets on %s\n",
+           config->xdp_interface);
+    return;
+  }
+  logger("[XDP] Steering UDP port %d of %s into %d AF_XDP socket(s) (%s "
+         "mode)",
+         port, config->xdp_interface, receiver->shards,
+         xdp_mode_name(config->xdp));
+}
+
+// Arena a receiver and the progress of its runs take
+size_t receiver_arena_size(struct Config *config, int max_payload_size,
+                           int trains) {
+  int shards = config->receiver_shards > 0 ? config->receiver_shards : 1;
+  return ARENA_BLOCK(sizeof(struct Receiver)) +
+         ARENA_BLOCK(shards * sizeof(struct Shard)) +
+         shards * ARENA_BLOCK(max_payload_size) +
+         ARENA_BLOCK(trains * sizeof(struct TrainProgress));
+}
+
+// Adds fd to the input events of an epoll instance
+static int watch_input(int epoll_fd, int fd) {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+// Opens the socket of a shard and the epoll instance its thread waits on.
+// Returns 0, or -1 with neither left open.
+static int open_shard(struct Receiver *receiver, struct Shard *shard, int port,
+                      int max_packets) {
+  struct Config *config = receiver->config;
+  // a single flow may land on any shard, so each can queue a whole run
+  shard->sock_fd = create_shard_socket(
+      port, train_buffer_bytes(max_packets, receiver->max_payload_size),
+      config->busy_poll_us);
+  if (shard->sock_fd < 0) {
+    return -1;
+  }
+  shard->epoll_fd = epoll_create1(0);
+  if (shard->epoll_fd < 0 ||
+      watch_input(shard->epoll_fd, shard->sock_fd) < 0 ||
+      watch_input(shard->epoll_fd, receiver->stop_fd) < 0 ||
+      (shard->xsk != NULL &&
+       watch_input(shard->epoll_fd, xdp_fd(shard->xsk)) < 0)) {
+    perror("[PROBING PHASE] Failed creating the shard epoll instance");
+    if (shard->epoll_fd >= 0) {
+      close(shard->epoll_fd);
+    }
+    close(shard->sock_fd);
+    return -1;
+  }
+  if (shard->xsk != NULL && config->busy_poll_us > 0) {
+    enable_busy_poll(xdp_fd(shard->xsk), config->busy_poll_us);
+  }
+  return 0;
+}
+
+// Releases a receiver whose first opened shards have a socket, the first
+// started of them a thread. The threads are let through the start barrier
+// with closing set and joined; the barriers are left to the caller.
+static void release_receiver(struct Receiver *receiver, int opened,
+                             int started) {
+  receiver->closing = 1;
+  if (started > 0) {
+    pthread_barrier_wait(&receiver->start);
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(receiver->shard[i].thread, NULL);
+  }
+  xdp_steer_close(receiver->steering);
+  for (int i = 0; i < receiver->shards; i++) {
+    struct Shard *shard = &receiver->shard[i];
+    if (i < opened) {
+      close(shard->epoll_fd);
+      close(shard->sock_fd);
+    }
+    xdp_close(shard->xsk);
+  }
+  pthread_mutex_destroy(&receiver->gate);
+  pthread_mutex_destroy(&receiver->report_lock);
+  close(receiver->stop_fd);
+  close(receiver->progress_fd);
+}
+
+// Opens the shards of a receiver and starts their threads. On failure
+// everything opened so far is released, as a shard left bound to port would
+// take packets of the next receiver on it.
+struct Receiver *receiver_open(struct Config *config, struct Arena *arena,
+                               int port, int max_payload_size,
+                               int max_packets) {
+  int shards = config->receiver_shards > 0 ? config->receiver_shards : 1;
+  struct Receiver *receiver = arena_alloc(arena, sizeof(struct Receiver));
+  struct Shard *shard_array =
+      arena_alloc(arena, shards * sizeof(struct Shard));
+  if (receiver == NULL || shard_array == NULL) {
+    return NULL;
+  }
+  for (int i = 0; i < shards; i++) {
+    shard_array[i].payload = arena_alloc(arena, max_payload_size);
+    if (shard_array[i].payload == NULL) {
+      return NULL;
+    }
+  }
+  receiver->config = config;
+  receiver->arena = arena;
+  receiver->shards = shards;
+  receiver->shard = shard_array;
+  receiver->max_payload_size = max_payload_size;
+  receiver->stop_fd = eventfd(0, EFD_NONBLOCK);
+  receiver->progress_fd = eventfd(0, EFD_NONBLOCK);
+  if (receiver->stop_fd < 0 || receiver->progress_fd < 0) {
+    perror("[PROBING PHASE] eventfd");
+    if (receiver->stop_fd >= 0) {
+      close(receiver->stop_fd);
+    }
+    if (receiver->progress_fd >= 0) {
+      close(receiver->progress_fd);
+    }
+    return NULL;
+  }
+  pthread_mutex_init(&receiver->gate, NULL);
+  pthread_mutex_init(&receiver->report_lock, NULL);
+  atomic_store(&receiver->current, -1);
+  if (config->xdp != XDP_OFF) {
+    open_xdp_shards(receiver, port);
+  }
+
+  int opened = 0;
+  for (; opened < shards; opened++) {
+    struct Shard *shard = &receiver->shard[opened];
+    shard->shard_id = opened;
+    shard->receiver = receiver;
+    if (open_shard(receiver, shard, port, max_packets) < 0) {
+      release_receiver(receiver, opened, 0);
+      return NULL;
+    }
+  }
+
+  // The barriers are sized once the threads are started, which wait on the
+  // gate until then. If one cannot be started, the ones that were are
+  // released through the start barrier.
+  int started = 0;
+  pthread_mutex_lock(&receiver->gate);
+  for (; started < shards; started++) {
+    struct Shard *shard = &receiver->shard[started];
+    int rc = pthread_create(&shard->thread, NULL, shard_thread, shard);
+    if (rc != 0) {
+      printf("[PROBING PHASE] pthread_create: %s\n", strerror(rc));
+      break;
+    }
+  }
+  pthread_barrier_init(&receiver->start, NULL, started + 1);
+  pthread_barrier_init(&receiver->end, NULL, started + 1);
+  pthread_mutex_unlock(&receiver->gate);
+  if (started < shards) {
+    release_receiver(receiver, opened, started);
+    pthread_barrier_destroy(&receiver->start);
+    pthread_barrier_destroy(&receiver->end);
+    return NULL;
+  }
+  return receiver;
+}
+
+// Current CLOCK_MONOTONIC time in ns. Deadlines are kept on the clock of the
+// timerfd; the TSC (calibrated against CLOCK_MONOTONIC_RAW, which NTP does
+// not slew) only timestamps packets, or the timer could fire before a
+// deadline and never be re-armed.
+static long long monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Arms the deadline timer at an absolute CLOCK_MONOTONIC time
+static void arm_deadline(int timer_fd, long long deadline_ns) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = deadline_ns / 1000000000LL;
+  spec.it_value.tv_nsec = deadline_ns % 1000000000LL;
+  timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// Computes the stats of one train from its accumulator. The dispersion is
+// the time between the arrival of its first packet (seq 0) and its last one
+// (seq train_size - 1); if either was lost, the first/last arrival of the
+// train is used instead. The input dispersion is the same span measured on
+// the send stamps.
+static void finish_train(struct TrainProgress *progress, int train_size,
+                         struct TrainStats *stats) {
+  struct TrainAccumulator *acc = &progress->acc;
+  stats->received = atomic_load(&progress->received);
+  stats->lost = train_size - stats->received;
+  stats->duplicates = acc->duplicates;
+  stats->reordered = acc->reordered;
+  stats->max_packet_id = acc->max_seq;
+  stats->kernel_drops = atomic_load(&progress->kernel_drops);
+  stats->gap_mean_us = acc->gap_mean / 1000;
+  stats->gap_stddev_us =
+      acc->gaps > 1 ? sqrt(acc->gap_m2 / (acc->gaps - 1)) / 1000 : 0;
+  stats->stamped = acc->stamped;
+  if (acc->stamped > 1) {
+    uint64_t start = acc->head_send_ns != 0 ? acc->head_send_ns
+                                            : acc->send_min_ns;
+    uint64_t end = acc->tail_send_ns != 0 ? acc->tail_send_ns
+                                          : acc->send_max_ns;
+    stats->input_dispersion_us = end > start ? (long)((end - start) / 1000) : 0;
+    stats->owd_variation_us = (acc->owd_max - acc->owd_min) / 1000;
+    stats->owd_jitter_us = sqrt(acc->owd_m2 / (acc->stamped - 1)) / 1000;
+  } else {
+    stats->input_dispersion_us = 0;
+    stats->owd_variation_us = 0;
+    stats->owd_jitter_us = 0;
+  }
+
+  long long first_ns = atomic_load(&progress->first_ns);
+  if (first_ns == 0) {
+    stats->dispersion_us = 0;
+    return;
+  }
+  long long start_ns = acc->head_ns != 0 ? acc->head_ns : first_ns;
+  long long end_ns = acc->tail_ns != 0 ? acc->tail_ns : acc->prev_ns;
+  stats->dispersion_us = (end_ns - start_ns) / 1000;
+}
+
+// Runs the shards for one schedule. The calling thread coordinates the
+// deadlines: it sleeps on a timerfd and on the progress eventfd, and moves to
+// the next train once the current one has its tail (or is full) or its
+// deadline has passed. Before the first packet of a train arrives, the
+// deadline is the start (or gap) timeout; once it arrives, it becomes the
+// first arrival plus the train window.
+int receiver_run(struct Receiver *receiver, struct TrainSchedule *schedule,
+                 struct TrainStats *stats) {
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  int epoll_fd = epoll_create1(0);
+  if (timer_fd < 0 || epoll_fd < 0) {
+    perror("[PROBING PHASE] Failed creating deadline timer");
+    return -1;
+  }
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = timer_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+  event.data.fd = receiver->progress_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, receiver->progress_fd, &event);
+
+  pthread_mutex_lock(&receiver->report_lock);
+  receiver->schedule = schedule;
+  size_t mark = arena_mark(receiver->arena);
+  receiver->progress = arena_alloc(
+      receiver->arena, schedule->trains * sizeof(struct TrainProgress));
+  if (receiver->progress == NULL) {
+    pthread_mutex_unlock(&receiver->report_lock);
+    close(timer_fd);
+    close(epoll_fd);
+    return -1;
+  }
+  for (int i = 0; i < schedule->trains; i++) {
+    pthread_mutex_init(&receiver->progress[i].acc.lock, NULL);
+    receiver->progress[i].acc.max_seq = -1;
+  }
+  atomic_store(&receiver->aborted, 0);
+  atomic_store(&receiver->current, 0);
+  pthread_mutex_unlock(&receiver->report_lock);
+  memset(stats, 0, schedule->trains * sizeof(struct TrainStats));
+  for (int i = 0; i < receiver->shards; i++) {
+    receiver->shard[i].count = 0;
+  }
+  perf_sample_init(&receiver->perf);
+
+  int t = 0;
+  int window_armed = 0;
+  int tail_armed = 0;
+  long long deadline_ns = monotonic_ns() + schedule->start_timeout_us * 1000;
+  arm_deadline(timer_fd, deadline_ns);
+  pthread_barrier_wait(&receiver->start);
+
+  while (t < schedule->trains) {
+    if (atomic_load(&receiver->aborted)) {
+      for (; t < schedule->trains; t++) {
+        stats[t].ended_by = TRAIN_ABORTED;
+      }
+      break;
+    }
+    struct TrainProgress *progress = &receiver->progress[t];
+    long long first_ns = atomic_load(&progress->first_ns);
+    if (!window_armed && first_ns != 0) {
+      // first_ns is a TSC stamp: the window starts that long ago
+      deadline_ns = monotonic_ns() - (tsc_now_ns() - first_ns) +
+                    schedule->train_window_us * 1000;
+      arm_deadline(timer_fd, deadline_ns);
+      window_armed = 1;
+    }
+    int tail_seen = atomic_load(&progress->tail_seen);
+    if (tail_seen && !tail_armed) {
+      // packets overtaken by the tail (e.g. from another sender) still count
+      long long grace_ns = monotonic_ns() + TRAIN_TAIL_GRACE_US * 1000;
+      if (grace_ns < deadline_ns) {
+        deadline_ns = grace_ns;
+        arm_deadline(timer_fd, deadline_ns);
+      }
+      tail_armed = 1;
+    }
+
+    int full = atomic_load(&progress->received) >= schedule->train_size;
+    if (full || monotonic_ns() >= deadline_ns) {
+      stats[t].ended_by = full || tail_seen ? TRAIN_TAIL : TRAIN_DEADLINE;
+      t++;
+      atomic_store(&receiver->current, t);
+      window_armed = 0;
+      tail_armed = 0;
+      deadline_ns = monotonic_ns() + schedule->gap_timeout_us * 1000;
+      arm_deadline(timer_fd, deadline_ns);
+      continue;
+    }
+
+    struct epoll_event events[2];
+    if (epoll_wait(epoll_fd, events, 2, -1) < 0 && errno != EINTR) {
+      perror("[PROBING PHASE] epoll_wait");
+      break;
+    }
+    uint64_t value;
+    read(timer_fd, &value, sizeof(value));
+    eventfd_read(receiver->progress_fd, &value);
+  }
+
+  // stop the shards and wait until they are out of the receive loop
+  atomic_store(&receiver->stopping, 1);
+  eventfd_write(receiver->stop_fd, 1);
+  pthread_barrier_wait(&receiver->end);
+  atomic_store(&receiver->stopping, 0);
+  uint64_t value;
+  eventfd_read(receiver->stop_fd, &value);
+  eventfd_read(receiver->progress_fd, &value);
+  close(timer_fd);
+  close(epoll_fd);
+
+  for (int i = 0; i < receiver->shards; i++) {
+    logger("[PROBING PHASE] Shard %d received %d packets", i,
+           receiver->shard[i].count);
+  }
+  for (int i = 0; i < schedule->trains; i++) {
+    int ended_by = stats[i].ended_by;
+    finish_train(&receiver->progress[i], schedule->train_size, &stats[i]);
+    stats[i].ended_by = ended_by;
+  }
+  // receiver_report takes the accumulator locks, so they go with the progress
+  pthread_mutex_lock(&receiver->report_lock);
+  atomic_store(&receiver->current, -1);
+  for (int i = 0; i < schedule->trains; i++) {
+    pthread_mutex_destroy(&receiver->progress[i].acc.lock);
+  }
+  arena_reset(receiver->arena, mark);
+  receiver->progress = NULL;
+  pthread_mutex_unlock(&receiver->report_lock);
+  return 0;
+}
+
+// Stops the shard threads; the receiver goes with its arena
+void receiver_close(struct Receiver *receiver) {
+  release_receiver(receiver, receiver->shards, receiver->shards);
+  pthread_barrier_destroy(&receiver->start);
+  pthread_barrier_destroy(&receiver->end);
+}
+
+// Snapshots the progress of a running schedule
+int receiver_report(struct Receiver *receiver, int train,
+                    struct TrainReport *report) {
+  memset(report, 0, sizeof(*report));
+  pthread_mutex_lock(&receiver->report_lock);
+  int current = atomic_load(&receiver->current);
+  if (current < 0 || train < 0 || train >= receiver->schedule->trains) {
+    pthread_mutex_unlock(&receiver->report_lock);
+    return -1;
+  }
+  struct TrainProgress *progress = &receiver->progress[train];
+  long long first_ns = atomic_load(&progress->first_ns);
+  long long last_ns = atomic_load(&progress->last_ns);
+  report->received = atomic_load(&progress->received);
+  report->kernel_drops = atomic_load(&progress->kernel_drops);
+  report->done = train < current;
+  if (first_ns != 0 && last_ns > first_ns) {
+    report->elapsed_us = (last_ns - first_ns) / 1000;
+    if (report->received > 1) {
+      report->mean_gap_us = report->elapsed_us / (report->received - 1);
+    }
+  }
+  report->max_gap_us = atomic_load(&progress->max_gap_ns) / 1000;
+  pthread_mutex_lock(&progress->acc.lock);
+  if (progress->acc.stamped > 1) {
+    report->send_elapsed_us =
+        (progress->acc.send_max_ns - progress->acc.send_min_ns) / 1000;
+  }
+  pthread_mutex_unlock(&progress->acc.lock);
+  pthread_mutex_unlock(&receiver->report_lock);
+  return current;
+}
+
+// Copies the counters of the last run
+void receiver_perf(struct Receiver *receiver, struct PerfSample *sample) {
+  pthread_mutex_lock(&receiver->report_lock);
+  *sample = receiver->perf;
+  pthread_mutex_unlock(&receiver->report_lock);
+}
+
+// Ends the current run early
+void receiver_abort(struct Receiver *receiver) {
+  atomic_store(&receiver->aborted, 1);
+  eventfd_write(receiver->progress_fd, 1);
+}
+
+// Fills a schedule from the client config
+void schedule_trains(struct TrainSchedule *schedule,
+                     struct Config *client_config, int first_train_id,
+                     int trains) {
+  int senders =
+      client_config->sender_threads > 0 ? client_config->sender_threads : 1;
+  long expected_us = (long)client_config->udp_train_size *
+                     client_config->inter_packet_delay_us / senders;
+
+  schedule->first_train_id = first_train_id;
+  schedule->trains = trains;
+  schedule->train_size = client_config->udp_train_size;
+  schedule->train_window_us = 2 * expected_us + TRAIN_WINDOW_MARGIN_US;
+  schedule->start_timeout_us = TRAIN_START_TIMEOUT_US;
+  schedule->gap_timeout_us =
+      (long)client_config->inter_time_s * 1000000 + TRAIN_START_TIMEOUT_US;
+}
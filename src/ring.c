@@ -0,0 +1,168 @@
+#include "../include/ring.h"
+#include "../include/logger.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Layout of the whole shared-memory file
+struct RingFile {
+  struct RingHeader header;
+  struct RingSlot slots[RING_SLOTS];
+};
+
+struct ResultRing {
+  int fd;
+  struct RingFile *file;
+};
+
+// Returns non-zero if the file behind fd has the layout of this build
+static int ring_file_valid(int fd) {
+  struct stat st;
+  struct RingHeader header;
+  if (fstat(fd, &st) < 0 || st.st_size != (off_t)sizeof(struct RingFile)) {
+    return 0;
+  }
+  if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+    return 0;
+  }
+  return header.magic == RING_MAGIC && header.version == RING_VERSION &&
+         header.slots == RING_SLOTS &&
+         header.record_size == sizeof(struct ResultRecord);
+}
+
+// Truncates the file behind fd to an empty ring of this layout
+static int ring_file_reset(int fd) {
+  struct RingHeader header = {RING_MAGIC, RING_VERSION, RING_SLOTS,
+                              sizeof(struct ResultRecord), 0};
+  if (ftruncate(fd, 0) < 0 || ftruncate(fd, sizeof(struct RingFile)) < 0 ||
+      pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+    return -1;
+  }
+  return 0;
+}
+
+// Maps the ring, creating it if needed
+struct ResultRing *ring_open(const char *name) {
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror("[RING] [ERROR] Could not open result ring");
+    return NULL;
+  }
+
+  // another process may be creating the ring: check it under a shared lock
+  // and reset it under an exclusive one
+  flock(fd, LOCK_SH);
+  if (!ring_file_valid(fd)) {
+    flock(fd, LOCK_EX);
+    if (!ring_file_valid(fd) && ring_file_reset(fd) < 0) {
+      perror("[RING] [ERROR] Could not initialize result ring");
+      flock(fd, LOCK_UN);
+      close(fd);
+      return NULL;
+    }
+  }
+  flock(fd, LOCK_UN);
+
+  void *map = mmap(NULL, sizeof(struct RingFile), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    perror("[RING] [ERROR] Could not map result ring");
+    close(fd);
+    return NULL;
+  }
+  struct ResultRing *ring = malloc(sizeof(struct ResultRing));
+  if (ring == NULL) {
+    perror("[RING] [ERROR] Could not allocate result ring");
+    munmap(map, sizeof(struct RingFile));
+    close(fd);
+    return NULL;
+  }
+  ring->fd = fd;
+  ring->file = map;
+  return ring;
+}
+
+// Publishes a record into the next slot
+void ring_publish(struct ResultRing *ring, struct ResultRecord *record) {
+  struct RingHeader *header = &ring->file->header;
+
+  // the flock orders the publishers of every descriptor of the ring, threads
+  // of one process included, since ring_publish_once opens one per record
+  flock(ring->fd, LOCK_EX);
+  uint64_t n = atomic_load_explicit(&header->head, memory_order_relaxed);
+  struct RingSlot *slot = &ring->file->slots[n % RING_SLOTS];
+  record->seq = n;
+
+  atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(&slot->record, record, sizeof(*record));
+  atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+  atomic_store_explicit(&header->head, n + 1, memory_order_release);
+  flock(ring->fd, LOCK_UN);
+  logger("[RING] Published record %llu", (unsigned long long)n);
+}
+
+// Records published so far
+uint64_t ring_head(struct ResultRing *ring) {
+  return atomic_load_explicit(&ring->file->header.head, memory_order_acquire);
+}
+
+// Reads the record at the cursor of a consumer
+int ring_read(struct ResultRing *ring, uint64_t *cursor,
+              struct ResultRecord *record) {
+  uint64_t n = *cursor;
+  struct RingSlot *slot = &ring->file->slots[n % RING_SLOTS];
+  uint64_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (before < 2 * n + 2) {
+    return 0; // not published yet (or still being written)
+  }
+  if (before == 2 * n + 2) {
+    memcpy(record, &slot->record, sizeof(*record));
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    if (after == before) {
+      *cursor = n + 1;
+      return 1;
+    }
+  }
+
+  // the producer lapped this consumer (the slot holds or is being rewritten
+  // with a newer record): skip to the oldest record that is safe to read
+  uint64_t head = ring_head(ring);
+  uint64_t oldest = head > RING_SLOTS ? head - RING_SLOTS + 1 : 0;
+  if (oldest <= n) {
+    return 0;
+  }
+  *cursor = oldest;
+  return -1;
+}
+
+// Unmaps the ring
+void ring_close(struct ResultRing *ring) {
+  munmap(ring->file, sizeof(struct RingFile));
+  close(ring->fd);
+  free(ring);
+}
+
+// Time records are stamped with
+int64_t ring_clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Publishes a single record
+void ring_publish_once(const char *name, struct ResultRecord *record) {
+  struct ResultRing *ring = ring_open(name);
+  if (ring == NULL) {
+    return;
+  }
+  ring_publish(ring, record);
+  ring_close(ring);
+}
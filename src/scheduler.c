@@ -0,0 +1,395 @@
+#include "../include/scheduler.h"
+#include "../include/compdetect.h"
+#include "../include/logger.h"
+#include "../include/wheel.h"
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// A (server, port) pair that is measured periodically
+struct Target {
+  char server_ip[INET_ADDRSTRLEN];
+  int pp_port_tcp;
+  int dst_port_udp;
+  int period_s;
+  long bytes; // probe traffic of one measurement
+  struct Destination *destination;
+  struct WheelTimer timer; // due time, or link in the ready queue
+  struct CdMeasurement *measurement; // measurement in flight, NULL if idle
+  int worker;
+  double started_s;
+};
+
+// Server address shared by one or more targets, with its bandwidth budget
+struct Destination {
+  char server_ip[INET_ADDRSTRLEN];
+  struct Budget budget;
+  struct Destination *next;
+};
+
+// State of the scheduler loop
+struct Scheduler {
+  struct Config *config;
+  struct Target *targets;
+  int target_count;
+  struct Destination *destinations;
+  struct Budget global;
+  struct TimerWheel wheel;
+  struct WheelTimer ready; // due targets waiting for a worker or budget
+  struct Target *workers[SCHEDULER_MAX_WORKERS];
+  int worker_count;
+  int running;
+};
+
+// Set by SIGINT/SIGTERM: stop dispatching and wait for running measurements
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signum) {
+  (void)signum;
+  stop_requested = 1;
+}
+
+// Monotonic time in seconds
+static double now_s(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Starts a budget of kbps kilobits per second (0 for no limit) with a full
+// bucket
+static void budget_init(struct Budget *budget, int kbps) {
+  budget->rate_bps = kbps * 1000.0 / 8;
+  budget->tokens = budget->rate_bps * BUDGET_BURST_S;
+  budget->updated_s = now_s();
+}
+
+// Refills a budget and returns how long (in seconds) a measurement has to
+// wait for it, 0 if it can start now
+static double budget_wait_s(struct Budget *budget) {
+  if (budget->rate_bps <= 0) {
+    return 0;
+  }
+  double now = now_s();
+  budget->tokens += (now - budget->updated_s) * budget->rate_bps;
+  budget->updated_s = now;
+  double burst = budget->rate_bps * BUDGET_BURST_S;
+  if (budget->tokens > burst) {
+    budget->tokens = burst;
+  }
+  return budget->tokens >= 0 ? 0 : -budget->tokens / budget->rate_bps;
+}
+
+// Charges the bytes of a measurement to a budget
+static void budget_charge(struct Budget *budget, long bytes) {
+  if (budget->rate_bps > 0) {
+    budget->tokens -= bytes;
+  }
+}
+
+// Bytes a measurement with this client config sends: both timed trains and
+// the warm-up trains, with their IP and UDP headers
+static long measurement_bytes(struct Config *config) {
+  long packet = config->payload_size + sizeof(struct iphdr) +
+                sizeof(struct udphdr);
+  long packets = 2L * config->udp_train_size +
+                 (long)config->warmup_trains * config->warmup_train_size;
+  return packets * packet;
+}
+
+// Finds (or adds) the destination of a server address
+static struct Destination *find_destination(struct Scheduler *scheduler,
+                                            const char *server_ip) {
+  for (struct Destination *d = scheduler->destinations; d != NULL;
+       d = d->next) {
+    if (strcmp(d->server_ip, server_ip) == 0) {
+      return d;
+    }
+  }
+  struct Destination *d = calloc(1, sizeof(struct Destination));
+  snprintf(d->server_ip, sizeof(d->server_ip), "%s", server_ip);
+  budget_init(&d->budget, scheduler->config->destination_budget_kbps);
+  d->next = scheduler->destinations;
+  scheduler->destinations = d;
+  return d;
+}
+
+// Reads the target list. Blank lines and lines starting with # are skipped;
+// a missing or 0 dst_port_udp or period_s takes the value of the config.
+// Returns the number of targets, or -1 if the file could not be read.
+static int load_targets(struct Scheduler *scheduler, const char *filename) {
+  struct Config *config = scheduler->config;
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    perror("[SCHEDULER] [ERROR] Could not open targets file");
+    return -1;
+  }
+
+  int capacity = 64;
+  struct Target *targets = calloc(capacity, sizeof(struct Target));
+  int count = 0;
+  char line[TARGET_LINE_MAX];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    char server_ip[INET_ADDRSTRLEN];
+    int pp_port_tcp = 0, dst_port_udp = 0, period_s = 0;
+    char *start = line + strspn(line, " \t");
+    if (*start == '#' || *start == '\n' || *start == '\0') {
+      continue;
+    }
+    struct in_addr addr;
+    if (sscanf(start, "%15s %d %d %d", server_ip, &pp_port_tcp, &dst_port_udp,
+               &period_s) < 2 ||
+        inet_pton(AF_INET, server_ip, &addr) != 1 || pp_port_tcp <= 0) {
+      printf("[SCHEDULER] [ERROR] %s:%d: expected \"server_ip pp_port_tcp "
+             "[dst_port_udp [period_s]]\"\n",
+             filename, line_number);
+      continue;
+    }
+    if (count == capacity) {
+      capacity *= 2;
+      targets = realloc(targets, capacity * sizeof(struct Target));
+    }
+    struct Target *target = &targets[count++];
+    memset(target, 0, sizeof(*target));
+    snprintf(target->server_ip, sizeof(target->server_ip), "%s", server_ip);
+    target->pp_port_tcp = pp_port_tcp;
+    target->dst_port_udp =
+        dst_port_udp > 0 ? dst_port_udp : config->dst_port_udp;
+    target->period_s = period_s > 0 ? period_s : config->measure_period_s;
+    target->bytes = measurement_bytes(config);
+  }
+  fclose(file);
+
+  // the timers are embedded in the targets, so the array is final from here
+  for (int i = 0; i < count; i++) {
+    targets[i].destination = find_destination(scheduler, targets[i].server_ip);
+    targets[i].timer.data = &targets[i];
+  }
+  scheduler->targets = targets;
+  scheduler->target_count = count;
+  return count;
+}
+
+// Converts a delay to wheel ticks
+static uint64_t to_ticks(double seconds) {
+  return (uint64_t)(seconds * 1000 / SCHEDULER_TICK_MS);
+}
+
+// Period of a target with +/- period_jitter_percent of uniform jitter
+static double jittered_period_s(struct Scheduler *scheduler,
+                                struct Target *target) {
+  double jitter = scheduler->config->period_jitter_percent / 100.0;
+  double factor = 1 + jitter * (2.0 * random() / RAND_MAX - 1);
+  return target->period_s * factor;
+}
+
+// Starts the measurement of a target on a worker. Worker w sends from
+// src_port_udp + w * sender_threads, so concurrent measurements never share a
+// source port.
+static void start_measurement(struct Scheduler *scheduler,
+                              struct Target *target, int worker) {
+  struct Config *config = scheduler->config;
+  struct Config client_config = *config;
+  client_config.mode = "client";
+  client_config.server_ip_addr = target->server_ip;
+  client_config.pp_port_tcp = target->pp_port_tcp;
+  client_config.dst_port_udp = target->dst_port_udp;
+  client_config.src_port_udp =
+      config->src_port_udp +
+      worker * (config->sender_threads > 0 ? config->sender_threads : 1);
+  printf("[SCHEDULER] Measuring %s:%d\n", target->server_ip,
+         target->pp_port_tcp);
+  int error;
+  target->measurement = cd_start(&client_config, &error);
+  if (target->measurement == NULL) {
+    printf("[SCHEDULER] [ERROR] Could not start measurement: %s\n",
+           cd_strerror(error));
+    wheel_add(&scheduler->wheel, &target->timer, to_ticks(1));
+    return;
+  }
+
+  target->worker = worker;
+  target->started_s = now_s();
+  scheduler->workers[worker] = target;
+  scheduler->running++;
+  logger("[SCHEDULER] Dispatched %s:%d to worker %d", target->server_ip,
+         target->pp_port_tcp, worker);
+}
+
+// Starts due targets while there are free workers. A target over budget goes
+// back on the wheel until its budget refills.
+static void dispatch_ready(struct Scheduler *scheduler) {
+  while (scheduler->ready.next != &scheduler->ready &&
+         scheduler->running < scheduler->worker_count) {
+    struct WheelTimer *timer = scheduler->ready.next;
+    struct Target *target = timer->data;
+    wheel_remove(timer);
+
+    double wait_s = budget_wait_s(&scheduler->global);
+    double destination_wait_s = budget_wait_s(&target->destination->budget);
+    if (destination_wait_s > wait_s) {
+      wait_s = destination_wait_s;
+    }
+    if (wait_s > 0) {
+      logger("[SCHEDULER] %s:%d over %s budget, postponed %.1fs",
+             target->server_ip, target->pp_port_tcp,
+             wait_s == destination_wait_s ? "destination" : "global",
+             wait_s);
+      wheel_add(&scheduler->wheel, timer, to_ticks(wait_s) + 1);
+      continue;
+    }
+    budget_charge(&scheduler->global, target->bytes);
+    budget_charge(&target->destination->budget, target->bytes);
+
+    int worker = 0;
+    while (scheduler->workers[worker] != NULL) {
+      worker++;
+    }
+    start_measurement(scheduler, target, worker);
+  }
+}
+
+// Reaps finished measurements, prints their verdicts and schedules the next
+// measurement of their targets one (jittered) period after the previous one
+// started
+static void reap_workers(struct Scheduler *scheduler) {
+  for (int w = 0; w < scheduler->worker_count; w++) {
+    struct Target *target = scheduler->workers[w];
+    if (target == NULL || cd_poll(target->measurement) == CD_PENDING) {
+      continue;
+    }
+    scheduler->workers[w] = NULL;
+    scheduler->running--;
+    double elapsed_s = now_s() - target->started_s;
+    struct CdResult result;
+    int error = cd_result(target->measurement, &result);
+    cd_free(target->measurement);
+    target->measurement = NULL;
+    if (error != CD_OK) {
+      printf("[SCHEDULER] [ERROR] Measurement of %s:%d failed after %.1fs: "
+             "%s\n",
+             target->server_ip, target->pp_port_tcp, elapsed_s,
+             cd_strerror(error));
+    } else {
+      if (result.text[0] == '\0') {
+        // a sweep has no verdict; its worker printed the matrix
+        printf("[COMP DETECT] %s:%d sweep done\n", target->server_ip,
+               target->pp_port_tcp);
+      } else if (result.cached_age_s >= 0) {
+        printf("[COMP DETECT] %s:%d %s [cached %lds ago]\n",
+               target->server_ip, target->pp_port_tcp, result.text,
+               result.cached_age_s);
+      } else {
+        printf("[COMP DETECT] %s:%d %s\n", target->server_ip,
+               target->pp_port_tcp, result.text);
+      }
+      logger("[SCHEDULER] Measured %s:%d in %.1fs", target->server_ip,
+             target->pp_port_tcp, elapsed_s);
+    }
+    double delay_s = jittered_period_s(scheduler, target) - elapsed_s;
+    wheel_add(&scheduler->wheel, &target->timer,
+              delay_s > 0 ? to_ticks(delay_s) : 1);
+  }
+}
+
+// Releases the scheduler, its targets and destinations
+static void free_scheduler(struct Scheduler *scheduler) {
+  while (scheduler->destinations != NULL) {
+    struct Destination *next = scheduler->destinations->next;
+    free(scheduler->destinations);
+    scheduler->destinations = next;
+  }
+  free(scheduler->targets);
+  free(scheduler);
+}
+
+// Runs the scheduler
+int run_scheduler(struct Config *config) {
+  if (config->targets_file == NULL) {
+    printf("[SCHEDULER] [ERROR] targets_file is required.\n");
+    return CD_ERR_CONFIG;
+  }
+  struct Scheduler *scheduler = calloc(1, sizeof(struct Scheduler));
+  scheduler->config = config;
+  scheduler->worker_count = config->scheduler_workers;
+  if (scheduler->worker_count < 1) {
+    scheduler->worker_count = 1;
+  } else if (scheduler->worker_count > SCHEDULER_MAX_WORKERS) {
+    scheduler->worker_count = SCHEDULER_MAX_WORKERS;
+  }
+  budget_init(&scheduler->global, config->global_budget_kbps);
+  wheel_init(&scheduler->wheel);
+  wheel_list_init(&scheduler->ready);
+  srandom(time(NULL) ^ getpid());
+  cd_init(config->tsc);
+
+  if (load_targets(scheduler, config->targets_file) <= 0) {
+    printf("[SCHEDULER] [ERROR] No targets in %s.\n", config->targets_file);
+    free_scheduler(scheduler);
+    return CD_ERR_CONFIG;
+  }
+
+  // the first measurement of each target falls anywhere in its first period,
+  // so targets with the same period do not all start together
+  for (int i = 0; i < scheduler->target_count; i++) {
+    struct Target *target = &scheduler->targets[i];
+    double offset_s = target->period_s * (double)random() / RAND_MAX;
+    wheel_add(&scheduler->wheel, &target->timer, to_ticks(offset_s));
+  }
+  printf("[SCHEDULER] %d target(s), %d worker(s), %ld bytes per measurement\n",
+         scheduler->target_count, scheduler->worker_count,
+         scheduler->targets[0].bytes);
+
+  struct sigaction action = {0};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (timer_fd < 0) {
+    perror("[SCHEDULER] [ERROR] timerfd_create");
+    free_scheduler(scheduler);
+    return CD_ERR_RESOURCE;
+  }
+  struct itimerspec tick = {0};
+  tick.it_interval.tv_nsec = SCHEDULER_TICK_MS * 1000000L;
+  tick.it_value = tick.it_interval;
+  timerfd_settime(timer_fd, 0, &tick, NULL);
+
+  double deadline_s = config->scheduler_duration_s > 0
+                          ? now_s() + config->scheduler_duration_s
+                          : 0;
+  while (!stop_requested && (deadline_s == 0 || now_s() < deadline_s)) {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) !=
+        sizeof(expirations)) {
+      continue; // interrupted by a signal
+    }
+    // a late wakeup advances the wheel by every tick that passed
+    for (uint64_t i = 0; i < expirations; i++) {
+      wheel_tick(&scheduler->wheel, &scheduler->ready);
+    }
+    reap_workers(scheduler);
+    dispatch_ready(scheduler);
+  }
+
+  printf("[SCHEDULER] Stopping, waiting for %d running measurement(s)\n",
+         scheduler->running);
+  while (scheduler->running > 0) {
+    usleep(SCHEDULER_TICK_MS * 1000);
+    reap_workers(scheduler);
+  }
+  close(timer_fd);
+  free_scheduler(scheduler);
+  return CD_OK;
+}
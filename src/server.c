@@ -1,13 +1,28 @@
+#include "../include/admission.h"
+#include "../include/arena.h"
+#include "../include/cderror.h"
 #include "../include/config.h"
 #include "../include/logger.h"
+#include "../include/probe.h"
+#include "../include/rate.h"
+#include "../include/receiver.h"
+#include "../include/ring.h"
+#include "../include/server.h"
+#include "../include/tsc.h"
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <time.h>
@@ -17,37 +32,96 @@
 // compression enabled us == microseconds
 #define THRESHOLD 100000
 
+// Time a concurrent server keeps the result of a session for its client
+#define RESULT_KEEP_S 300
+
+// Outcome of the probing phase
+struct ProbeResult {
+  int has_compression;
+  int aborted; // 0, ABORT_DECIDED or ABORT_BROKEN
+  long delta_low;
+  long delta_high;
+  long delta_diff; // corrected for the sender's jitter if probes are stamped
+  struct TrainStats low;
+  struct TrainStats high;
+};
+
+// Control session of a client. Its timed trains are admitted on the
+// interface the session arrived on (see admission.h). Its receivers are
+// carved from its arena.
+struct Session {
+  int fd;
+  uint32_t id;
+  uint32_t peer_ip; // client address, the only one its result is sent to
+  int ifindex;
+  struct Admission *admission;
+  struct Arena arena;
+};
+
+// Result of a finished session kept by a concurrent server until its client
+// fetches it
+struct StoredResult {
+  uint32_t session_id;
+  uint32_t peer_ip;
+  struct ProbeResult result;
+  time_t stored_s;
+  struct StoredResult *next;
+};
+
+// State of a server: the admission control of the trains and, when sessions
+// are served concurrently, the connections in flight and the results not
+// fetched yet
+struct SessionServer {
+  struct Config *config;
+  struct Admission *admission;
+  int concurrent;
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // signaled when a connection ends
+  int connections;
+  uint32_t next_id; // used if no random id can be drawn
+  struct StoredResult *results;
+};
+
+// Set by SIGINT/SIGTERM or a SHUTDOWN_RQ to stop a concurrent server
+static volatile sig_atomic_t stop_requested = 0;
+
+// Asks a concurrent server to stop accepting sessions
+static void request_stop(int signum) {
+  (void)signum;
+  stop_requested = 1;
+}
+
 // This function receives a message from a client on a given file descriptor,
-// extracts a configuration struct from the message, and returns a pointer to
-// it. If the message is a shutdown request, it will shut down the server. If
-// the message is not recognized, it sends a response indicating that the
-// message is unrecognized.
-struct Config *recv_config(int server_fd, int client_fd) {
+// extracts a configuration struct from the message into received, and points
+// client_config at it. If the message is a shutdown request, client_config is
+// left NULL so that the server shuts down. If the message is not recognized,
+// it sends a response indicating that the message is unrecognized. Returns
+// CD_OK or an error code.
+int recv_config(int client_fd, struct Config *received,
+                struct Config **client_config) {
   char buffer[sizeof(struct Config) + 1] = {0};
-  struct Config *client_config = malloc(sizeof(struct Config));
 
+  *client_config = NULL;
   if (recv(client_fd, buffer, sizeof(buffer), 0) < 0) {
     perror("[PRE-PROBING PHASE] Failed receiving message from client");
-    close(client_fd);
-    return NULL;
+    return CD_ERR_CONNECT;
   }
 
   // In case we want to signal to shutdown server
   if (buffer[0] == SHUTDOWN_RQ) {
-    printf("Server shutting down.");
-    close(server_fd);
-    close(client_fd);
-    exit(0);
+    printf("Server shutting down.\n");
+    return CD_OK;
   }
 
   // Receive client config
   if (buffer[0] == CONFIG_FILE_RQ) {
-    memcpy(client_config, buffer + 1, sizeof(struct Config));
+    memcpy(received, buffer + 1, sizeof(struct Config));
+    *client_config = received;
     logger("[PRE-PROBING PHASE] Received config file from client.");
 
     // send message to client
     char *message = "Config file received!";
-    send(client_fd, message, strlen(message), 0);
+    send(client_fd, message, strlen(message), MSG_NOSIGNAL);
   } else {
     // handle unrecognized request
     char buf[1024];
@@ -60,29 +134,28 @@ struct Config *recv_config(int server_fd, int client_fd) {
 
     // send message to client
     char *message = "Message unrecognized.";
-    send(client_fd, message, strlen(message), 0);
-  }
-
-  if (buffer[0] == CONFIG_FILE_RQ) {
-    return client_config;
-  } else {
-    return NULL;
+    send(client_fd, message, strlen(message), MSG_NOSIGNAL);
+    return CD_ERR_PROTOCOL;
   }
+  return CD_OK;
 }
 
 // This function sets up a TCP server on a specified port and listens for
 // incoming connections. Once a connection is established, it receives a
-// configuration file from the client and returns the parsed configuration as a
-// struct Config pointer.
-struct Config *pre_probing_s(int port) {
+// configuration file from the client into received and points client_config
+// at it (NULL on a shutdown request). The accepted connection is handed back
+// in session_fd so that the caller can keep using it as the control session.
+// Returns CD_OK or an error code.
+int pre_probing_s(int port, int *session_fd, struct Config *received,
+                  struct Config **client_config) {
   int server_fd, client_fd; // file descriptors
   struct sockaddr_in server_addr, client_addr;
   int addr_len = sizeof(server_addr);
 
   // create socket
-  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+  if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     perror("[PRE-PROBING PHASE] Failed creating server socket");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
   }
 
   // set socket to re-use addr
@@ -90,7 +163,8 @@ struct Config *pre_probing_s(int port) {
   if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) <
       0) {
     perror("[PRE-PROBING PHASE] Failed to set SO_REUSEADDR option");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   // set server address
@@ -102,13 +176,15 @@ struct Config *pre_probing_s(int port) {
   if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
       0) {
     perror("[PRE-PROBING PHASE] Failed binding server socket");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   // listen for incoming connections
   if (listen(server_fd, 3) < 0) {
     perror("[PRE-PROBING PHASE] Listening failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   logger("[PRE-PROBING PHASE] Listening for incoming connections on port %d",
@@ -118,18 +194,21 @@ struct Config *pre_probing_s(int port) {
   if ((client_fd = accept(server_fd, (struct sockaddr *)&client_addr,
                           (socklen_t *)&addr_len)) < 0) {
     perror("[PRE-PROBING PHASE] Server accept new connection failed");
-    close(client_fd);
     close(server_fd);
-    return NULL;
+    return CD_ERR_CONNECT;
   }
 
   logger("[PRE-PROBING PHASE] Accepted incoming connection from %s:%d.",
          inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
 
-  struct Config *client_config = recv_config(server_fd, client_fd);
-  close(client_fd);
+  int error = recv_config(client_fd, received, client_config);
   close(server_fd);
-  return client_config;
+  if (error != CD_OK || *client_config == NULL) {
+    close(client_fd);
+    return error;
+  }
+  *session_fd = client_fd;
+  return CD_OK;
 }
 
 // Receives a UDP packet on a socket, storing the payload in a buffer and its
@@ -141,136 +220,362 @@ void receive_udp_packet(int sockfd, struct sockaddr_in *cliaddr, char *payload,
                            (struct sockaddr *)cliaddr, len);
 }
 
-// The probing_s function performs the probing phase of the server application.
-// It receives a client configuration object and uses the UDP protocol to
-// receive two packet trains (low-entropy and high-entropy) from the client. It
-// measures the time it takes to receive each packet train and calculates the
-// difference between the two. If the difference exceeds a certain threshold, it
-// logs a message indicating that compression was detected and returns 1,
-// otherwise, it logs a message indicating that no compression was detected and
-// returns 0.
-int probing_s(struct Config *client_config) {
-  int dst_port = client_config->dst_port_udp;
-  int train_size = client_config->udp_train_size;
-  int payload_size = client_config->payload_size;
-  int server_fd;
-  struct sockaddr_in server_addr, client_addr;
+// State shared between probing_s and its progress thread
+struct ProgressArgs {
+  struct Receiver *receiver;
+  int session_fd;
+  int stop_fd; // eventfd, written once the trains have been received
+  int interval_ms;
+  int train_size;
+  atomic_int abort_reason;
+};
 
-  if ((server_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
-    perror("[PROBING PHASE] Error creating UDP socket for pre_probing_phase");
-    return 0;
+// Builds the progress frame of train t of the measurement. delta_low is the
+// elapsed time of the low-entropy train, minus the time its sender took, once
+// it is done (or -1): from then on the high-entropy train only gets longer, so
+// once its elapsed time (minus its own sending time so far) exceeds delta_low
+// by THRESHOLD the verdict is decided.
+static void build_frame(struct ProgressFrame *frame, struct TrainReport *report,
+                        int t, int train_size, long delta_low) {
+  memset(frame, 0, sizeof(*frame));
+  frame->train_id = LOW_TRAIN_ID + t;
+  frame->received = report->received;
+  frame->lost = report->done ? train_size - report->received : 0;
+  frame->done = report->done;
+  frame->elapsed_us = report->elapsed_us;
+  frame->mean_gap_us = report->mean_gap_us;
+  frame->max_gap_us = report->max_gap_us;
+  if (t == 1 && delta_low >= 0 && report->received > 0) {
+    frame->delta_us = report->elapsed_us - report->send_elapsed_us - delta_low;
+    frame->decided = frame->done || frame->delta_us > THRESHOLD;
   }
+}
 
-  memset(&server_addr, 0, sizeof(server_addr));
-  memset(&client_addr, 0, sizeof(client_addr));
+// Sends a progress frame over the control session
+static void send_frame(int session_fd, struct ProgressFrame *frame) {
+  char buffer[sizeof(struct ProgressFrame) + 1];
+  buffer[0] = PROGRESS_FRAME;
+  memcpy(buffer + 1, frame, sizeof(*frame));
+  send(session_fd, buffer, sizeof(buffer), MSG_NOSIGNAL);
+}
 
-  // set server address
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(dst_port);
+// Body of the progress thread of probing_s. Every interval_ms it streams the
+// progress of the current train (and a last frame for each train that ended)
+// to the client, and it aborts the receiver if the client sends ABORT_RQ.
+static void *progress_thread(void *args) {
+  struct ProgressArgs *progress = (struct ProgressArgs *)args;
+  struct pollfd fds[2];
+  fds[0].fd = progress->session_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = progress->stop_fd;
+  fds[1].events = POLLIN;
+  int reported = 0; // trains whose last frame was sent
+  int last_received = -1;
+  long delta_low = -1;
 
-  // bind socket to server address
-  if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
-      0) {
-    perror("[PROBING PHASE] Failed creating server socket");
-    exit(EXIT_FAILURE);
-  }
+  for (;;) {
+    int n = poll(fds, 2, progress->interval_ms);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 || (fds[1].revents & POLLIN)) {
+      break;
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP)) {
+      char request[2];
+      if (recv(progress->session_fd, request, 2, MSG_WAITALL) != 2) {
+        fds[0].fd = -1; // client closed its side, keep streaming
+      } else if (request[0] == ABORT_RQ &&
+                 atomic_load(&progress->abort_reason) == 0) {
+        logger("[PROBING PHASE] Client aborted the measurement (%s)",
+               request[1] == ABORT_DECIDED ? "verdict decided"
+                                           : "path is losing packets");
+        atomic_store(&progress->abort_reason, request[1]);
+        receiver_abort(progress->receiver);
+      }
+    }
 
-  struct timespec start_low, end_low, start_high, end_high;
-  char *payload = malloc(payload_size);
-  socklen_t len;
-  int counter = 0;
-
-  // Receive low entropy packet train
-  logger("[PROBING PHASE] Waiting for low-entropy packet train");
-  for (int i = 0; i < train_size; i++) {
-    recvfrom(server_fd, payload, payload_size, 0,
-             (struct sockaddr *)&client_addr, &len);
-
-    uint16_t packet_id;
-    memcpy(&packet_id, payload, sizeof(packet_id));
-    packet_id = ntohs(packet_id);
-
-    if (packet_id == 0) {
-      clock_gettime(CLOCK_MONOTONIC, &start_low);
-    } else if (packet_id == train_size - 1) {
-      clock_gettime(CLOCK_MONOTONIC, &end_low);
+    struct TrainReport report;
+    int current = receiver_report(progress->receiver, reported, &report);
+    if (current < 0) {
+      continue; // not started yet
     }
-    counter = counter + 1;
-  }
-  logger("[PROBING PHASE] Received %d/%d low-entropy packets", counter,
-         train_size);
-
-  // Receive high entropy packet train
-  counter = 0;
-  logger("[PROBING PHASE] Waiting for high-entropy packet train");
-  for (int i = 0; i < train_size; i++) {
-    recvfrom(server_fd, payload, payload_size, 0,
-             (struct sockaddr *)&client_addr, &len);
-
-    uint16_t packet_id;
-    memcpy(&packet_id, payload, sizeof(packet_id));
-    packet_id = ntohs(packet_id);
-
-    if (packet_id == 0) {
-      clock_gettime(CLOCK_MONOTONIC, &start_high);
-    } else if (packet_id == train_size - 1) {
-      clock_gettime(CLOCK_MONOTONIC, &end_high);
+    struct ProgressFrame frame;
+    for (; reported < current && reported < 2; reported++) {
+      last_received = -1;
+      receiver_report(progress->receiver, reported, &report);
+      build_frame(&frame, &report, reported, progress->train_size, delta_low);
+      if (reported == 0) {
+        delta_low = report.elapsed_us - report.send_elapsed_us;
+      }
+      send_frame(progress->session_fd, &frame);
     }
-    counter = counter + 1;
+    // frames of the current train are only sent when it made progress
+    if (current < 2 &&
+        receiver_report(progress->receiver, current, &report) >= 0 &&
+        report.received != last_received) {
+      build_frame(&frame, &report, current, progress->train_size, delta_low);
+      send_frame(progress->session_fd, &frame);
+      last_received = report.received;
+    }
+  }
+  return NULL;
+}
+
+// Logs the stats of a received train
+void log_train_stats(const char *name, struct TrainStats *stats,
+                     int train_size) {
+  logger("[PROBING PHASE] Received %d/%d %s packets (%s), lost %d, reordered "
+         "%d, duplicates %d, dropped by kernel %d, gap %.1f +/- %.1f us",
+         stats->received, train_size, name,
+         stats->ended_by == TRAIN_TAIL       ? "tail arrived"
+         : stats->ended_by == TRAIN_DEADLINE ? "deadline passed"
+                                             : "aborted",
+         stats->lost, stats->reordered, stats->duplicates,
+         stats->kernel_drops, stats->gap_mean_us, stats->gap_stddev_us);
+  if (stats->stamped > 1) {
+    logger("[PROBING PHASE] The %s train was sent in %ld us, one-way delay "
+           "jitter %.1f us (variation %ld us)",
+           name, stats->input_dispersion_us, stats->owd_jitter_us,
+           stats->owd_variation_us);
+  }
+}
+
+// Dispersion the path added to a train: its dispersion at the receiver
+// (output) minus its dispersion at the sender (input) when the packets carry
+// send stamps. A sender descheduled in the middle of a train stretches both,
+// so its own jitter cancels out instead of passing for compression.
+static long path_dispersion_us(struct TrainStats *stats) {
+  if (stats->stamped > 1) {
+    return stats->dispersion_us - stats->input_dispersion_us;
+  }
+  return stats->dispersion_us;
+}
+
+// Waits until a train of rate_kbps to port was granted a slot on the
+// interface of the session
+static void admit_train(struct Session *session, int port, long rate_kbps,
+                        struct TrainGrant *grant) {
+  admission_acquire(session->admission, session->ifindex, port, rate_kbps,
+                    grant);
+  logger("[ADMISSION] Session %u: %ld kbit/s train to port %d granted after "
+         "%ld us, starting in %ld us",
+         session->id, rate_kbps, port, grant->waited_us, grant->start_in_us);
+}
+
+// The probing_s function performs the probing phase of the server application.
+// It receives a client configuration object and uses the UDP protocol to
+// receive two packet trains (low-entropy and high-entropy) from the client,
+// told apart by the train id of their probe header. Each train ends when its
+// tail arrives or when a deadline derived from its expected duration passes,
+// so lost packets cannot hang the server. It measures the time it takes to
+// receive each packet train, less the time the client took to send it (from
+// the send stamps of the probes), and calculates the difference between the
+// two. If the difference exceeds a certain threshold, compression is reported
+// in the result. The server's own config decides the realtime profile and
+// number of shards of the receiver, as those are properties of the server
+// host and not of the client. Unless the client disabled it, a progress
+// thread streams ProgressFrames over the control session while the trains are
+// received and lets the client abort them. The client asks for the slot of
+// its trains with TRAIN_SLOT_RQ; both trains (and the inter-measurement time
+// between them) hold the slot, and the reply tells the client when it starts.
+// Returns CD_OK or an error code.
+int probing_s(struct Config *config, struct Config *client_config,
+              struct Session *session, struct ProbeResult *result) {
+  int session_fd = session->fd;
+  int train_size = client_config->udp_train_size;
+  struct TrainSchedule schedule;
+  struct TrainStats stats[2];
+  struct TrainGrant grant;
+
+  memset(result, 0, sizeof(*result));
+  char request;
+  if (recv(session_fd, &request, 1, MSG_WAITALL) != 1 ||
+      request != TRAIN_SLOT_RQ) {
+    printf("[PROBING PHASE] [ERROR] Client did not ask for a train slot\n");
+    return CD_ERR_PROTOCOL;
+  }
+  int senders =
+      client_config->sender_threads > 0 ? client_config->sender_threads : 1;
+  int rate_pps = delay_to_rate(client_config->inter_packet_delay_us, senders);
+  admit_train(session, client_config->dst_port_udp,
+              train_rate_kbps(client_config->payload_size, rate_pps), &grant);
+  struct Receiver *receiver =
+      receiver_open(config, &session->arena, client_config->dst_port_udp,
+                    client_config->payload_size, 2 * train_size);
+  if (receiver == NULL) {
+    admission_release(session->admission, &grant);
+    return CD_ERR_SOCKET;
   }
-  logger("[PROBING PHASE] Received %d/%d high-entropy packets", counter,
-         train_size);
+  char reply[sizeof(struct TrainSlot) + 1];
+  struct TrainSlot slot;
+  slot.session_id = session->id;
+  slot.start_in_us = grant.start_in_us;
+  slot.waited_us = grant.waited_us;
+  reply[0] = TRAIN_SLOT;
+  memcpy(reply + 1, &slot, sizeof(slot));
+  send(session_fd, reply, sizeof(reply), MSG_NOSIGNAL);
+
+  struct ProgressArgs progress;
+  pthread_t progress_tid;
+  memset(&progress, 0, sizeof(progress));
+  progress.receiver = receiver;
+  progress.session_fd = session_fd;
+  progress.stop_fd = eventfd(0, 0);
+  progress.interval_ms = client_config->progress_interval_ms;
+  progress.train_size = train_size;
+  // without its stop eventfd or thread the trains are received unstreamed
+  int streaming = progress.interval_ms > 0 && progress.stop_fd >= 0 &&
+                  pthread_create(&progress_tid, NULL, progress_thread,
+                                 &progress) == 0;
 
-  free(payload);
-  close(server_fd); // done receiving packets
+  logger("[PROBING PHASE] Waiting for low-entropy and high-entropy packet "
+         "trains");
+  schedule_trains(&schedule, client_config, LOW_TRAIN_ID, 2);
+  schedule.start_timeout_us += grant.start_in_us;
+  int received = receiver_run(receiver, &schedule, stats);
+  if (streaming) {
+    eventfd_write(progress.stop_fd, 1);
+    pthread_join(progress_tid, NULL);
+  }
+  if (progress.stop_fd >= 0) {
+    close(progress.stop_fd);
+  }
+  if (received >= 0 && config->perf) {
+    struct PerfSample perf;
+    receiver_perf(receiver, &perf);
+    perf_report("receive", &perf, stats[0].received + stats[1].received);
+  }
+  receiver_close(receiver); // done receiving packets
+  // the slot is given back once the port is free for the next train
+  admission_release(session->admission, &grant);
+  if (received < 0) {
+    return CD_ERR_SOCKET;
+  }
+  result->aborted = atomic_load(&progress.abort_reason);
+  result->low = stats[0];
+  result->high = stats[1];
+  log_train_stats("low-entropy", &result->low, train_size);
+  log_train_stats("high-entropy", &result->high, train_size);
 
   // calculate compression
-  long delta_low = (end_low.tv_sec - start_low.tv_sec) * 1000000 +
-                   (end_low.tv_nsec - start_low.tv_nsec) / 1000;
-  long delta_high = (end_high.tv_sec - start_high.tv_sec) * 1000000 +
-                    (end_high.tv_nsec - start_high.tv_nsec) / 1000;
-  long delta_diff = delta_high - delta_low;
-  logger("[PROBING PHASE] delta_high = %ld", delta_high);
-  logger("[PROBING PHASE] delta_low = %ld", delta_low);
-  logger("[PROBING PHASE] delta_diff = %ld", delta_diff);
+  result->delta_low = result->low.dispersion_us;
+  result->delta_high = result->high.dispersion_us;
+  long delta_diff =
+      path_dispersion_us(&result->high) - path_dispersion_us(&result->low);
+  result->delta_diff = delta_diff;
+  logger("[PROBING PHASE] delta_high = %ld", result->delta_high);
+  logger("[PROBING PHASE] delta_low = %ld", result->delta_low);
+  if (result->low.stamped > 1 && result->high.stamped > 1) {
+    logger("[PROBING PHASE] delta_diff = %ld (%ld before output-minus-input "
+           "correction)",
+           delta_diff, result->delta_high - result->delta_low);
+  } else {
+    logger("[PROBING PHASE] delta_diff = %ld", delta_diff);
+  }
 
   if (delta_diff > THRESHOLD) {
     logger("[PROBING PHASE] Compression detected!");
-    return 1;
+    result->has_compression = 1;
   } else {
     logger("[PROBING PHASE] No compression was detected.");
-    return 0;
+    result->has_compression = 0;
+  }
+
+  // last frame of the measurement, with the final delta
+  if (streaming) {
+    struct ProgressFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.train_id = HIGH_TRAIN_ID;
+    frame.received = result->high.received;
+    frame.lost = result->high.lost;
+    frame.done = 1;
+    frame.elapsed_us = result->delta_high;
+    if (frame.received > 1) {
+      frame.mean_gap_us = frame.elapsed_us / (frame.received - 1);
+    }
+    frame.delta_us = delta_diff;
+    frame.decided = 1;
+    send_frame(session_fd, &frame);
   }
+  return CD_OK;
 }
 
 // The send_result function sends a message to a socket indicating whether or
 // not compression was detected during a probing phase. If compression was
 // detected, the message reads "Compression detected!". Otherwise, the message
-// reads "No compression was detected."
-void send_result(int sock_fd, int compression_detected) {
-  char *message;
-  if (compression_detected) {
-    message = "Compression detected!";
-  } else {
-    message = "No compression was detected.";
+// reads "No compression was detected." If the client aborted because the path
+// was losing packets there is no verdict. The loss, reordering and kernel
+// drops of both trains follow.
+void send_result(int sock_fd, struct ProbeResult *result) {
+  char message[256];
+  const char *verdict =
+      result->has_compression ? VERDICT_COMPRESSION : VERDICT_NONE;
+  if (result->aborted == ABORT_BROKEN) {
+    verdict = VERDICT_ABORTED;
+  }
+  snprintf(message, sizeof(message),
+           "%s (low: %d lost, %d reordered, %d dropped; high: %d lost, %d "
+           "reordered, %d dropped)",
+           verdict,
+           result->low.lost, result->low.reordered, result->low.kernel_drops,
+           result->high.lost, result->high.reordered,
+           result->high.kernel_drops);
+  send(sock_fd, message, strlen(message), MSG_NOSIGNAL);
+}
+
+// Publishes the result of a measurement to the result ring of the server, if
+// it has one. session_fd is the control session, connected to the client.
+void publish_result(struct Config *config, struct Config *client_config,
+                    uint64_t hash, int64_t started_ns, int session_fd,
+                    struct ProbeResult *result) {
+  if (config->result_ring == NULL) {
+    return;
+  }
+  struct ResultRecord record;
+  memset(&record, 0, sizeof(record));
+  record.config_hash = hash;
+  record.started_ns = started_ns;
+  record.finished_ns = ring_clock_ns();
+  record.delta_low_ns = result->delta_low * 1000;
+  record.delta_high_ns = result->delta_high * 1000;
+  record.threshold_ns = THRESHOLD * 1000L;
+  struct sockaddr_in peer;
+  socklen_t len = sizeof(peer);
+  if (getpeername(session_fd, (struct sockaddr *)&peer, &len) == 0) {
+    record.peer_ip = peer.sin_addr.s_addr;
   }
-  send(sock_fd, message, strlen(message), 0);
+  record.dst_port = client_config->dst_port_udp;
+  record.mode = RESULT_MODE_SERVER;
+  record.verdict = result->aborted == ABORT_BROKEN ? RESULT_ABORTED
+                   : result->has_compression      ? RESULT_COMPRESSION
+                                                  : RESULT_NONE;
+  record.train_size = client_config->udp_train_size;
+  record.payload_size = client_config->payload_size;
+  struct TrainStats *trains[2] = {&result->low, &result->high};
+  struct RecordTrain *records[2] = {&record.low, &record.high};
+  for (int t = 0; t < 2; t++) {
+    records[t]->received = trains[t]->received;
+    records[t]->lost = trains[t]->lost;
+    records[t]->reordered = trains[t]->reordered;
+    records[t]->kernel_drops = trains[t]->kernel_drops;
+  }
+  ring_publish_once(config->result_ring, &record);
 }
 
 // The post_probing_s function sets up a TCP server on the specified port and
 // listens for incoming connections from the client. Once a connection is
-// established, the server sends the result of the probing phase (whether
-// compression was detected or not) to the client and then closes the connection
-// and the server socket.
-void post_probing_s(int port, int has_compression) {
+// established and the client asked for its result with RESULT_RQ, the server
+// sends the result of the probing phase (whether compression was detected or
+// not) to the client and then closes the connection and the server socket.
+// Returns CD_OK or an error code.
+int post_probing_s(int port, struct ProbeResult *result) {
   int server_fd, client_fd;
   struct sockaddr_in server_addr, client_addr;
   socklen_t len;
 
   if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
     perror("[POST-PROBING PHASE] Socket creation failed");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
   }
 
   // set socket to re-use addr
@@ -278,7 +583,8 @@ void post_probing_s(int port, int has_compression) {
   if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) <
       0) {
     perror("[PRE-PROBING PHASE] Failed to set SO_REUSEADDR option");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   memset(&server_addr, 0, sizeof(server_addr));
@@ -291,12 +597,14 @@ void post_probing_s(int port, int has_compression) {
   if (bind(server_fd, (const struct sockaddr *)&server_addr,
            sizeof(server_addr)) < 0) {
     perror("[POST-PROBING PHASE] Socket bind failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   if (listen(server_fd, 1) < 0) {
     perror("[POST-PROBING PHASE] Listen failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_SOCKET;
   }
 
   logger("[POST-PROBING PHASE] Listening on port %d", port);
@@ -304,33 +612,586 @@ void post_probing_s(int port, int has_compression) {
   if ((client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &len)) <
       0) {
     perror("[POST-PROBING PHASE] Accept failed");
-    exit(EXIT_FAILURE);
+    close(server_fd);
+    return CD_ERR_CONNECT;
   }
 
-  send_result(client_fd, has_compression);
+  // RESULT_RQ and the session id, which a single session does not need
+  char request[sizeof(uint32_t) + 1];
+  if (recv(client_fd, request, sizeof(request), MSG_WAITALL) !=
+          sizeof(request) ||
+      request[0] != RESULT_RQ) {
+    printf("[POST-PROBING PHASE] [ERROR] Client did not ask for its result\n");
+    close(client_fd);
+    close(server_fd);
+    return CD_ERR_PROTOCOL;
+  }
+  send_result(client_fd, result);
   logger("[POST-PROBING PHASE] Sent results to client! Closing.");
 
   close(client_fd);
   close(server_fd);
+  return CD_OK;
 }
 
-// The run_server function initiates the pre-probing, probing, and post-probing
-// phases of the server-side compression detection algorithm. It takes a single
-// integer argument port which is the port number to listen on. Here's a more
-// succinct version of the function:
-void run_server(int port) {
+// The sweep_s function serves a parameter sweep over the control session. For
+// every SWEEP_CELL_RQ it waits for the slot of the cell's train, replies
+// SWEEP_READY once it starts, receives the train (whose train id is the cell
+// index) and sends back the train's stats. The receiver is opened within the
+// slot, so a sweep never shares its port with the trains of another session.
+// It returns CD_OK when the client sends SWEEP_DONE_RQ or disconnects, or an
+// error code.
+int sweep_s(struct Config *config, struct Config *client_config,
+            struct Session *session) {
+  int session_fd = session->fd;
+  int port = client_config->dst_port_udp;
+  int max_payload_size = 0;
+  int train_size = client_config->udp_train_size;
+  // cells are sent by a single sender
+  int rate_pps = delay_to_rate(client_config->inter_packet_delay_us, 1);
+
+  for (int p = 0; p < client_config->sweep_payload_count; p++) {
+    if (client_config->sweep_payload_sizes[p] > max_payload_size) {
+      max_payload_size = client_config->sweep_payload_sizes[p];
+    }
+  }
+
+  for (;;) {
+    char buffer[sizeof(struct SweepCell) + 1];
+    if (recv(session_fd, buffer, 1, MSG_WAITALL) != 1 ||
+        buffer[0] != SWEEP_CELL_RQ) {
+      break; // SWEEP_DONE_RQ or client gone
+    }
+    struct SweepCell cell;
+    if (recv(session_fd, buffer + 1, sizeof(cell), MSG_WAITALL) !=
+        sizeof(cell)) {
+      break;
+    }
+    memcpy(&cell, buffer + 1, sizeof(cell));
+    if (cell.payload_size > max_payload_size || cell.train_size > train_size) {
+      printf("[SWEEP] Rejected cell with payload_size=%d train_size=%d\n",
+             cell.payload_size, cell.train_size);
+      break;
+    }
+
+    struct TrainGrant grant;
+    admit_train(session, port, train_rate_kbps(cell.payload_size, rate_pps),
+                &grant);
+    size_t mark = arena_mark(&session->arena);
+    struct Receiver *receiver = receiver_open(config, &session->arena, port,
+                                              max_payload_size, train_size);
+    if (receiver == NULL) {
+      admission_release(session->admission, &grant);
+      return CD_ERR_SOCKET;
+    }
+    usleep(grant.start_in_us);
+
+    struct TrainSchedule schedule;
+    struct TrainStats stats;
+    schedule_trains(&schedule, client_config, cell.train_id, 1);
+    schedule.train_size = cell.train_size;
+    char ready = SWEEP_READY;
+    send(session_fd, &ready, 1, MSG_NOSIGNAL);
+
+    logger("[SWEEP] Waiting for train: payload_size=%d entropy=%.2f",
+           cell.payload_size, cell.entropy);
+    receiver_run(receiver, &schedule, &stats);
+    receiver_close(receiver);
+    admission_release(session->admission, &grant);
+    arena_reset(&session->arena, mark);
+
+    struct SweepResult result;
+    result.received = stats.received;
+    result.lost = stats.lost;
+    result.reordered = stats.reordered;
+    result.kernel_drops = stats.kernel_drops;
+    result.dispersion_us = stats.dispersion_us;
+    logger("[SWEEP] Received %d/%d packets (lost %d, reordered %d, dropped "
+           "%d), dispersion = %ld us",
+           result.received, cell.train_size, result.lost, result.reordered,
+           result.kernel_drops, result.dispersion_us);
+    send(session_fd, &result, sizeof(result), MSG_NOSIGNAL);
+  }
+  return CD_OK;
+}
+
+// The warmup_s function serves the warm-up rounds of the client over the
+// control session. For each round it receives the train size and rate, waits
+// for the slot of the train, replies once it starts, receives the train and
+// sends back the packets received, the loss and the highest packet id. When
+// the client sends WARMUP_DONE_RQ it also sends the inter_packet_delay_us it
+// picked, which replaces the one in client_config so that the deadlines of
+// the timed trains match their rate. Returns CD_OK or an error code.
+int warmup_s(struct Config *config, struct Config *client_config,
+             struct Session *session) {
+  int session_fd = session->fd;
+  int port = client_config->dst_port_udp;
+  int max_train_size = client_config->warmup_train_size;
+  struct Config train_config = *client_config;
+  train_config.sender_threads = 1; // warm-up trains use a single sender
+
+  for (;;) {
+    char request;
+    if (recv(session_fd, &request, 1, MSG_WAITALL) != 1) {
+      break; // client gone
+    }
+    if (request == WARMUP_DONE_RQ) {
+      int inter_packet_delay_us;
+      if (recv(session_fd, &inter_packet_delay_us,
+               sizeof(inter_packet_delay_us),
+               MSG_WAITALL) == sizeof(inter_packet_delay_us)) {
+        client_config->inter_packet_delay_us = inter_packet_delay_us;
+        logger("[WARM-UP] Client picked inter_packet_delay_us = %d",
+               inter_packet_delay_us);
+      }
+      break;
+    }
+
+    struct WarmupTrain train;
+    if (request != WARMUP_TRAIN_RQ ||
+        recv(session_fd, &train, sizeof(train), MSG_WAITALL) != sizeof(train)) {
+      break;
+    }
+    if (train.train_size > max_train_size || train.rate_pps <= 0) {
+      printf("[WARM-UP] Rejected train with train_size=%d rate=%d pps\n",
+             train.train_size, train.rate_pps);
+      break;
+    }
+
+    struct TrainGrant grant;
+    admit_train(session, port,
+                train_rate_kbps(client_config->payload_size, train.rate_pps),
+                &grant);
+    size_t mark = arena_mark(&session->arena);
+    struct Receiver *receiver =
+        receiver_open(config, &session->arena, port,
+                      client_config->payload_size, max_train_size);
+    if (receiver == NULL) {
+      admission_release(session->admission, &grant);
+      return CD_ERR_SOCKET;
+    }
+    usleep(grant.start_in_us);
+
+    struct TrainSchedule schedule;
+    struct TrainStats stats;
+    train_config.udp_train_size = train.train_size;
+    train_config.inter_packet_delay_us = rate_to_delay(train.rate_pps, 1);
+    schedule_trains(&schedule, &train_config, train.train_id, 1);
+    char ready = SWEEP_READY;
+    send(session_fd, &ready, 1, MSG_NOSIGNAL);
+    receiver_run(receiver, &schedule, &stats);
+    receiver_close(receiver);
+    admission_release(session->admission, &grant);
+    arena_reset(&session->arena, mark);
+
+    struct WarmupFeedback feedback;
+    feedback.received = stats.received;
+    feedback.lost = stats.lost;
+    feedback.highest_packet_id = stats.max_packet_id;
+    feedback.kernel_drops = stats.kernel_drops;
+    feedback.dispersion_us = stats.dispersion_us;
+    logger("[WARM-UP] Received %d/%d packets at %d pps (lost %d, dropped %d)",
+           feedback.received, train.train_size, train.rate_pps, feedback.lost,
+           feedback.kernel_drops);
+    send(session_fd, &feedback, sizeof(feedback), MSG_NOSIGNAL);
+  }
+  return CD_OK;
+}
+
+// IPv4 address of the peer of a connected socket, or 0 if it is unknown
+static uint32_t peer_address(int fd) {
+  struct sockaddr_in peer;
+  socklen_t len = sizeof(peer);
+  if (getpeername(fd, (struct sockaddr *)&peer, &len) < 0 ||
+      peer.sin_family != AF_INET) {
+    return 0;
+  }
+  return peer.sin_addr.s_addr;
+}
+
+// Draws the id of a new session, random so that a client cannot guess the
+// id of another one, never 0 and not one of a kept result. Called with the
+// server locked.
+static uint32_t new_session_id(struct SessionServer *server) {
+  for (;;) {
+    uint32_t id;
+    if (getrandom(&id, sizeof(id), 0) != sizeof(id)) {
+      id = server->next_id++;
+    }
+    struct StoredResult *stored = server->results;
+    while (stored != NULL && stored->session_id != id) {
+      stored = stored->next;
+    }
+    if (id != 0 && stored == NULL) {
+      return id;
+    }
+  }
+}
+
+// Hands the result of a session to its client: a concurrent server keeps it
+// until the client fetches it, otherwise the post-probing phase listens for
+// the client
+static int deliver_result(struct SessionServer *server,
+                          struct Session *session,
+                          struct ProbeResult *result) {
+  if (!server->concurrent) {
+    logger("[INFO] Init Post-probing phase.");
+    int error = post_probing_s(server->config->pp_port_tcp,
+                               result); // <- run post-probing
+    logger("[INFO] Post-probing phase completed.");
+    return error;
+  }
+  struct StoredResult *stored = malloc(sizeof(struct StoredResult));
+  if (stored == NULL) {
+    perror("[POST-PROBING PHASE] Failed storing result");
+    return CD_ERR_RESOURCE;
+  }
+  time_t now = time(NULL);
+  stored->session_id = session->id;
+  stored->peer_ip = session->peer_ip;
+  stored->result = *result;
+  stored->stored_s = now;
+  pthread_mutex_lock(&server->lock);
+  // results of clients that never came back are dropped
+  struct StoredResult **link = &server->results;
+  while (*link != NULL) {
+    if (now - (*link)->stored_s > RESULT_KEEP_S) {
+      struct StoredResult *expired = *link;
+      *link = expired->next;
+      free(expired);
+    } else {
+      link = &(*link)->next;
+    }
+  }
+  stored->next = server->results;
+  server->results = stored;
+  pthread_mutex_unlock(&server->lock);
+  logger("[POST-PROBING PHASE] Result of session %u kept for its client",
+         session->id);
+  return CD_OK;
+}
+
+// Serves the phases of one client over its control session: the sweep, or the
+// warm-up rounds (if any), the probing and the post-probing phase
+static int serve_phases(struct SessionServer *server,
+                        struct Config *client_config, struct Session *session,
+                        int64_t started_ns) {
+  struct Config *config = server->config;
+  uint64_t hash = config_hash(client_config); // before warm-up changes it
+  if (client_config->sweep_payload_count > 0 &&
+      client_config->sweep_entropy_count > 0) {
+    logger("[INFO] Init Sweep.");
+    int error = sweep_s(config, client_config, session); // <- run sweep
+    close(session->fd);
+    logger("[INFO] Sweep completed.");
+    return error;
+  }
+  if (client_config->warmup_trains > 0) {
+    logger("[INFO] Init Warm-up.");
+    int error = warmup_s(config, client_config, session); // <- run warm-up
+    if (error != CD_OK) {
+      close(session->fd);
+      return error;
+    }
+    logger("[INFO] Warm-up completed.");
+  }
+  logger("[INFO] Init Probing phase.");
+  struct ProbeResult result;
+  int error = probing_s(config, client_config, session,
+                        &result); // <- run probing
+  if (error != CD_OK) {
+    close(session->fd);
+    return error;
+  }
+  publish_result(config, client_config, hash, started_ns, session->fd,
+                 &result);
+  close(session->fd);
+  logger("[INFO] Probing phase completed.");
+  return deliver_result(server, session, &result);
+}
+
+// Serves one client with its session arena, sized for the largest payload
+// its receivers take. The session is closed on return.
+static int serve_session(struct SessionServer *server,
+                         struct Config *client_config, struct Session *session,
+                         int64_t started_ns) {
+  int max_payload_size = client_config->payload_size;
+  for (int p = 0; p < client_config->sweep_payload_count; p++) {
+    if (client_config->sweep_payload_sizes[p] > max_payload_size) {
+      max_payload_size = client_config->sweep_payload_sizes[p];
+    }
+  }
+  size_t size = receiver_arena_size(server->config, max_payload_size, 2);
+  if (arena_open(&session->arena, size, server->config->arena_hugepages) !=
+      CD_OK) {
+    close(session->fd);
+    return CD_ERR_RESOURCE;
+  }
+  int error = serve_phases(server, client_config, session, started_ns);
+  arena_close(&session->arena);
+  return error;
+}
+
+// Serves a single measurement: pre-probing on a listener opened for it, the
+// session and the post-probing phase
+static int serve_once(struct SessionServer *server) {
+  int port = server->config->pp_port_tcp;
+  int64_t started_ns = ring_clock_ns();
+  struct Session session;
   logger("[INFO] Init Pre-probing phase.");
-  struct Config *client_config = pre_probing_s(port); // <- run pre-probing
+  struct Config received;
+  struct Config *client_config;
+  int error = pre_probing_s(port, &session.fd, &received,
+                            &client_config); // <- run pre-probing
+  if (error != CD_OK) {
+    printf("Did not receive client config. Something went wrong\n");
+    return error;
+  }
   if (client_config == NULL) {
-    perror("Did not receive client config. Something went wrong");
-    exit(EXIT_FAILURE);
+    return CD_OK; // shutdown request
   }
   logger("[INFO] Pre-probing phase completed.");
-  logger("[INFO] Init Probing phase.");
-  int has_compression = probing_s(client_config); // <- run probing
-  free(client_config);
-  logger("[INFO] Probing phase completed.");
-  logger("[INFO] Init Post-probing phase.");
-  post_probing_s(port, has_compression); // <- run post-probing
-  logger("[INFO] Post-probing phase completed.");
+  session.id = new_session_id(server);
+  session.peer_ip = peer_address(session.fd);
+  session.ifindex = admission_interface(session.fd);
+  session.admission = server->admission;
+  return serve_session(server, client_config, &session, started_ns);
+}
+
+// A connection accepted by a concurrent server
+struct Connection {
+  struct SessionServer *server;
+  int fd;
+  int64_t started_ns;
+};
+
+// Sends a kept result to the client asking for it with RESULT_RQ and its
+// session id, if it asks from the address of the session. The connection is
+// closed on return.
+static void serve_result(struct SessionServer *server, int fd) {
+  char request[sizeof(uint32_t) + 1];
+  uint32_t session_id;
+  if (recv(fd, request, sizeof(request), MSG_WAITALL) != sizeof(request)) {
+    close(fd);
+    return;
+  }
+  memcpy(&session_id, request + 1, sizeof(session_id));
+  uint32_t peer_ip = peer_address(fd);
+  pthread_mutex_lock(&server->lock);
+  struct StoredResult **link = &server->results;
+  while (*link != NULL && (*link)->session_id != session_id) {
+    link = &(*link)->next;
+  }
+  struct StoredResult *stored = *link;
+  // a result asked for from another address stays for its client
+  int foreign = stored != NULL && stored->peer_ip != peer_ip;
+  if (stored != NULL && !foreign) {
+    *link = stored->next;
+  }
+  pthread_mutex_unlock(&server->lock);
+  if (stored == NULL || foreign) {
+    printf("[POST-PROBING PHASE] [ERROR] No result for session %u\n",
+           session_id);
+  } else {
+    send_result(fd, &stored->result);
+    logger("[POST-PROBING PHASE] Sent result of session %u to client!",
+           session_id);
+    free(stored);
+  }
+  close(fd);
+}
+
+// Body of the thread of a connection to a concurrent server. Its first
+// request tells a new session (CONFIG_FILE_RQ) from a client fetching its
+// result (RESULT_RQ); SHUTDOWN_RQ stops the server.
+static void *connection_thread(void *args) {
+  struct Connection *connection = (struct Connection *)args;
+  struct SessionServer *server = connection->server;
+  char request;
+  if (recv(connection->fd, &request, 1, MSG_PEEK) != 1) {
+    close(connection->fd);
+  } else if (request == RESULT_RQ) {
+    serve_result(server, connection->fd);
+  } else {
+    struct Config received;
+    struct Config *client_config;
+    if (recv_config(connection->fd, &received, &client_config) != CD_OK ||
+        client_config == NULL) {
+      if (request == SHUTDOWN_RQ) {
+        stop_requested = 1;
+      }
+      close(connection->fd);
+    } else {
+      struct Session session;
+      session.fd = connection->fd;
+      session.ifindex = admission_interface(connection->fd);
+      session.admission = server->admission;
+      session.peer_ip = peer_address(connection->fd);
+      pthread_mutex_lock(&server->lock);
+      session.id = new_session_id(server);
+      pthread_mutex_unlock(&server->lock);
+      logger("[INFO] Session %u started (interface %d)", session.id,
+             session.ifindex);
+      int error = serve_session(server, client_config, &session,
+                                connection->started_ns);
+      logger("[INFO] Session %u ended (%d)", session.id, error);
+    }
+  }
+  pthread_mutex_lock(&server->lock);
+  server->connections--;
+  pthread_cond_broadcast(&server->changed);
+  pthread_mutex_unlock(&server->lock);
+  free(connection);
+  return NULL;
+}
+
+// Opens the listener of a concurrent server on port
+static int open_listener(int port) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    perror("[PRE-PROBING PHASE] Failed creating server socket");
+    return -1;
+  }
+  int optval = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+  struct sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_addr.s_addr = INADDR_ANY;
+  server_addr.sin_port = htons(port);
+  if (bind(listen_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
+          0 ||
+      listen(listen_fd, SOMAXCONN) < 0) {
+    perror("[PRE-PROBING PHASE] Failed listening on server socket");
+    close(listen_fd);
+    return -1;
+  }
+  return listen_fd;
+}
+
+// Waits up to 200 ms for a change of the connections of a server. Called with
+// its lock held.
+static void wait_connections(struct SessionServer *server) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += 200000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  pthread_cond_timedwait(&server->changed, &server->lock, &deadline);
+}
+
+// Serves sessions concurrently, each on its own thread, until SIGINT, SIGTERM
+// or a SHUTDOWN_RQ. At most concurrent_sessions connections are served at
+// once; the next ones wait in the listen backlog. Clients fetch their result
+// over a new connection on the same port.
+static int serve_concurrent(struct SessionServer *server) {
+  int port = server->config->pp_port_tcp;
+  int max_connections = server->config->concurrent_sessions;
+  int listen_fd = open_listener(port);
+  if (listen_fd < 0) {
+    return CD_ERR_SOCKET;
+  }
+  struct sigaction action = {0};
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  logger("[INFO] Serving up to %d concurrent sessions on port %d",
+         max_connections, port);
+
+  // connection threads leave the signals to this one, so they do not
+  // interrupt the receive loops of a session
+  sigset_t blocked, previous;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGINT);
+  sigaddset(&blocked, SIGTERM);
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  struct pollfd listener = {.fd = listen_fd, .events = POLLIN};
+  while (!stop_requested) {
+    pthread_mutex_lock(&server->lock);
+    while (!stop_requested && server->connections >= max_connections) {
+      wait_connections(server);
+    }
+    pthread_mutex_unlock(&server->lock);
+    if (stop_requested || poll(&listener, 1, 200) <= 0) {
+      continue;
+    }
+    struct sockaddr_in client_addr;
+    socklen_t len = sizeof(client_addr);
+    int fd = accept(listen_fd, (struct sockaddr *)&client_addr, &len);
+    if (fd < 0) {
+      continue;
+    }
+    logger("[PRE-PROBING PHASE] Accepted incoming connection from %s:%d.",
+           inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+    struct Connection *connection = malloc(sizeof(struct Connection));
+    if (connection == NULL) {
+      close(fd);
+      continue;
+    }
+    connection->server = server;
+    connection->fd = fd;
+    connection->started_ns = ring_clock_ns();
+    pthread_t tid;
+    pthread_mutex_lock(&server->lock);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    int rc = pthread_create(&tid, &attr, connection_thread, connection);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (rc == 0) {
+      server->connections++;
+    }
+    pthread_mutex_unlock(&server->lock);
+    if (rc != 0) {
+      printf("[INFO] [ERROR] pthread_create: %s\n", strerror(rc));
+      close(fd);
+      free(connection);
+    }
+  }
+  pthread_attr_destroy(&attr);
+  close(listen_fd);
+
+  // sessions in flight run to their end
+  pthread_mutex_lock(&server->lock);
+  while (server->connections > 0) {
+    wait_connections(server);
+  }
+  pthread_mutex_unlock(&server->lock);
+  printf("Server shutting down.\n");
+  return CD_OK;
+}
+
+// The run_server function initiates the pre-probing, probing, and post-probing
+// phases of the server-side compression detection algorithm. It takes the
+// server config, whose pp_port_tcp is the port to listen on. With
+// concurrent_sessions set it serves sessions until it is stopped, otherwise a
+// single one. Returns CD_OK, also after a shutdown request, or an error code.
+int run_server(struct Config *config) {
+  struct SessionServer server;
+  tsc_init_once(config->tsc);
+  memset(&server, 0, sizeof(server));
+  server.config = config;
+  server.concurrent = config->concurrent_sessions > 0;
+  server.next_id = 1;
+  server.admission =
+      admission_open(config->interface_budget_kbps, config->admission_guard_ms);
+  if (server.admission == NULL) {
+    perror("[INFO] Failed allocating admission control");
+    return CD_ERR_RESOURCE;
+  }
+  pthread_mutex_init(&server.lock, NULL);
+  pthread_cond_init(&server.changed, NULL);
+  int error =
+      server.concurrent ? serve_concurrent(&server) : serve_once(&server);
+  while (server.results != NULL) {
+    struct StoredResult *next = server.results->next;
+    free(server.results);
+    server.results = next;
+  }
+  pthread_cond_destroy(&server.changed);
+  pthread_mutex_destroy(&server.lock);
+  admission_close(server.admission);
+  return error;
 }
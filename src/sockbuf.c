@@ -0,0 +1,87 @@
+#include "../include/sockbuf.h"
+#include "../include/logger.h"
+#include "../include/tsc.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+// Set once the busy-poll options were refused, so each socket does not repeat
+// the warning
+static atomic_int busy_poll_warned;
+
+// Returns the buffer size needed to queue a whole train
+int train_buffer_bytes(int train_size, int payload_size) {
+  long bytes = (long)train_size * (payload_size + SKB_OVERHEAD_BYTES);
+  return bytes > SOCKET_BUFFER_MAX ? SOCKET_BUFFER_MAX : (int)bytes;
+}
+
+// Sizes a socket buffer and reports what the kernel granted
+int size_socket_buffer(int sock_fd, int direction, int bytes) {
+  int force = direction == SOCKBUF_RECEIVE ? SO_RCVBUFFORCE : SO_SNDBUFFORCE;
+  int option = direction == SOCKBUF_RECEIVE ? SO_RCVBUF : SO_SNDBUF;
+  const char *name = direction == SOCKBUF_RECEIVE ? "SO_RCVBUF" : "SO_SNDBUF";
+
+  if (setsockopt(sock_fd, SOL_SOCKET, force, &bytes, sizeof(bytes)) < 0) {
+    setsockopt(sock_fd, SOL_SOCKET, option, &bytes, sizeof(bytes));
+  }
+
+  // the kernel doubles the requested value to account for its bookkeeping
+  int granted = 0;
+  socklen_t len = sizeof(granted);
+  getsockopt(sock_fd, SOL_SOCKET, option, &granted, &len);
+  granted /= 2;
+  if (granted < bytes) {
+    printf("[SOCKBUF] [WARNING] %s capped at %d bytes (requested %d); raise "
+           "net.core.%s or run with CAP_NET_ADMIN\n",
+           name, granted, bytes,
+           direction == SOCKBUF_RECEIVE ? "rmem_max" : "wmem_max");
+  } else {
+    logger("[SOCKBUF] %s set to %d bytes", name, granted);
+  }
+  return granted;
+}
+
+// Enables busy polling on a socket
+int enable_busy_poll(int sock_fd, int busy_poll_us) {
+  int prefer = 1;
+  const char *refused = NULL;
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                 sizeof(busy_poll_us)) < 0) {
+    refused = "SO_BUSY_POLL";
+  } else if (setsockopt(sock_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer,
+                        sizeof(prefer)) < 0) {
+    refused = "SO_PREFER_BUSY_POLL";
+  }
+  if (refused == NULL) {
+    logger("[BUSY POLL] Socket polls the device queue for %d us per read",
+           busy_poll_us);
+    return 0;
+  }
+  if (!atomic_exchange(&busy_poll_warned, 1)) {
+    printf("[BUSY POLL] [WARNING] %s refused (%s), spinning on the socket "
+           "only\n",
+           refused, strerror(errno));
+  }
+  return -1;
+}
+
+// Spins until a packet is queued on a socket
+int spin_readable(int sock_fd, long long timeout_ns) {
+  long long deadline_ns = tsc_now_ns() + timeout_ns;
+  char byte;
+  do {
+    if (recv(sock_fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) >= 0) {
+      return 1;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      return -1;
+    }
+  } while (tsc_now_ns() < deadline_ns);
+  return 0;
+}
@@ -1,7 +1,18 @@
 #include "../include/standalone.h"
+#include "../include/cderror.h"
 #include "../include/config.h"
+#include "../include/hops.h"
 #include "../include/logger.h"
+#include "../include/perf.h"
+#include "../include/prime.h"
+#include "../include/probe.h"
+#include "../include/realtime.h"
+#include "../include/ring.h"
+#include "../include/sockbuf.h"
+#include "../include/tsc.h"
+#include "../include/txtime.h"
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
@@ -16,13 +27,53 @@
 #include <time.h>
 #include <unistd.h>
 
-// 100ms in nanoseconds as fixed threshold above which compression is assumed to
-// be enabled
-#define THRESHOLD 100000000L
+// Largest number of sub-trains of an interleaved measurement
+#define MAX_SUB_TRAINS 64
 
+// Longest gap between two interleaved sub-trains (1s in us)
+#define MAX_INTERLEAVE_GAP_US 1000000L
+
+// Largest number of intra-train SYN markers per train
+#define MAX_TRAIN_MARKERS 64
+
+// RST listener of the standalone measurement. Each train is split by its
+// boundaries: the head SYN (0), its markers (1..markers) and the tail SYN
+// (markers + 1). The RSTs of the head and tail ports are shared by both
+// trains; those of the markers are told apart by port (the low train's
+// markers use first_marker_port onwards, the high train's follow).
 struct RstArgs {
+  int sock; // raw socket the RSTs arrive on
+  char *buf; // PACKET_BUFFER_SIZE bytes to receive them in
+  int error; // set by the listener if its socket fails
   int rst_timeout_s;
-  int rst_packets;
+  int markers; // intra-train markers per train
+  unsigned short head_port;
+  unsigned short tail_port;
+  unsigned short first_marker_port;
+  struct Config *config;
+  int64_t started_ns; // start of the measurement, for the result ring
+  long long ts_ns[2][MAX_TRAIN_MARKERS + 2]; // arrival of the RSTs
+  int seen[2][MAX_TRAIN_MARKERS + 2];
+};
+
+// SYN markers of an interleaved measurement. Sub-train j is bracketed by a
+// SYN to head_port[j] and one to tail_port[j]; the listener records when the
+// RST of each port arrives and signals the sender.
+struct MarkerArgs {
+  int sock;
+  char *buf; // PACKET_BUFFER_SIZE bytes to receive the RSTs in
+  int sub_trains;
+  unsigned short head_port[MAX_SUB_TRAINS];
+  unsigned short tail_port[MAX_SUB_TRAINS];
+  long long head_ns[MAX_SUB_TRAINS]; // arrival of the RSTs (tsc_now_ns)
+  long long tail_ns[MAX_SUB_TRAINS];
+  int head_seen[MAX_SUB_TRAINS];
+  int tail_seen[MAX_SUB_TRAINS];
+  int done;
+  int error; // set by the listener if its socket fails
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct Config *config;
 };
 
 // This function creates a UDP socket and sets its time-to-live (TTL) value. It
@@ -61,79 +112,216 @@ int create_udp_socket(const char *dst_addr, int dst_port, int ttl) {
   return sock_fd;
 }
 
-// This function sends a train of low-entropy packets over UDP to a specified
-// destination address and port, with a specified time-to-live (TTL) value,
-// train size, payload size, and inter-packet delay.
-void send_udp_low_entropy_packet_train(const char *dst_addr, int dst_port,
-                                       int ttl, int train_size,
-                                       int payload_size,
-                                       int inter_packet_delay_us) {
-  char payload[payload_size];
-  memset(payload, 0, payload_size);
+// Clears the pending error of a connected UDP socket, e.g. the ICMP port
+// unreachable answering an earlier train, which would fail the next send
+static void clear_socket_error(int sock_fd) {
+  int error = 0;
+  socklen_t len = sizeof(error);
+  getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &error, &len);
+}
 
-  int sock_fd = create_udp_socket(dst_addr, dst_port, ttl);
-  if (sock_fd < 0) {
+// Sends packet i of a train on a connected socket. Without kernel pacing the
+// packet leaves right away and the caller sleeps inter_packet_delay_us after
+// it; with kernel pacing it is queued to leave at start_ns + i * delay and the
+// qdisc does the spacing. A send failing on an ICMP port unreachable received
+// meanwhile (which only reports the error) is retried once.
+void send_train_packet(int sock_fd, void *payload, int payload_size, int i,
+                       int train_size, int inter_packet_delay_us,
+                       struct TxTime *txtime, uint64_t start_ns) {
+  if (txtime != NULL && txtime->enabled) {
+    uint64_t launch_ns = start_ns + (uint64_t)i * inter_packet_delay_us * 1000;
+    if (send_udp_txtime(sock_fd, NULL, payload, payload_size, 0,
+                        launch_ns) < 0 &&
+        errno == ECONNREFUSED) {
+      send_udp_txtime(sock_fd, NULL, payload, payload_size, 0, launch_ns);
+    }
+    if (i == train_size - 1) {
+      // the tail SYN must not overtake the packets still held by the qdisc
+      txtime_sleep_until(txtime, launch_ns);
+    }
     return;
   }
-
-  for (int i = 0; i < train_size; i++) {
-    uint16_t packet_id = htons(i);
-    memcpy(payload, &packet_id, sizeof(packet_id));
+  if (send(sock_fd, payload, payload_size, 0) < 0 && errno == ECONNREFUSED) {
     send(sock_fd, payload, payload_size, 0);
-    if (i < train_size - 1) {
-      usleep(inter_packet_delay_us);
-    }
   }
-
-  close(sock_fd);
+  if (i < train_size - 1) {
+    usleep(inter_packet_delay_us);
+  }
 }
 
-// This function sends a high-entropy packet train over UDP to a specified
-// destination address and port using random bytes generated from /dev/urandom.
-// The payload size, number of packets in the train, and inter-packet delay can
-// be specified as parameters, as well as the time-to-live (TTL) value for the
-// packets.
-void send_udp_high_entropy_packet_train(const char *dst_addr, int dst_port,
-                                        int ttl, int train_size,
-                                        int payload_size,
-                                        int inter_packet_delay_us) {
-  unsigned char payload[payload_size];
-  FILE *urandom = fopen("/dev/urandom", "r");
-
-  if (!urandom) {
-    perror("Error opening /dev/urandom");
+// Sends the intra-train SYN marker due before packet i, if any. With kernel
+// pacing it first waits until the previous packet left, so the marker does
+// not overtake packets still held by the qdisc.
+static void send_marker(struct TrainMarkers *markers, int i,
+                        int inter_packet_delay_us, struct TxTime *txtime,
+                        uint64_t start_ns) {
+  if (markers == NULL || markers->interval <= 0 || i == 0 ||
+      i % markers->interval != 0) {
     return;
   }
+  if (txtime != NULL && txtime->enabled) {
+    txtime_sleep_until(txtime, start_ns + (uint64_t)(i - 1) *
+                                              inter_packet_delay_us * 1000);
+  }
+  send_tcp_syn_packet(markers->sock, markers->src_ip, markers->dst_ip,
+                      markers->src_port,
+                      markers->first_port + i / markers->interval - 1,
+                      markers->ttl);
+}
 
-  int sock_fd = create_udp_socket(dst_addr, dst_port, ttl);
-  if (sock_fd < 0) {
-    fclose(urandom);
-    return;
+// Returns the launch time of the first packet of a kernel-paced train, or 0
+// when the train is paced in user space
+uint64_t schedule_train_start(struct TxTime *txtime, int sock_fd) {
+  if (txtime == NULL || !txtime->enabled ||
+      txtime_enable_socket(txtime, sock_fd) < 0) {
+    return 0;
+  }
+  return txtime_now_ns(txtime) + TXTIME_LEAD_NS;
+}
+
+// Opens the UDP socket, the raw SYN socket, the arena of the payload and
+// listener buffers (and of the state of a hop sweep or an interleaved
+// measurement) and the random source of the trains, then primes the socket
+// and the buffers
+int open_train_sender(struct Config *config, int train_size,
+                      struct TrainSender *sender) {
+  int payload_size = config->payload_size;
+  memset(sender, 0, sizeof(*sender));
+  sender->syn_sock = -1;
+  sender->payload_size = payload_size;
+  size_t size = ARENA_BLOCK(payload_size) + ARENA_BLOCK(PACKET_BUFFER_SIZE);
+  if (config->hop_ttl_max > 0) {
+    size += ARENA_BLOCK(hop_sweep_size());
+  } else if (config->interleave_pairs > 0) {
+    size += ARENA_BLOCK(sizeof(struct MarkerArgs));
+  }
+  if (arena_open(&sender->arena, size, config->arena_hugepages) != CD_OK) {
+    return CD_ERR_RESOURCE;
+  }
+  sender->udp_sock = create_udp_socket(config->server_ip_addr,
+                                       config->dst_port_udp, config->udp_ttl);
+  if (sender->udp_sock < 0) {
+    close_train_sender(sender);
+    return CD_ERR_SOCKET;
   }
+  size_socket_buffer(sender->udp_sock, SOCKBUF_SEND,
+                     train_buffer_bytes(train_size, payload_size));
 
+  sender->syn_sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+  int optval = 1;
+  if (sender->syn_sock < 0 ||
+      setsockopt(sender->syn_sock, IPPROTO_IP, IP_HDRINCL, &optval,
+                 sizeof(optval)) < 0) {
+    perror("[STANDALONE] SYN socket");
+    close_train_sender(sender);
+    return CD_ERR_SOCKET;
+  }
+
+  sender->payload = arena_alloc(&sender->arena, payload_size);
+  sender->listen_buf = arena_alloc(&sender->arena, PACKET_BUFFER_SIZE);
+  sender->urandom = fopen("/dev/urandom", "r");
+  if (sender->payload == NULL || sender->listen_buf == NULL ||
+      sender->urandom == NULL) {
+    perror("[STANDALONE] Failed allocating payload");
+    close_train_sender(sender);
+    return CD_ERR_RESOURCE;
+  }
+
+  struct Priming priming;
+  prime_begin(&priming);
+  prime_buffer(&priming, sender->payload, payload_size);
+  prime_buffer(&priming, sender->listen_buf, PACKET_BUFFER_SIZE);
+  prime_socket(&priming, sender->udp_sock, NULL, sender->payload,
+               payload_size, config->prime_packets);
+  prime_end(&priming, "[STANDALONE]");
+  return CD_OK;
+}
+
+// Rejects ports that would wrap around
+int check_port_range(const char *tag, const char *what, long first,
+                     long last) {
+  if (first < 1 || last > 65535) {
+    printf("%s [ERROR] %s would use ports %ld-%ld, beyond 1-65535.\n", tag,
+           what, first, last);
+    return CD_ERR_CONFIG;
+  }
+  return CD_OK;
+}
+
+// Releases what open_train_sender opened
+void close_train_sender(struct TrainSender *sender) {
+  if (sender->udp_sock >= 0) {
+    close(sender->udp_sock);
+  }
+  if (sender->syn_sock >= 0) {
+    close(sender->syn_sock);
+  }
+  if (sender->urandom != NULL) {
+    fclose(sender->urandom);
+  }
+  arena_close(&sender->arena);
+  memset(sender, 0, sizeof(*sender));
+  sender->udp_sock = -1;
+  sender->syn_sock = -1;
+}
+
+// This function sends a train of low-entropy packets over UDP from the
+// sender's socket, connected to the destination address and port with the
+// TTL of the config, with a specified train size and inter-packet delay. If
+// txtime is enabled the spacing is left to the qdisc. markers (NULL for none)
+// are sent inside the train.
+void send_udp_low_entropy_packet_train(struct TrainSender *sender,
+                                       int train_size,
+                                       int inter_packet_delay_us,
+                                       struct TxTime *txtime,
+                                       struct TrainMarkers *markers) {
+  char *payload = sender->payload;
+  int payload_size = sender->payload_size;
+  int sock_fd = sender->udp_sock;
+  memset(payload, 0, payload_size);
+
+  clear_socket_error(sock_fd);
+  uint64_t start_ns = schedule_train_start(txtime, sock_fd);
+  for (int i = 0; i < train_size; i++) {
+    write_probe_header(payload, LOW_TRAIN_ID, i, 0);
+    send_marker(markers, i, inter_packet_delay_us, txtime, start_ns);
+    send_train_packet(sock_fd, payload, payload_size, i, train_size,
+                      inter_packet_delay_us, txtime, start_ns);
+  }
+}
+
+// This function sends a high-entropy packet train over UDP from the sender's
+// socket using random bytes read from its /dev/urandom stream. The number of
+// packets in the train and inter-packet delay can be specified as parameters.
+// If txtime is enabled the spacing is left to the qdisc. markers (NULL for
+// none) are sent inside the train.
+void send_udp_high_entropy_packet_train(struct TrainSender *sender,
+                                        int train_size,
+                                        int inter_packet_delay_us,
+                                        struct TxTime *txtime,
+                                        struct TrainMarkers *markers) {
+  char *payload = sender->payload;
+  int payload_size = sender->payload_size;
+  int sock_fd = sender->udp_sock;
+
+  clear_socket_error(sock_fd);
+  uint64_t start_ns = schedule_train_start(txtime, sock_fd);
   for (int i = 0; i < train_size; i++) {
-    uint16_t packet_id = htons(i);
-    memcpy(payload, &packet_id, sizeof(packet_id));
+    write_probe_header(payload, HIGH_TRAIN_ID, i, 0);
 
     // Fill the rest of the payload with random bytes from /dev/urandom
-    if (fread(payload + 2, 1, payload_size - 2, urandom) !=
-        (size_t)payload_size - 2) {
+    if (fread(payload + PROBE_HEADER_SIZE, 1, payload_size - PROBE_HEADER_SIZE,
+              sender->urandom) != (size_t)(payload_size - PROBE_HEADER_SIZE)) {
       perror("Error reading from /dev/urandom");
-      fclose(urandom);
-      close(sock_fd);
       return;
     }
 
-    send(sock_fd, payload, payload_size, 0);
-    // helps prevent packet loss although in this case we are not trying to
-    // read the udp packets in a server so we don't really need this
-    if (i < train_size - 1) {
-      usleep(inter_packet_delay_us);
-    }
+    // pacing helps prevent packet loss although in this case we are not
+    // trying to read the udp packets in a server so we don't really need this
+    send_marker(markers, i, inter_packet_delay_us, txtime, start_ns);
+    send_train_packet(sock_fd, payload, payload_size, i, train_size,
+                      inter_packet_delay_us, txtime, start_ns);
   }
-
-  fclose(urandom);
-  close(sock_fd);
 }
 
 // This function calculates the TCP checksum for a given buffer of unsigned
@@ -217,77 +405,246 @@ void build_tcp_syn_packet(char *packet, char *src_ip, char *dst_ip,
   tcph->check = tcp_checksum((uint16_t *)buf, sizeof(buf));
 }
 
-// This function listens for incoming RST packets on a raw socket and records
-// the timestamps of the received packets. It continues listening until it
-// receives a specified number of RST packets or a timeout is reached. If enough
-// RST packets are received, it calculates the time differences between the
-// first and second packet and the third and fourth packet, and compares them to
-// a threshold value. If the time difference is greater than the threshold, it
-// assumes that compression is being used. The function prints a message
-// indicating whether compression was detected or not. If not enough RST packets
-// are received, the function prints a message indicating that fact.
-void *listen_for_rst_packets(void *args) {
-  struct RstArgs *rst_args = (struct RstArgs *)args;
-  int rst_timeout_s = rst_args->rst_timeout_s;
-  int rst_packets = rst_args->rst_packets;
+// Publishes the outcome of a standalone measurement to config->result_ring,
+// if set. The deltas are the dispersions between the SYN markers (for an
+// interleaved measurement, the mean over the measured sub-trains).
+void publish_standalone(struct Config *config, int64_t started_ns,
+                        int verdict, int64_t delta_low_ns,
+                        int64_t delta_high_ns, int64_t threshold_ns,
+                        int train_size) {
+  if (config->result_ring == NULL) {
+    return;
+  }
+  struct ResultRecord record;
+  memset(&record, 0, sizeof(record));
+  record.config_hash = config_hash(config);
+  record.started_ns = started_ns;
+  record.finished_ns = ring_clock_ns();
+  record.delta_low_ns = delta_low_ns;
+  record.delta_high_ns = delta_high_ns;
+  record.threshold_ns = threshold_ns;
+  inet_pton(AF_INET, config->server_ip_addr, &record.peer_ip);
+  record.dst_port = config->dst_port_udp;
+  record.mode = RESULT_MODE_STANDALONE;
+  record.verdict = verdict;
+  record.train_size = train_size;
+  record.payload_size = config->payload_size;
+  ring_publish_once(config->result_ring, &record);
+}
+
+// Orders two paired differences
+static int compare_ll(const void *a, const void *b) {
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+// Sorts n values and returns their median
+static long long median_ll(long long *values, int n) {
+  qsort(values, n, sizeof(long long), compare_ll);
+  return n % 2 == 1 ? values[n / 2]
+                    : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
 
-  // Create raw socket
+// Returns 1 if any boundary of train t from first on had its RST
+static int seen_from(struct RstArgs *rst_args, int t, int first) {
+  for (int b = first; b < rst_args->markers + 2; b++) {
+    if (rst_args->seen[t][b]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Matches an RST to the train and boundary it answers. The head and tail
+// ports are shared by both trains: their RST belongs to the low train unless
+// that boundary or a later one of the low train (for the tail, any boundary
+// of the high train) already answered, so one lost RST does not shift the
+// others. Returns 0 if the RST answers no pending boundary.
+static int match_rst(struct RstArgs *rst_args, unsigned short port, int *t,
+                     int *b) {
+  int markers = rst_args->markers;
+  if (port == rst_args->head_port) {
+    *b = 0;
+    *t = seen_from(rst_args, 0, 0) ? 1 : 0;
+  } else if (port == rst_args->tail_port) {
+    *b = markers + 1;
+    *t = rst_args->seen[0][markers + 1] || seen_from(rst_args, 1, 0) ? 1 : 0;
+  } else if (port >= rst_args->first_marker_port &&
+             port < rst_args->first_marker_port + 2 * markers) {
+    int k = port - rst_args->first_marker_port;
+    *t = k / markers;
+    *b = k % markers + 1;
+  } else {
+    return 0;
+  }
+  return !rst_args->seen[*t][*b];
+}
+
+// Verdict of a train pair split by markers. Segment s of a train runs from
+// boundary s to boundary s + 1; each segment measured in both trains gives
+// one high - low sample, scaled to the whole train so that the fixed
+// THRESHOLD applies, and the verdict is their median. A slow or lost RST only
+// spoils the samples of its own segments.
+static void marker_verdict(struct RstArgs *rst_args) {
+  struct Config *config = rst_args->config;
+  int train_size = config->udp_train_size;
+  int interval = config->marker_interval;
+  int segments = rst_args->markers + 1;
+  long long diffs[MAX_TRAIN_MARKERS + 1];
+  double low_sum_ns = 0, high_sum_ns = 0;
+  int valid = 0;
+
+  for (int s = 0; s < segments; s++) {
+    if (!rst_args->seen[0][s] || !rst_args->seen[0][s + 1] ||
+        !rst_args->seen[1][s] || !rst_args->seen[1][s + 1]) {
+      continue;
+    }
+    int end = (s + 1) * interval < train_size ? (s + 1) * interval
+                                               : train_size;
+    double scale = (double)train_size / (end - s * interval);
+    double low = (rst_args->ts_ns[0][s + 1] - rst_args->ts_ns[0][s]) * scale;
+    double high = (rst_args->ts_ns[1][s + 1] - rst_args->ts_ns[1][s]) * scale;
+    diffs[valid++] = (long long)(high - low);
+    low_sum_ns += low;
+    high_sum_ns += high;
+  }
+
+  if (valid == 0) {
+    printf("[STANDALONE] Not enough RST packets received.\n");
+    publish_standalone(config, rst_args->started_ns, RESULT_FAILED, 0, 0,
+                       THRESHOLD, train_size);
+    return;
+  }
+  long long median_ns = median_ll(diffs, valid);
+  int to_ms = 1000000;
+  logger("[STANDALONE] %d/%d segments measured, median delta_diff = %.2f ms "
+         "(min %.2f ms, max %.2f ms), scaled to the whole train",
+         valid, segments, (double)median_ns / to_ms,
+         (double)diffs[0] / to_ms, (double)diffs[valid - 1] / to_ms);
+  if (median_ns > THRESHOLD) {
+    printf("[STANDALONE] Compression detected!\n");
+  } else {
+    printf("[STANDALONE] No compression was detected.\n");
+  }
+  publish_standalone(config, rst_args->started_ns,
+                     median_ns > THRESHOLD ? RESULT_COMPRESSION : RESULT_NONE,
+                     (int64_t)(low_sum_ns / valid),
+                     (int64_t)(high_sum_ns / valid), THRESHOLD, train_size);
+}
+
+// Waits up to timeout_us for a packet on the raw socket of an RST listener:
+// in select or, with busy_poll_us set, spinning on the socket so that the RST
+// is timestamped without a wakeup. Returns as select does.
+static int wait_for_rst(struct Config *config, int sock, long timeout_us) {
+  if (config->busy_poll_us > 0) {
+    return spin_readable(sock, timeout_us * 1000LL);
+  }
+  fd_set read_fds;
+  FD_ZERO(&read_fds);
+  FD_SET(sock, &read_fds);
+  struct timeval timeout = {.tv_sec = timeout_us / 1000000,
+                            .tv_usec = timeout_us % 1000000};
+  return select(sock + 1, &read_fds, NULL, NULL, &timeout);
+}
+
+// Opens the raw socket an RST listener receives on, prepared for spinning
+// with busy_poll_us set. Returns the socket or CD_ERR_SOCKET.
+static int open_rst_socket(struct Config *config) {
   int sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
   if (sock < 0) {
     perror("socket");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
+  }
+  if (config->busy_poll_us > 0) {
+    enable_busy_poll(sock, config->busy_poll_us);
   }
+  return sock;
+}
+
+// This function listens for incoming RST packets on a raw socket and records
+// the timestamps of the received packets, matching each RST to the SYN it
+// answers. It continues listening until every SYN was answered or a timeout
+// is reached. Without markers, it calculates the time differences between
+// the head and tail RST of the low train and of the high train, and compares
+// their difference to a threshold value; if it is greater, it assumes that
+// compression is being used. With markers, the verdict comes from the
+// segments between them (see marker_verdict). The function prints a message
+// indicating whether compression was detected or not. If not enough RST
+// packets are received, the function prints a message indicating that fact.
+void *listen_for_rst_packets(void *args) {
+  struct RstArgs *rst_args = (struct RstArgs *)args;
+  int rst_timeout_s = rst_args->rst_timeout_s;
+  int rst_packets = 2 * (rst_args->markers + 2);
+  struct Config *config = rst_args->config;
+  struct PerfCounters counters;
+  struct PerfSample perf;
+
+  apply_realtime_profile(config, config->rt_rst_cpu, RT_ROLE_RST);
+  perf_open(&counters, config->perf);
+  perf_sample_init(&perf);
+
+  int sock = rst_args->sock;
 
   // Listen for incoming packets
-  char buf[65535]; // 2**16 - 1
+  char *buf = rst_args->buf;
   int packets_received = 0;
-  struct timespec timestamps[rst_packets];
 
+  perf_start(&counters);
   while (packets_received < rst_packets) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(sock, &read_fds);
-    struct timeval timeout;
-    timeout.tv_sec = rst_timeout_s;
-    timeout.tv_usec = 0;
-
-    int ready_fds = select(sock + 1, &read_fds, NULL, NULL, &timeout);
+    int ready_fds = wait_for_rst(config, sock, rst_timeout_s * 1000000L);
     if (ready_fds < 0) {
       perror("[STANDALONE] Listening to RST select");
-      exit(EXIT_FAILURE);
+      rst_args->error = CD_ERR_SOCKET;
+      break;
     } else if (ready_fds == 0) {
       printf("[STANDALONE] [ERROR] Timeout reached, stopping the listener.\n");
       break;
     }
 
-    memset(buf, 0, sizeof(buf));
+    memset(buf, 0, PACKET_BUFFER_SIZE);
     struct sockaddr_in src_addr;
     socklen_t src_addr_len = sizeof(src_addr);
-    int num_bytes = recvfrom(sock, buf, sizeof(buf), 0,
+    int num_bytes = recvfrom(sock, buf, PACKET_BUFFER_SIZE, 0,
                              (struct sockaddr *)&src_addr, &src_addr_len);
     if (num_bytes < 0) {
       perror("recvfrom");
-      exit(EXIT_FAILURE);
+      rst_args->error = CD_ERR_SOCKET;
+      break;
     }
+    long long ts_ns = tsc_now_ns();
 
-    // Check for RST packet
+    // Check for RST packet answering one of our SYNs
     struct iphdr *iph = (struct iphdr *)buf;
     struct tcphdr *tcph = (struct tcphdr *)(buf + sizeof(struct iphdr));
-    if (iph->protocol == IPPROTO_TCP && tcph->rst) {
+    int t, b;
+    if (iph->protocol == IPPROTO_TCP && tcph->rst &&
+        match_rst(rst_args, ntohs(tcph->source), &t, &b)) {
       logger("[STANDALONE] Received RST packet from %s:%u",
              inet_ntoa(src_addr.sin_addr), ntohs(tcph->source));
 
-      clock_gettime(CLOCK_MONOTONIC, &timestamps[packets_received]);
+      rst_args->ts_ns[t][b] = ts_ns;
+      rst_args->seen[t][b] = 1;
       packets_received++;
     }
   }
+  perf_stop(&counters, &perf);
+  perf_close(&counters);
+  if (config->perf) {
+    perf_report("RST listener", &perf, packets_received);
+  }
+  if (rst_args->error != CD_OK) {
+    return NULL;
+  }
 
-  if (packets_received == rst_packets) {
-    // Calculate delta time when all RST packets have been received
-    double delta_low = (timestamps[1].tv_sec - timestamps[0].tv_sec) * 1e9 +
-                       (timestamps[1].tv_nsec - timestamps[0].tv_nsec);
-    double delta_high = (timestamps[3].tv_sec - timestamps[2].tv_sec) * 1e9 +
-                        (timestamps[3].tv_nsec - timestamps[2].tv_nsec);
+  int tail = rst_args->markers + 1;
+  if (rst_args->seen[0][0] && rst_args->seen[0][tail] && rst_args->seen[1][0] &&
+      rst_args->seen[1][tail]) {
+    // Calculate delta time when the head and tail RSTs have been received
+    double delta_low =
+        (double)(rst_args->ts_ns[0][tail] - rst_args->ts_ns[0][0]);
+    double delta_high =
+        (double)(rst_args->ts_ns[1][tail] - rst_args->ts_ns[1][0]);
     double delta_diff = delta_high - delta_low;
 
     int to_ms = 1000000;
@@ -295,45 +652,42 @@ void *listen_for_rst_packets(void *args) {
     logger("[STANDALONE] delta_high = %.2f ms", delta_high / to_ms);
     logger("[STANDALONE] delta_diff = %.2f ms", delta_diff / to_ms);
 
-    if (delta_diff > THRESHOLD) {
-      printf("[STANDALONE] Compression detected!\n");
-    } else {
-      printf("[STANDALONE] No compression was detected.\n");
+    if (rst_args->markers == 0) {
+      if (delta_diff > THRESHOLD) {
+        printf("[STANDALONE] Compression detected!\n");
+      } else {
+        printf("[STANDALONE] No compression was detected.\n");
+      }
+      publish_standalone(config, rst_args->started_ns,
+                         delta_diff > THRESHOLD ? RESULT_COMPRESSION
+                                                : RESULT_NONE,
+                         (int64_t)delta_low, (int64_t)delta_high, THRESHOLD,
+                         config->udp_train_size);
     }
-  } else {
+  } else if (rst_args->markers == 0) {
     printf("[STANDALONE] Not enough RST packets received.\n");
+    publish_standalone(config, rst_args->started_ns, RESULT_FAILED, 0, 0,
+                       THRESHOLD, config->udp_train_size);
+  }
+  if (rst_args->markers > 0) {
+    marker_verdict(rst_args);
   }
-
-  // Close socket
-  close(sock);
   return NULL;
 }
 
 // Sends a TCP SYN packet to initiate a TCP connection with a destination host.
-// The function creates a raw socket and sets the IP_HDRINCL option to specify
-// that the IP header will be included in the packet data. Then it builds a TCP
-// SYN packet using the build_tcp_syn_packet function and sets the destination
-// address. Finally, it sends the packet using sendto function and closes the
-// socket. The parameters of the function include the source and destination IP
+// The function builds a TCP SYN packet using the build_tcp_syn_packet function
+// and sets the destination address. Finally, it sends the packet with sendto
+// on sock, the raw socket (with IP_HDRINCL set) opened by open_train_sender.
+// The parameters of the function include the source and destination IP
 // addresses and port numbers, as well as the TTL value for the packet.
-void send_tcp_syn_packet(char *src_ip, char *dst_ip, unsigned short src_port,
-                         unsigned short dst_port, int ttl) {
-  // Create raw socket
-  int sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
-  if (sock < 0) {
-    perror("socket");
-    exit(EXIT_FAILURE);
-  }
-
-  // Set socket options
-  int optval = 1;
-  if (setsockopt(sock, IPPROTO_IP, IP_HDRINCL, &optval, sizeof(optval)) < 0) {
-    perror("setsockopt");
-    exit(EXIT_FAILURE);
-  }
-
-  // Build TCP SYN packet
-  char packet[65535];
+// Returns CD_OK or CD_ERR_SOCKET; a SYN that was not sent shows up as a
+// missing RST.
+int send_tcp_syn_packet(int sock, char *src_ip, char *dst_ip,
+                        unsigned short src_port, unsigned short dst_port,
+                        int ttl) {
+  // Build TCP SYN packet (headers only)
+  char packet[sizeof(struct iphdr) + sizeof(struct tcphdr)];
   memset(packet, 0, sizeof(packet));
   build_tcp_syn_packet(packet, src_ip, dst_ip, src_port, dst_port, ttl);
 
@@ -344,16 +698,270 @@ void send_tcp_syn_packet(char *src_ip, char *dst_ip, unsigned short src_port,
   dest_addr.sin_port = htons(dst_port);
 
   // Send TCP SYN packet
-  int num_bytes =
-      sendto(sock, packet, sizeof(struct iphdr) + sizeof(struct tcphdr), 0,
-             (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+  int num_bytes = sendto(sock, packet, sizeof(packet), 0,
+                         (struct sockaddr *)&dest_addr, sizeof(dest_addr));
   if (num_bytes < 0) {
     perror("sendto");
-    exit(EXIT_FAILURE);
+    return CD_ERR_SOCKET;
+  }
+  return CD_OK;
+}
+
+// Listener of an interleaved measurement. It records the arrival of the RST
+// answering each SYN marker, matched by the RST source port, until the sender
+// sets done or its socket fails.
+void *listen_for_marker_rsts(void *args) {
+  struct MarkerArgs *markers = (struct MarkerArgs *)args;
+  struct Config *config = markers->config;
+  char *buf = markers->buf;
+
+  apply_realtime_profile(config, config->rt_rst_cpu, RT_ROLE_RST);
+
+  for (;;) {
+    pthread_mutex_lock(&markers->lock);
+    int done = markers->done;
+    pthread_mutex_unlock(&markers->lock);
+    if (done) {
+      break;
+    }
+
+    int ready_fds = wait_for_rst(config, markers->sock, 100000);
+    if (ready_fds < 0) {
+      perror("[STANDALONE] Listening to RST select");
+      pthread_mutex_lock(&markers->lock);
+      markers->error = CD_ERR_SOCKET;
+      pthread_cond_broadcast(&markers->cond);
+      pthread_mutex_unlock(&markers->lock);
+      break;
+    } else if (ready_fds == 0) {
+      continue;
+    }
+
+    int num_bytes = recv(markers->sock, buf, PACKET_BUFFER_SIZE, 0);
+    long long ts_ns = tsc_now_ns();
+    if (num_bytes < (int)(sizeof(struct iphdr) + sizeof(struct tcphdr))) {
+      continue;
+    }
+    struct iphdr *iph = (struct iphdr *)buf;
+    struct tcphdr *tcph = (struct tcphdr *)(buf + iph->ihl * 4);
+    if (iph->protocol != IPPROTO_TCP || !tcph->rst) {
+      continue;
+    }
+
+    unsigned short port = ntohs(tcph->source);
+    pthread_mutex_lock(&markers->lock);
+    for (int j = 0; j < markers->sub_trains; j++) {
+      if (port == markers->head_port[j] && !markers->head_seen[j]) {
+        markers->head_ns[j] = ts_ns;
+        markers->head_seen[j] = 1;
+      } else if (port == markers->tail_port[j] && !markers->tail_seen[j]) {
+        markers->tail_ns[j] = ts_ns;
+        markers->tail_seen[j] = 1;
+      }
+    }
+    pthread_cond_broadcast(&markers->cond);
+    pthread_mutex_unlock(&markers->lock);
+  }
+  return NULL;
+}
+
+// Waits until both RSTs of sub-train j arrived or timeout_s passed. Returns
+// the dispersion of the sub-train in ns, or -1 if an RST is missing.
+static long long wait_for_markers(struct MarkerArgs *markers, int j,
+                                  int timeout_s) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_s;
+
+  long long dispersion_ns = -1;
+  pthread_mutex_lock(&markers->lock);
+  while (!(markers->head_seen[j] && markers->tail_seen[j]) &&
+         markers->error == CD_OK) {
+    if (pthread_cond_timedwait(&markers->cond, &markers->lock, &deadline) ==
+        ETIMEDOUT) {
+      break;
+    }
+  }
+  if (markers->head_seen[j] && markers->tail_seen[j]) {
+    dispersion_ns = markers->tail_ns[j] - markers->head_ns[j];
+  }
+  pthread_mutex_unlock(&markers->lock);
+  return dispersion_ns;
+}
+
+// Interleaved variant of the standalone measurement. Instead of one long low
+// train, a pause and one long high train, interleave_pairs pairs of short low
+// and high sub-trains are sent back to back, alternating which entropy goes
+// first (low-high, high-low, ...) so that slow drifts of the path cancel out.
+// Sub-train j is bracketed by SYNs to its own port pair (dst_port_tcp_hsyn +
+// j * stride, dst_port_tcp_tsyn + j * stride), so the RSTs of every sub-train
+// can be told apart. The sender waits for the tail RST of each sub-train and
+// then for a gap of at least interleave_gap_ms, extended by the time the
+// sub-train spent queued on the path (its dispersion minus its send time), so
+// that cross traffic and the previous sub-train have drained before the next
+// one. The verdict is the median of the per-pair differences high - low
+// against THRESHOLD scaled to the sub-train size. Returns CD_OK or an error
+// code.
+int run_interleaved(struct Config *config, struct TrainSender *sender,
+                    struct TxTime *txtime, int64_t started_ns) {
+  char *src_ip = "127.0.0.1";
+  char *dst_ip = config->server_ip_addr;
+  int src_port = config->pp_port_tcp;
+  int ttl = config->udp_ttl;
+  int pairs = config->interleave_pairs;
+  int sub_trains = 2 * pairs;
+  int sub_train_size = config->sub_train_size;
+  int stride = abs(config->dst_port_tcp_tsyn - config->dst_port_tcp_hsyn) + 1;
+  pthread_t rst_thread;
+
+  if (sub_trains > MAX_SUB_TRAINS) {
+    printf("[STANDALONE] [ERROR] interleave_pairs is at most %d.\n",
+           MAX_SUB_TRAINS / 2);
+    return CD_ERR_CONFIG;
+  }
+  int first_port = config->dst_port_tcp_hsyn < config->dst_port_tcp_tsyn
+                       ? config->dst_port_tcp_hsyn
+                       : config->dst_port_tcp_tsyn;
+  if (check_port_range("[STANDALONE]", "The sub-train SYNs", first_port,
+                       first_port + (long)sub_trains * stride - 1) != CD_OK) {
+    return CD_ERR_CONFIG;
+  }
+  struct MarkerArgs *markers = arena_alloc(&sender->arena, sizeof(*markers));
+  if (markers == NULL) {
+    return CD_ERR_RESOURCE;
+  }
+
+  markers->sub_trains = sub_trains;
+  markers->buf = sender->listen_buf;
+  markers->config = config;
+  pthread_mutex_init(&markers->lock, NULL);
+  pthread_cond_init(&markers->cond, NULL);
+  for (int j = 0; j < sub_trains; j++) {
+    markers->head_port[j] = config->dst_port_tcp_hsyn + j * stride;
+    markers->tail_port[j] = config->dst_port_tcp_tsyn + j * stride;
+  }
+
+  // The raw socket is opened before the first SYN leaves so no RST is missed
+  markers->sock = open_rst_socket(config);
+  if (markers->sock < 0) {
+    pthread_mutex_destroy(&markers->lock);
+    pthread_cond_destroy(&markers->cond);
+    return CD_ERR_SOCKET;
+  }
+  if (pthread_create(&rst_thread, NULL, listen_for_marker_rsts, markers) !=
+      0) {
+    perror("pthread_create");
+    close(markers->sock);
+    pthread_mutex_destroy(&markers->lock);
+    pthread_cond_destroy(&markers->cond);
+    return CD_ERR_RESOURCE;
+  }
+  apply_realtime_profile(config, config->rt_sender_cpu, RT_ROLE_SENDER);
+
+  long long dispersion_ns[MAX_SUB_TRAINS];
+  for (int j = 0; j < sub_trains; j++) {
+    pthread_mutex_lock(&markers->lock);
+    int failed = markers->error != CD_OK;
+    pthread_mutex_unlock(&markers->lock);
+    if (failed) {
+      break; // the listener is gone
+    }
+    int pair = j / 2;
+    // low first in even pairs, high first in odd ones
+    int high = (j % 2) != (pair % 2);
+    long long start_ns = tsc_now_ns();
+    send_tcp_syn_packet(sender->syn_sock, src_ip, dst_ip, src_port,
+                        markers->head_port[j], ttl);
+    if (high) {
+      send_udp_high_entropy_packet_train(sender, sub_train_size,
+                                         config->inter_packet_delay_us, txtime,
+                                         NULL);
+    } else {
+      send_udp_low_entropy_packet_train(sender, sub_train_size,
+                                        config->inter_packet_delay_us, txtime,
+                                        NULL);
+    }
+    send_tcp_syn_packet(sender->syn_sock, src_ip, dst_ip, src_port,
+                        markers->tail_port[j], ttl);
+    long long end_ns = tsc_now_ns();
+
+    dispersion_ns[j] = wait_for_markers(markers, j, config->rst_timeout_s);
+    if (dispersion_ns[j] < 0) {
+      printf("[STANDALONE] [ERROR] Missing RST for sub-train %d (ports %d, "
+             "%d).\n",
+             j, markers->head_port[j], markers->tail_port[j]);
+      continue;
+    }
+    long long send_ns = end_ns - start_ns;
+    long gap_us = config->interleave_gap_ms * 1000L;
+    long queued_us = (long)((dispersion_ns[j] - send_ns) / 1000);
+    if (queued_us > gap_us) {
+      gap_us = queued_us < MAX_INTERLEAVE_GAP_US ? queued_us
+                                                 : MAX_INTERLEAVE_GAP_US;
+    }
+    logger("[STANDALONE] Sub-train %d (%s entropy): dispersion %.2f ms, sent "
+           "in %.2f ms, next gap %.2f ms",
+           j, high ? "high" : "low", dispersion_ns[j] / 1e6, send_ns / 1e6,
+           gap_us / 1e3);
+    if (j < sub_trains - 1) {
+      usleep(gap_us);
+    }
+  }
+
+  pthread_mutex_lock(&markers->lock);
+  markers->done = 1;
+  pthread_mutex_unlock(&markers->lock);
+  pthread_join(rst_thread, NULL);
+  close(markers->sock);
+
+  // Paired differences high - low
+  long long diffs[MAX_SUB_TRAINS / 2];
+  long long low_sum_ns = 0, high_sum_ns = 0;
+  int valid = 0;
+  for (int pair = 0; pair < pairs; pair++) {
+    int low = pair % 2 == 0 ? 2 * pair : 2 * pair + 1;
+    int high = pair % 2 == 0 ? 2 * pair + 1 : 2 * pair;
+    if (dispersion_ns[low] >= 0 && dispersion_ns[high] >= 0) {
+      diffs[valid++] = dispersion_ns[high] - dispersion_ns[low];
+      low_sum_ns += dispersion_ns[low];
+      high_sum_ns += dispersion_ns[high];
+    }
   }
+  int error = markers->error;
+  pthread_mutex_destroy(&markers->lock);
+  pthread_cond_destroy(&markers->cond);
 
-  // Close socket
-  close(sock);
+  if (error != CD_OK) {
+    return error;
+  }
+  if (valid == 0) {
+    printf("[STANDALONE] Not enough RST packets received.\n");
+    publish_standalone(config, started_ns, RESULT_FAILED, 0, 0, THRESHOLD,
+                       sub_train_size);
+    return CD_OK;
+  }
+  long long median_ns = median_ll(diffs, valid);
+  double threshold_ns = config->udp_train_size > 0
+                            ? (double)THRESHOLD * sub_train_size /
+                                  config->udp_train_size
+                            : THRESHOLD;
+
+  int to_ms = 1000000;
+  logger("[STANDALONE] %d/%d pairs measured, median delta_diff = %.2f ms "
+         "(min %.2f ms, max %.2f ms), threshold %.2f ms",
+         valid, pairs, (double)median_ns / to_ms, (double)diffs[0] / to_ms,
+         (double)diffs[valid - 1] / to_ms, threshold_ns / to_ms);
+  if (median_ns > threshold_ns) {
+    printf("[STANDALONE] Compression detected!\n");
+  } else {
+    printf("[STANDALONE] No compression was detected.\n");
+  }
+  publish_standalone(config, started_ns,
+                     median_ns > threshold_ns ? RESULT_COMPRESSION
+                                              : RESULT_NONE,
+                     low_sum_ns / valid, high_sum_ns / valid,
+                     (int64_t)threshold_ns, sub_train_size);
+  return CD_OK;
 }
 
 // The run_standalone function is the main function that sends packets and
@@ -361,45 +969,137 @@ void send_tcp_syn_packet(char *src_ip, char *dst_ip, unsigned short src_port,
 // of packets, including a TCP SYN packet to two different ports, followed by a
 // train of low or high entropy UDP packets, and then another TCP SYN packet to
 // the second port. It also starts a thread to listen for RST packets and waits
-// for it to finish.
-void run_standalone(struct Config *config) {
+// for it to finish. With marker_interval set, extra SYNs to their own ports
+// are sent inside each train. With hop_ttl_max or interleave_pairs set,
+// run_hop_sweep or run_interleaved is used instead. Returns CD_OK or an error
+// code.
+int run_standalone(struct Config *config) {
   int src_port = config->pp_port_tcp;
   char *src_ip = "127.0.0.1";
   char *dst_ip = config->server_ip_addr;
   int port_x = config->dst_port_tcp_hsyn;
   int port_y = config->dst_port_tcp_tsyn;
-  int udp_dst_port = config->dst_port_udp;
   int train_size = config->udp_train_size;
   int payload_size = config->payload_size;
   int ttl = config->udp_ttl;
   int rst_timeout_s = config->rst_timeout_s;
-  int inter_packet_delay_us = 300;
+  int inter_packet_delay_us = config->inter_packet_delay_us;
   struct RstArgs rst_args;
   pthread_t rst_thread;
+  struct TxTime txtime = {0};
+  int64_t started_ns = ring_clock_ns();
+  tsc_init_once(config->tsc);
+
+  if (payload_size < PROBE_HEADER_SIZE) {
+    printf("payload_size must be at least %d bytes.\n", PROBE_HEADER_SIZE);
+    return CD_ERR_CONFIG;
+  }
+
+  if (check_port_range("[STANDALONE]", "dst_port_tcp_hsyn", port_x, port_x) !=
+          CD_OK ||
+      check_port_range("[STANDALONE]", "dst_port_tcp_tsyn", port_y, port_y) !=
+          CD_OK) {
+    return CD_ERR_CONFIG;
+  }
 
+  memset(&rst_args, 0, sizeof(rst_args));
   rst_args.rst_timeout_s = rst_timeout_s;
-  rst_args.rst_packets = 4;
+  rst_args.head_port = port_x;
+  rst_args.tail_port = port_y;
+  rst_args.config = config;
+  rst_args.started_ns = started_ns;
 
-  // Start listening thread for RST packets
+  // Intra-train markers, one every marker_interval packets after the head
+  struct TrainMarkers markers = {src_ip, dst_ip, src_port, ttl, 0, 0, -1};
+  if (config->marker_interval > 0 && config->interleave_pairs == 0) {
+    rst_args.markers = (train_size - 1) / config->marker_interval;
+    if (rst_args.markers > MAX_TRAIN_MARKERS) {
+      printf("[STANDALONE] [ERROR] marker_interval gives %d markers per "
+             "train, at most %d are supported.\n",
+             rst_args.markers, MAX_TRAIN_MARKERS);
+      return CD_ERR_CONFIG;
+    }
+    long first_port =
+        config->marker_port_base > 0 ? config->marker_port_base : port_y + 1;
+    if (check_port_range("[STANDALONE]", "The SYN markers", first_port,
+                         first_port + 2L * rst_args.markers - 1) != CD_OK) {
+      return CD_ERR_CONFIG;
+    }
+    rst_args.first_marker_port = first_port;
+    markers.interval = config->marker_interval;
+    logger("[STANDALONE] %d SYN markers per train, ports %d-%d",
+           rst_args.markers, rst_args.first_marker_port,
+           rst_args.first_marker_port + 2 * rst_args.markers - 1);
+  }
+
+  // Kernel pacing (one packet per send: the standalone trains are not batched)
+  if (config->txtime) {
+    txtime_init(&txtime, dst_ip, 1);
+  }
+
+  // Every socket and buffer of the trains is set up and primed first
+  struct TrainSender sender;
+  int error = open_train_sender(config,
+                                config->interleave_pairs > 0
+                                    ? config->sub_train_size
+                                    : train_size,
+                                &sender);
+  if (error != CD_OK) {
+    return error;
+  }
+  markers.sock = sender.syn_sock;
+  rst_args.buf = sender.listen_buf;
+  if (config->hop_ttl_max > 0) {
+    error = run_hop_sweep(config, &sender, &txtime, started_ns);
+    close_train_sender(&sender);
+    return error;
+  }
+  if (config->interleave_pairs > 0) {
+    error = run_interleaved(config, &sender, &txtime, started_ns);
+    close_train_sender(&sender);
+    return error;
+  }
+
+  // Start listening thread for RST packets, on a raw socket opened before the
+  // first SYN leaves
+  rst_args.sock = open_rst_socket(config);
+  if (rst_args.sock < 0) {
+    close_train_sender(&sender);
+    return CD_ERR_SOCKET;
+  }
   if (pthread_create(&rst_thread, NULL, listen_for_rst_packets, &rst_args) !=
       0) {
     perror("pthread_create");
-    exit(EXIT_FAILURE);
+    close(rst_args.sock);
+    close_train_sender(&sender);
+    return CD_ERR_RESOURCE;
   }
 
+  apply_realtime_profile(config, config->rt_sender_cpu, RT_ROLE_SENDER);
+  struct PerfCounters counters;
+  struct PerfSample perf;
+  perf_open(&counters, config->perf);
   usleep(1000); // give some buffer time
 
   // - Send TCP SYN packet to port x
   // - Send train of udp low entropy packets
   // - Send TCP SYN packet to port y
   logger("[STANDALONE] Sending SYN packet to port_x %d", port_x);
-  send_tcp_syn_packet(src_ip, dst_ip, src_port, port_x, ttl);
+  send_tcp_syn_packet(sender.syn_sock, src_ip, dst_ip, src_port, port_x, ttl);
   logger("[STANDALONE] Sending low entropy UDP packet train");
-  send_udp_low_entropy_packet_train(dst_ip, udp_dst_port, ttl, train_size,
-                                    payload_size, inter_packet_delay_us);
+  markers.first_port = rst_args.first_marker_port;
+  perf_sample_init(&perf);
+  perf_start(&counters);
+  send_udp_low_entropy_packet_train(&sender, train_size, inter_packet_delay_us,
+                                    &txtime, &markers);
+  perf_stop(&counters, &perf);
   logger("[STANDALONE] Low entropy UDP packet train sent");
   logger("[STANDALONE] Sending SYN packet to port_y %d", port_y);
-  send_tcp_syn_packet(src_ip, dst_ip, src_port, port_y, ttl);
+  send_tcp_syn_packet(sender.syn_sock, src_ip, dst_ip, src_port, port_y, ttl);
+  // reported once the tail SYN is out, so it does not widen the dispersion
+  if (config->perf) {
+    perf_report("low-entropy send", &perf, train_size);
+  }
 
   logger("[STANDALONE] Waiting time between packet trains...");
   sleep(5);
@@ -408,17 +1108,26 @@ void run_standalone(struct Config *config) {
   // - Send train of udp low entropy packets
   // - Send TCP SYN packet to port y
   logger("[STANDALONE] Sending SYN packet to port_x %d", port_x);
-  send_tcp_syn_packet(src_ip, dst_ip, src_port, port_x, ttl);
+  send_tcp_syn_packet(sender.syn_sock, src_ip, dst_ip, src_port, port_x, ttl);
   logger("[STANDALONE] Sending high entropy UDP packet train");
-  send_udp_high_entropy_packet_train(dst_ip, udp_dst_port, ttl, train_size,
-                                     payload_size, inter_packet_delay_us);
+  markers.first_port = rst_args.first_marker_port + rst_args.markers;
+  perf_sample_init(&perf);
+  perf_start(&counters);
+  send_udp_high_entropy_packet_train(&sender, train_size,
+                                     inter_packet_delay_us, &txtime,
+                                     &markers);
+  perf_stop(&counters, &perf);
+  perf_close(&counters);
   logger("[STANDALONE] High entropy UDP packet train sent");
   logger("[STANDALONE] Sending SYN packet to port_y %d", port_y);
-  send_tcp_syn_packet(src_ip, dst_ip, src_port, port_y, ttl);
+  send_tcp_syn_packet(sender.syn_sock, src_ip, dst_ip, src_port, port_y, ttl);
+  if (config->perf) {
+    perf_report("high-entropy send", &perf, train_size);
+  }
 
   // Wait for listening thread to finish
-  if (pthread_join(rst_thread, NULL) != 0) {
-    perror("[STANDALONE] [ERROR] pthread_join first batch");
-    exit(EXIT_FAILURE);
-  }
+  pthread_join(rst_thread, NULL);
+  close(rst_args.sock);
+  close_train_sender(&sender);
+  return rst_args.error;
 }
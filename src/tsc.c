@@ -0,0 +1,130 @@
+#include "../include/tsc.h"
+#include "../include/logger.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+struct TscClock tsc_clock = {0};
+
+// Current time of a clock in ns
+static long long clock_ns(clockid_t clockid) {
+  struct timespec now;
+  clock_gettime(clockid, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#if defined(__x86_64__)
+// Returns non-zero if CPUID reports an invariant TSC (constant rate in every
+// P-, C- and T-state)
+static int tsc_invariant(void) {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+  return (edx >> 8) & 1;
+}
+
+// Reads a clock and the TSC at (nearly) the same instant: the TSC is read on
+// both sides of clock_gettime and the midpoint is taken. The tightest of
+// TSC_SAMPLE_TRIES reads is kept, so a preemption in between (frequent in
+// VMs) does not skew the calibration.
+static void sample(clockid_t clockid, uint64_t *tsc, long long *ns) {
+  unsigned int aux;
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < TSC_SAMPLE_TRIES; i++) {
+    uint64_t before = __rdtscp(&aux);
+    long long now = clock_ns(clockid);
+    uint64_t after = __rdtscp(&aux);
+    if (after - before < best) {
+      best = after - before;
+      *tsc = before + (after - before) / 2;
+      *ns = now;
+    }
+  }
+}
+
+// TSC ticks per ns over one calibration window
+static double measure_rate(void) {
+  uint64_t tsc_start, tsc_end;
+  long long ns_start, ns_end;
+  struct timespec window = {0, TSC_CALIBRATION_MS * 1000000L};
+  sample(CLOCK_MONOTONIC_RAW, &tsc_start, &ns_start);
+  nanosleep(&window, NULL);
+  sample(CLOCK_MONOTONIC_RAW, &tsc_end, &ns_end);
+  return (double)(tsc_end - tsc_start) / (ns_end - ns_start);
+}
+
+// Logs the cost of a timestamp with the TSC and with clock_gettime
+static void log_stamp_cost(void) {
+  const int stamps = 100000;
+  volatile long long stamp;
+  long long start = clock_ns(CLOCK_MONOTONIC);
+  for (int i = 0; i < stamps; i++) {
+    stamp = tsc_now_ns();
+  }
+  long long tsc_ns = clock_ns(CLOCK_MONOTONIC) - start;
+  start = clock_ns(CLOCK_MONOTONIC);
+  for (int i = 0; i < stamps; i++) {
+    stamp = clock_ns(CLOCK_MONOTONIC);
+  }
+  (void)stamp;
+  long long clock_gettime_ns = clock_ns(CLOCK_MONOTONIC) - start;
+  logger("[TSC] %.1f ns per stamp (clock_gettime: %.1f ns)",
+         (double)tsc_ns / stamps, (double)clock_gettime_ns / stamps);
+}
+#endif
+
+// Picks the timestamp source
+int tsc_init(int use_tsc) {
+  tsc_clock.enabled = 0;
+  if (!use_tsc) {
+    logger("[TSC] Disabled, timestamps use clock_gettime");
+    return 0;
+  }
+#if defined(__x86_64__)
+  if (!tsc_invariant()) {
+    logger("[TSC] TSC is not invariant, timestamps use clock_gettime");
+    return 0;
+  }
+  double rate = measure_rate();
+  double check = measure_rate();
+  double skew_ppm = fabs(check - rate) / rate * 1e6;
+  if (skew_ppm > TSC_MAX_SKEW_PPM) {
+    logger("[TSC] TSC rate unstable (%.0f ppm between calibrations), "
+           "timestamps use clock_gettime",
+           skew_ppm);
+    return 0;
+  }
+  rate = (rate + check) / 2;
+
+  // align the TSC with CLOCK_MONOTONIC, which timerfds and the other
+  // timestamps of the program use
+  sample(CLOCK_MONOTONIC, &tsc_clock.base_tsc, &tsc_clock.base_ns);
+  tsc_clock.mult = (uint64_t)((1ULL << 32) / rate);
+  tsc_clock.enabled = 1;
+  logger("[TSC] Invariant TSC at %.3f GHz (%.0f ppm between calibrations)",
+         rate, skew_ppm);
+  log_stamp_cost();
+  return 1;
+#else
+  logger("[TSC] No TSC on this architecture, timestamps use clock_gettime");
+  return 0;
+#endif
+}
+
+// Picks the timestamp source on the first call only
+int tsc_init_once(int use_tsc) {
+  static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  static int initialized = 0;
+  pthread_mutex_lock(&lock);
+  if (!initialized) {
+    tsc_init(use_tsc);
+    initialized = 1;
+  }
+  int enabled = tsc_clock.enabled;
+  pthread_mutex_unlock(&lock);
+  return enabled;
+}
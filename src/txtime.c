@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include "../include/txtime.h"
+#include "../include/logger.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#include <netinet/udp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Finds the name and index of the interface packets to dst_ip leave through,
+// by letting the kernel pick the source address of a connected UDP socket and
+// looking up which interface owns it
+static int egress_interface(const char *dst_ip, char *ifname) {
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(9); // discard, nothing is sent
+  if (inet_pton(AF_INET, dst_ip, &addr.sin_addr) <= 0) {
+    return -1;
+  }
+
+  int sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock_fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in local = {0};
+  socklen_t len = sizeof(local);
+  if (connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      getsockname(sock_fd, (struct sockaddr *)&local, &len) < 0) {
+    close(sock_fd);
+    return -1;
+  }
+  close(sock_fd);
+
+  struct ifaddrs *ifaddr;
+  if (getifaddrs(&ifaddr) < 0) {
+    return -1;
+  }
+  int ifindex = -1;
+  for (struct ifaddrs *ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_INET) {
+      continue;
+    }
+    struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
+    if (sin->sin_addr.s_addr == local.sin_addr.s_addr) {
+      snprintf(ifname, IF_NAMESIZE, "%s", ifa->ifa_name);
+      ifindex = (int)if_nametoindex(ifa->ifa_name);
+      break;
+    }
+  }
+  freeifaddrs(ifaddr);
+  return ifindex;
+}
+
+// Dumps the qdiscs through rtnetlink and copies into qdisc the kind of the
+// first fq/etf qdisc attached to ifindex, or of its root qdisc if there is
+// none. Returns 1 if an fq/etf qdisc was found, 0 if not and -1 on error.
+static int find_pacing_qdisc(int ifindex, char *qdisc, size_t qdisc_len) {
+  int nl_fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (nl_fd < 0) {
+    return -1;
+  }
+
+  struct {
+    struct nlmsghdr nh;
+    struct tcmsg tc;
+  } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+  req.nh.nlmsg_type = RTM_GETQDISC;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.tc.tcm_family = AF_UNSPEC;
+  if (send(nl_fd, &req, req.nh.nlmsg_len, 0) < 0) {
+    close(nl_fd);
+    return -1;
+  }
+
+  char buf[32768];
+  int found = 0;
+  int done = 0;
+  snprintf(qdisc, qdisc_len, "none");
+  while (!done) {
+    int len = recv(nl_fd, buf, sizeof(buf), 0);
+    if (len <= 0) {
+      break;
+    }
+    for (struct nlmsghdr *nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+         nh = NLMSG_NEXT(nh, len)) {
+      if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) {
+        done = 1;
+        break;
+      }
+      struct tcmsg *tc = NLMSG_DATA(nh);
+      if (tc->tcm_ifindex != ifindex || found) {
+        continue;
+      }
+      int attr_len = RTM_PAYLOAD(nh);
+      for (struct rtattr *rta = TCA_RTA(tc); RTA_OK(rta, attr_len);
+           rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type != TCA_KIND) {
+          continue;
+        }
+        const char *kind = RTA_DATA(rta);
+        if (strcmp(kind, "fq") == 0 || strcmp(kind, "etf") == 0) {
+          snprintf(qdisc, qdisc_len, "%s", kind);
+          found = 1;
+        } else if (tc->tcm_parent == TC_H_ROOT) {
+          snprintf(qdisc, qdisc_len, "%s", kind);
+        }
+      }
+    }
+  }
+  close(nl_fd);
+  return found;
+}
+
+// Detects the egress qdisc towards dst_ip and reports whether kernel pacing
+// can be used
+int txtime_init(struct TxTime *txtime, const char *dst_ip, int gso_segments) {
+  memset(txtime, 0, sizeof(*txtime));
+  txtime->clockid = CLOCK_MONOTONIC;
+  txtime->gso_segments = gso_segments < 1 ? 1 : gso_segments;
+  if (txtime->gso_segments > GSO_MAX_SEGMENTS) {
+    txtime->gso_segments = GSO_MAX_SEGMENTS;
+  }
+  snprintf(txtime->ifname, sizeof(txtime->ifname), "?");
+
+  int ifindex = egress_interface(dst_ip, txtime->ifname);
+  if (ifindex <= 0) {
+    printf("[TXTIME] [ERROR] Could not find egress interface for %s, "
+           "falling back to user-space pacing\n",
+           dst_ip);
+    return -1;
+  }
+
+  int found = find_pacing_qdisc(ifindex, txtime->qdisc, sizeof(txtime->qdisc));
+  if (found < 0) {
+    printf("[TXTIME] [ERROR] Could not dump qdiscs of %s, falling back to "
+           "user-space pacing\n",
+           txtime->ifname);
+    return -1;
+  } else if (found == 0) {
+    printf("[TXTIME] [ERROR] %s has no fq/etf qdisc (root qdisc: %s), falling "
+           "back to user-space pacing\n",
+           txtime->ifname, txtime->qdisc);
+    return -1;
+  }
+
+  // etf compares launch times against CLOCK_TAI, fq against CLOCK_MONOTONIC
+  if (strcmp(txtime->qdisc, "etf") == 0) {
+    txtime->clockid = CLOCK_TAI;
+  }
+  txtime->enabled = 1;
+  printf("[TXTIME] %s: qdisc %s, kernel pacing enabled (%s, %d segment(s) "
+         "per send)\n",
+         txtime->ifname, txtime->qdisc,
+         txtime->clockid == CLOCK_TAI ? "CLOCK_TAI" : "CLOCK_MONOTONIC",
+         txtime->gso_segments);
+  return 0;
+}
+
+// Segments that can share a launch time and a datagram
+int txtime_segments(int gso_segments, int payload_size,
+                    int inter_packet_delay_us) {
+  if (inter_packet_delay_us > 0 || gso_segments < 1 || payload_size < 1) {
+    return 1;
+  }
+  int segments = gso_segments;
+  if (segments > GSO_MAX_SEGMENTS) {
+    segments = GSO_MAX_SEGMENTS;
+  }
+  if (segments > UDP_MAX_PAYLOAD / payload_size) {
+    segments = UDP_MAX_PAYLOAD / payload_size;
+  }
+  return segments > 1 ? segments : 1;
+}
+
+// Enables SO_TXTIME on a socket
+int txtime_enable_socket(struct TxTime *txtime, int sock_fd) {
+  struct sock_txtime opt;
+  opt.clockid = txtime->clockid;
+  opt.flags = txtime->clockid == CLOCK_TAI ? SOF_TXTIME_REPORT_ERRORS : 0;
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_TXTIME, &opt, sizeof(opt)) < 0) {
+    perror("[TXTIME] [ERROR] SO_TXTIME not supported, falling back to "
+           "user-space pacing");
+    txtime->enabled = 0;
+    return -1;
+  }
+  return 0;
+}
+
+// Current time on the qdisc clock
+uint64_t txtime_now_ns(struct TxTime *txtime) {
+  struct timespec now;
+  clock_gettime(txtime->clockid, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Sleeps until an absolute launch time on the qdisc clock
+void txtime_sleep_until(struct TxTime *txtime, uint64_t launch_ns) {
+  struct timespec until;
+  until.tv_sec = launch_ns / 1000000000ULL;
+  until.tv_nsec = launch_ns % 1000000000ULL;
+  while (clock_nanosleep(txtime->clockid, TIMER_ABSTIME, &until, NULL) ==
+         EINTR) {
+  }
+}
+
+// Sends a buffer with an SCM_TXTIME launch time and, optionally, a UDP_SEGMENT
+// GSO size
+int send_udp_txtime(int sock_fd, struct sockaddr_in *dst, char *buf, int len,
+                    int gso_size, uint64_t launch_ns) {
+  char control[CMSG_SPACE(sizeof(uint64_t)) + CMSG_SPACE(sizeof(uint16_t))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {.iov_base = buf, .iov_len = len};
+  struct msghdr msg = {0};
+  msg.msg_name = dst;
+  msg.msg_namelen = dst != NULL ? sizeof(*dst) : 0;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(sizeof(uint64_t));
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TXTIME;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+  memcpy(CMSG_DATA(cmsg), &launch_ns, sizeof(launch_ns));
+
+  if (gso_size > 0 && gso_size < len) {
+    msg.msg_controllen += CMSG_SPACE(sizeof(uint16_t));
+    cmsg = CMSG_NXTHDR(&msg, cmsg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segment = (uint16_t)gso_size;
+    memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+  }
+
+  return (int)sendmsg(sock_fd, &msg, 0);
+}
+
+// Counts the packets the qdisc reported as dropped on the error queue
+int txtime_drain_errors(int sock_fd) {
+  int dropped = 0;
+  char control[256];
+  char data[64];
+  for (;;) {
+    struct iovec iov = {.iov_base = data, .iov_len = sizeof(data)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      break;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      struct sock_extended_err *err =
+          (struct sock_extended_err *)CMSG_DATA(cmsg);
+      if (err->ee_origin == SO_EE_ORIGIN_TXTIME) {
+        dropped++;
+      }
+    }
+  }
+  return dropped;
+}
@@ -0,0 +1,100 @@
+#include "../include/wheel.h"
+#include <stddef.h>
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+// Initializes an empty list of timers
+void wheel_list_init(struct WheelTimer *head) {
+  head->next = head;
+  head->prev = head;
+}
+
+// Appends a timer to a list
+static void list_append(struct WheelTimer *head, struct WheelTimer *timer) {
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+// Initializes an empty wheel
+void wheel_init(struct TimerWheel *wheel) {
+  wheel->now = 0;
+  for (int level = 0; level < WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+      wheel_list_init(&wheel->slots[level][slot]);
+    }
+  }
+}
+
+// Puts a timer in the slot of the lowest level whose range covers its delay
+static void place_timer(struct TimerWheel *wheel, struct WheelTimer *timer) {
+  uint64_t delay = timer->expires - wheel->now;
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 &&
+         delay >= 1ULL << (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  int slot = (timer->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  list_append(&wheel->slots[level][slot], timer);
+}
+
+// Arms a timer
+void wheel_add(struct TimerWheel *wheel, struct WheelTimer *timer,
+               uint64_t ticks) {
+  // the slot of the current tick has already been expired
+  if (ticks < 1) {
+    ticks = 1;
+  } else if (ticks > WHEEL_MAX_TICKS) {
+    ticks = WHEEL_MAX_TICKS;
+  }
+  timer->expires = wheel->now + ticks;
+  place_timer(wheel, timer);
+}
+
+// Disarms a timer
+void wheel_remove(struct WheelTimer *timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = timer;
+  timer->prev = timer;
+}
+
+// Re-places the timers of a slot of an upper level, now that their delay
+// fits a lower one
+static void cascade(struct TimerWheel *wheel, int level, int slot) {
+  struct WheelTimer *head = &wheel->slots[level][slot];
+  struct WheelTimer *timer = head->next;
+  wheel_list_init(head);
+  while (timer != head) {
+    struct WheelTimer *next = timer->next;
+    place_timer(wheel, timer);
+    timer = next;
+  }
+}
+
+// Advances the wheel by one tick
+void wheel_tick(struct TimerWheel *wheel, struct WheelTimer *expired) {
+  wheel->now++;
+
+  // when level 0 wraps around, the next slot of level 1 is due (and that of
+  // level 2 if level 1 wraps too). Upper levels cascade first, so their
+  // timers can move all the way down.
+  if ((wheel->now & WHEEL_MASK) == 0) {
+    int top = 1;
+    while (top + 1 < WHEEL_LEVELS &&
+           ((wheel->now >> (WHEEL_BITS * top)) & WHEEL_MASK) == 0) {
+      top++;
+    }
+    for (int level = top; level >= 1; level--) {
+      cascade(wheel, level, (wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    }
+  }
+
+  struct WheelTimer *head = &wheel->slots[0][wheel->now & WHEEL_MASK];
+  while (head->next != head) {
+    struct WheelTimer *timer = head->next;
+    wheel_remove(timer);
+    list_append(expired, timer);
+  }
+}
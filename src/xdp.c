@@ -0,0 +1,758 @@
+#include "../include/xdp.h"
+#include "../include/tsc.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// Frames processed per ring access
+#define XDP_BATCH 64
+
+// Time a missing neighbour entry is waited for after priming it
+#define NEIGHBOUR_WAIT_US 1000000
+
+// One ring of an AF_XDP socket. Producer and consumer indexes are free
+// running; cached_prod and cached_cons hold this side's view of them so the
+// shared cache lines are only read when the ring looks full or empty.
+struct XdpRing {
+  uint32_t *producer;
+  uint32_t *consumer;
+  uint32_t *flags;
+  void *descs; // struct xdp_desc (RX/TX) or uint64_t addresses (fill/comp)
+  uint32_t size;
+  uint32_t cached_prod;
+  uint32_t cached_cons;
+  void *map;
+  size_t map_len;
+};
+
+struct XdpSocket {
+  int fd;
+  char *umem;
+  size_t umem_len;
+  struct XdpRing fill;
+  struct XdpRing comp;
+  struct XdpRing rx;
+  struct XdpRing tx;
+  uint64_t *free_frames; // payload pool: addresses of the free TX frames
+  int free_count;
+  int in_flight; // TX frames not completed yet
+  int pending;   // TX frames queued since the last flush
+  int peeked;    // RX frames handed out by the last xdp_rx_peek
+};
+
+struct XdpSteering {
+  int map_fd;
+  int prog_fd;
+  int link_fd;
+  char log[16384]; // verifier output of the program load
+};
+
+// Acquire/release accesses of the indexes shared with the kernel
+static uint32_t load_index(uint32_t *index) {
+  return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static void store_index(uint32_t *index, uint32_t value) {
+  __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+// Free entries of a ring this side produces to, up to want
+static uint32_t ring_free(struct XdpRing *ring, uint32_t want) {
+  uint32_t free = ring->size - (ring->cached_prod - ring->cached_cons);
+  if (free >= want) {
+    return want;
+  }
+  ring->cached_cons = load_index(ring->consumer);
+  free = ring->size - (ring->cached_prod - ring->cached_cons);
+  return free < want ? free : want;
+}
+
+// Entries available on a ring this side consumes from, up to want
+static uint32_t ring_available(struct XdpRing *ring, uint32_t want) {
+  uint32_t available = ring->cached_prod - ring->cached_cons;
+  if (available == 0) {
+    ring->cached_prod = load_index(ring->producer);
+    available = ring->cached_prod - ring->cached_cons;
+  }
+  return available < want ? available : want;
+}
+
+static uint64_t *addr_at(struct XdpRing *ring, uint32_t index) {
+  return &((uint64_t *)ring->descs)[index & (ring->size - 1)];
+}
+
+static struct xdp_desc *desc_at(struct XdpRing *ring, uint32_t index) {
+  return &((struct xdp_desc *)ring->descs)[index & (ring->size - 1)];
+}
+
+static int ring_needs_wakeup(struct XdpRing *ring) {
+  return *ring->flags & XDP_RING_NEED_WAKEUP;
+}
+
+// Maps one ring of the socket, already sized to size entries of desc_size
+// bytes; off is the part of XDP_MMAP_OFFSETS describing the ring
+static int map_ring(int fd, struct XdpRing *ring, uint32_t size,
+                    size_t desc_size, struct xdp_ring_offset *off,
+                    uint64_t pgoff) {
+  ring->size = size;
+  ring->map_len = off->desc + size * desc_size;
+  ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, pgoff);
+  if (ring->map == MAP_FAILED) {
+    ring->map = NULL;
+    return -1;
+  }
+  ring->producer = (uint32_t *)((char *)ring->map + off->producer);
+  ring->consumer = (uint32_t *)((char *)ring->map + off->consumer);
+  ring->flags = (uint32_t *)((char *)ring->map + off->flags);
+  ring->descs = (char *)ring->map + off->desc;
+  ring->cached_prod = *ring->producer;
+  ring->cached_cons = *ring->consumer;
+  return 0;
+}
+
+static void unmap_ring(struct XdpRing *ring) {
+  if (ring->map != NULL) {
+    munmap(ring->map, ring->map_len);
+  }
+}
+
+// Sets up the rings of a socket: the fill and completion rings of its UMEM
+// are always needed by the kernel, the RX and TX rings only if frames are
+// given to them
+static int setup_rings(struct XdpSocket *xsk, int rx_frames, int tx_frames) {
+  // the fill and completion rings need a size even when unused
+  uint32_t fill_size = rx_frames > 0 ? rx_frames : XDP_BATCH;
+  uint32_t comp_size = tx_frames > 0 ? tx_frames : XDP_BATCH;
+  if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &fill_size,
+                 sizeof(fill_size)) < 0 ||
+      setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &comp_size,
+                 sizeof(comp_size)) < 0) {
+    return -1;
+  }
+  if (rx_frames > 0 && setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &fill_size,
+                                  sizeof(fill_size)) < 0) {
+    return -1;
+  }
+  if (tx_frames > 0 && setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &comp_size,
+                                  sizeof(comp_size)) < 0) {
+    return -1;
+  }
+
+  struct xdp_mmap_offsets off;
+  socklen_t len = sizeof(off);
+  if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) < 0) {
+    return -1;
+  }
+  if (map_ring(xsk->fd, &xsk->fill, fill_size, sizeof(uint64_t), &off.fr,
+               XDP_UMEM_PGOFF_FILL_RING) < 0 ||
+      map_ring(xsk->fd, &xsk->comp, comp_size, sizeof(uint64_t), &off.cr,
+               XDP_UMEM_PGOFF_COMPLETION_RING) < 0) {
+    return -1;
+  }
+  if (rx_frames > 0 && map_ring(xsk->fd, &xsk->rx, fill_size,
+                                sizeof(struct xdp_desc), &off.rx,
+                                XDP_PGOFF_RX_RING) < 0) {
+    return -1;
+  }
+  if (tx_frames > 0 && map_ring(xsk->fd, &xsk->tx, comp_size,
+                                sizeof(struct xdp_desc), &off.tx,
+                                XDP_PGOFF_TX_RING) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+// Opens an AF_XDP socket on one queue of an interface
+struct XdpSocket *xdp_open(int ifindex, int queue, int mode, int rx_frames,
+                           int tx_frames) {
+  struct XdpSocket *xsk = calloc(1, sizeof(struct XdpSocket));
+  if (xsk == NULL) {
+    return NULL;
+  }
+  xsk->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+  if (xsk->fd < 0) {
+    perror("[XDP] [ERROR] AF_XDP socket");
+    free(xsk);
+    return NULL;
+  }
+
+  // the UMEM: rx_frames for the fill ring, then tx_frames for the TX pool
+  int frames = rx_frames + tx_frames;
+  xsk->umem_len = (size_t)frames * XDP_FRAME_SIZE;
+  xsk->umem = mmap(NULL, xsk->umem_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  xsk->free_frames = calloc(tx_frames > 0 ? tx_frames : 1, sizeof(uint64_t));
+  if (xsk->umem == MAP_FAILED || xsk->free_frames == NULL) {
+    perror("[XDP] [ERROR] Failed allocating UMEM");
+    xsk->umem = xsk->umem == MAP_FAILED ? NULL : xsk->umem;
+    xdp_close(xsk);
+    return NULL;
+  }
+  struct xdp_umem_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.addr = (uint64_t)(uintptr_t)xsk->umem;
+  reg.len = xsk->umem_len;
+  reg.chunk_size = XDP_FRAME_SIZE;
+  if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+      setup_rings(xsk, rx_frames, tx_frames) < 0) {
+    perror("[XDP] [ERROR] Failed setting up UMEM and rings");
+    xdp_close(xsk);
+    return NULL;
+  }
+
+  for (int i = 0; i < tx_frames; i++) {
+    xsk->free_frames[i] = (uint64_t)(rx_frames + i) * XDP_FRAME_SIZE;
+  }
+  xsk->free_count = tx_frames;
+  uint32_t posted = ring_free(&xsk->fill, rx_frames);
+  for (uint32_t i = 0; i < posted; i++) {
+    *addr_at(&xsk->fill, xsk->fill.cached_prod++) =
+        (uint64_t)i * XDP_FRAME_SIZE;
+  }
+  store_index(xsk->fill.producer, xsk->fill.cached_prod);
+
+  // generic mode always copies; native mode takes zero-copy if the driver
+  // offers it and copies otherwise
+  struct sockaddr_xdp addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sxdp_family = AF_XDP;
+  addr.sxdp_ifindex = ifindex;
+  addr.sxdp_queue_id = queue;
+  addr.sxdp_flags = XDP_USE_NEED_WAKEUP | (mode == XDP_GENERIC ? XDP_COPY : 0);
+  if (bind(xsk->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    printf("[XDP] [ERROR] Cannot bind to queue %d of interface %d: %s\n",
+           queue, ifindex, strerror(errno));
+    xdp_close(xsk);
+    return NULL;
+  }
+  return xsk;
+}
+
+// Descriptor of the socket
+int xdp_fd(struct XdpSocket *xsk) { return xsk->fd; }
+
+// Peeks the received frames
+int xdp_rx_peek(struct XdpSocket *xsk, struct XdpFrame *frames, int max) {
+  uint32_t count = ring_available(&xsk->rx, max);
+  for (uint32_t i = 0; i < count; i++) {
+    struct xdp_desc *desc = desc_at(&xsk->rx, xsk->rx.cached_cons + i);
+    frames[i].data = xsk->umem + desc->addr;
+    frames[i].len = desc->len;
+  }
+  xsk->peeked = count;
+  return count;
+}
+
+// Returns the peeked frames to the fill ring. The fill ring has room for
+// every frame of the UMEM, so this never waits.
+void xdp_rx_release(struct XdpSocket *xsk, int count) {
+  if (count > xsk->peeked) {
+    count = xsk->peeked;
+  }
+  ring_free(&xsk->fill, count);
+  for (int i = 0; i < count; i++) {
+    uint64_t addr = desc_at(&xsk->rx, xsk->rx.cached_cons + i)->addr;
+    *addr_at(&xsk->fill, xsk->fill.cached_prod++) =
+        addr - addr % XDP_FRAME_SIZE;
+  }
+  xsk->rx.cached_cons += count;
+  store_index(xsk->rx.consumer, xsk->rx.cached_cons);
+  store_index(xsk->fill.producer, xsk->fill.cached_prod);
+  xsk->peeked = 0;
+  if (ring_needs_wakeup(&xsk->fill)) {
+    recvfrom(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+  }
+}
+
+// Reads the drop counters of the socket
+uint32_t xdp_rx_dropped(struct XdpSocket *xsk) {
+  struct xdp_statistics stats;
+  socklen_t len = sizeof(stats);
+  if (getsockopt(xsk->fd, SOL_XDP, XDP_STATISTICS, &stats, &len) < 0) {
+    return 0;
+  }
+  return (uint32_t)(stats.rx_dropped + stats.rx_ring_full);
+}
+
+// Moves the frames of completed sends back to the payload pool
+static void reclaim_frames(struct XdpSocket *xsk) {
+  uint32_t count = ring_available(&xsk->comp, xsk->comp.size);
+  for (uint32_t i = 0; i < count; i++) {
+    xsk->free_frames[xsk->free_count++] =
+        *addr_at(&xsk->comp, xsk->comp.cached_cons + i);
+  }
+  xsk->comp.cached_cons += count;
+  store_index(xsk->comp.consumer, xsk->comp.cached_cons);
+  xsk->in_flight -= count;
+}
+
+// Takes a frame of the payload pool
+char *xdp_tx_frame(struct XdpSocket *xsk) {
+  if (xsk->free_count == 0) {
+    reclaim_frames(xsk);
+    if (xsk->free_count == 0) {
+      return NULL;
+    }
+  }
+  return xsk->umem + xsk->free_frames[--xsk->free_count];
+}
+
+// Queues a frame on the TX ring. The ring is as large as the payload pool,
+// so a frame taken from it always fits.
+void xdp_tx_submit(struct XdpSocket *xsk, char *frame, int len) {
+  ring_free(&xsk->tx, 1);
+  struct xdp_desc *desc = desc_at(&xsk->tx, xsk->tx.cached_prod++);
+  desc->addr = frame - xsk->umem;
+  desc->len = len;
+  desc->options = 0;
+  store_index(xsk->tx.producer, xsk->tx.cached_prod);
+  xsk->in_flight++;
+  xsk->pending++;
+}
+
+// Kicks the kernel to send the queued frames
+void xdp_tx_flush(struct XdpSocket *xsk) {
+  if (xsk->pending == 0) {
+    return;
+  }
+  xsk->pending = 0;
+  if (ring_needs_wakeup(&xsk->tx)) {
+    // EAGAIN/EBUSY only mean the kernel is still busy with earlier frames
+    sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+  }
+}
+
+// Waits until every queued frame was sent
+int xdp_tx_drain(struct XdpSocket *xsk, long long timeout_ns) {
+  long long deadline_ns = tsc_now_ns() + timeout_ns;
+  xdp_tx_flush(xsk);
+  reclaim_frames(xsk);
+  while (xsk->in_flight > 0 && tsc_now_ns() < deadline_ns) {
+    if (ring_needs_wakeup(&xsk->tx)) {
+      sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+    sched_yield();
+    reclaim_frames(xsk);
+  }
+  return xsk->in_flight;
+}
+
+// Closes the socket
+void xdp_close(struct XdpSocket *xsk) {
+  if (xsk == NULL) {
+    return;
+  }
+  unmap_ring(&xsk->fill);
+  unmap_ring(&xsk->comp);
+  unmap_ring(&xsk->rx);
+  unmap_ring(&xsk->tx);
+  if (xsk->fd >= 0) {
+    close(xsk->fd);
+  }
+  if (xsk->umem != NULL) {
+    munmap(xsk->umem, xsk->umem_len);
+  }
+  free(xsk->free_frames);
+  free(xsk);
+}
+
+// Internet checksum of an IPv4 header
+static uint16_t ip_checksum(const uint16_t *words, int count) {
+  uint32_t sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += words[i];
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return (uint16_t)~sum;
+}
+
+// Writes the headers of a probe frame
+int xdp_write_headers(char *frame, struct XdpPath *path, int src_port,
+                      int dst_port, int payload_size, uint16_t ip_id) {
+  unsigned char *eth = (unsigned char *)frame;
+  memcpy(eth, path->dst_mac, 6);
+  memcpy(eth + 6, path->src_mac, 6);
+  eth[12] = 0x08; // IPv4
+  eth[13] = 0x00;
+
+  uint16_t ip[10];
+  ip[0] = htons(0x4500); // version 4, 5 words, no TOS
+  ip[1] = htons(20 + 8 + payload_size);
+  ip[2] = htons(ip_id);
+  ip[3] = htons(0x4000); // DF, as the sockets set IP_PMTUDISC_DO
+  ip[4] = htons(64 << 8 | IPPROTO_UDP);
+  ip[5] = 0;
+  memcpy(&ip[6], &path->src_ip, 4);
+  memcpy(&ip[8], &path->dst_ip, 4);
+  ip[5] = ip_checksum(ip, 10);
+  memcpy(eth + 14, ip, sizeof(ip));
+
+  uint16_t udp[4];
+  udp[0] = htons(src_port);
+  udp[1] = htons(dst_port);
+  udp[2] = htons(8 + payload_size);
+  udp[3] = 0;
+  memcpy(eth + 34, udp, sizeof(udp));
+  return XDP_HEADERS_SIZE;
+}
+
+// Finds the UDP payload of a frame
+int xdp_udp_payload(char *frame, int len, char **payload) {
+  unsigned char *eth = (unsigned char *)frame;
+  if (len < XDP_HEADERS_SIZE || eth[12] != 0x08 || eth[13] != 0x00) {
+    return -1;
+  }
+  int ihl = (eth[14] & 0x0f) * 4;
+  if (eth[14] >> 4 != 4 || ihl < 20 || eth[23] != IPPROTO_UDP ||
+      14 + ihl + 8 > len) {
+    return -1;
+  }
+  int udp_len = eth[14 + ihl + 4] << 8 | eth[14 + ihl + 5];
+  if (udp_len < 8 || 14 + ihl + udp_len > len) {
+    return -1;
+  }
+  *payload = frame + 14 + ihl + 8;
+  return udp_len - 8;
+}
+
+// Asks the kernel for the route towards dst and fills the interface and the
+// next hop (dst itself for on-link and local destinations). *local is set
+// for destinations on this host.
+static int lookup_route(uint32_t dst, int *ifindex, uint32_t *next_hop,
+                        int *local) {
+  int nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (nl_fd < 0) {
+    return -1;
+  }
+  struct {
+    struct nlmsghdr nh;
+    struct rtmsg rt;
+    char attrs[RTA_SPACE(sizeof(uint32_t))];
+  } req;
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req.nh.nlmsg_type = RTM_GETROUTE;
+  req.nh.nlmsg_flags = NLM_F_REQUEST;
+  req.rt.rtm_family = AF_INET;
+  req.rt.rtm_dst_len = 32;
+  struct rtattr *rta = (struct rtattr *)((char *)&req + req.nh.nlmsg_len);
+  rta->rta_type = RTA_DST;
+  rta->rta_len = RTA_LENGTH(sizeof(uint32_t));
+  memcpy(RTA_DATA(rta), &dst, sizeof(dst));
+  req.nh.nlmsg_len += RTA_SPACE(sizeof(uint32_t));
+  if (send(nl_fd, &req, req.nh.nlmsg_len, 0) < 0) {
+    close(nl_fd);
+    return -1;
+  }
+
+  char buf[8192];
+  int len = recv(nl_fd, buf, sizeof(buf), 0);
+  close(nl_fd);
+  struct nlmsghdr *nh = (struct nlmsghdr *)buf;
+  if (len <= 0 || !NLMSG_OK(nh, len) || nh->nlmsg_type != RTM_NEWROUTE) {
+    return -1;
+  }
+  struct rtmsg *rt = NLMSG_DATA(nh);
+  *ifindex = -1;
+  *next_hop = dst;
+  *local = rt->rtm_type == RTN_LOCAL;
+  int attr_len = RTM_PAYLOAD(nh);
+  for (rta = RTM_RTA(rt); RTA_OK(rta, attr_len);
+       rta = RTA_NEXT(rta, attr_len)) {
+    if (rta->rta_type == RTA_OIF) {
+      memcpy(ifindex, RTA_DATA(rta), sizeof(int));
+    } else if (rta->rta_type == RTA_GATEWAY) {
+      memcpy(next_hop, RTA_DATA(rta), sizeof(uint32_t));
+    }
+  }
+  return *ifindex > 0 ? 0 : -1;
+}
+
+// Looks up the MAC of a complete entry of the kernel ARP table
+static int lookup_neighbour(uint32_t ip, const char *ifname, uint8_t *mac) {
+  FILE *arp = fopen("/proc/net/arp", "r");
+  if (arp == NULL) {
+    return -1;
+  }
+  char want[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &ip, want, sizeof(want));
+  char line[256];
+  int found = -1;
+  fgets(line, sizeof(line), arp); // header
+  while (found < 0 && fgets(line, sizeof(line), arp) != NULL) {
+    char addr[64], hw[32], dev[IF_NAMESIZE + 1];
+    unsigned int flags;
+    if (sscanf(line, "%63s %*s %x %31s %*s %16s", addr, &flags, hw, dev) ==
+            4 &&
+        strcmp(addr, want) == 0 && strcmp(dev, ifname) == 0 &&
+        (flags & 0x2) &&
+        sscanf(hw, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1], &mac[2],
+               &mac[3], &mac[4], &mac[5]) == 6) {
+      found = 0;
+    }
+  }
+  fclose(arp);
+  return found;
+}
+
+// Resolves the path towards a destination
+int xdp_resolve_path(const char *dst_ip, struct XdpPath *path) {
+  memset(path, 0, sizeof(*path));
+  struct sockaddr_in dst = {0};
+  dst.sin_family = AF_INET;
+  dst.sin_port = htons(9); // discard
+  if (inet_pton(AF_INET, dst_ip, &dst.sin_addr) <= 0) {
+    return -1;
+  }
+  path->dst_ip = dst.sin_addr.s_addr;
+
+  uint32_t next_hop;
+  int local;
+  if (lookup_route(path->dst_ip, &path->ifindex, &next_hop, &local) < 0 ||
+      if_indextoname(path->ifindex, path->ifname) == NULL) {
+    printf("[XDP] [ERROR] No route to %s\n", dst_ip);
+    return -1;
+  }
+  // frames injected towards a local address are dropped as martians
+  if (local) {
+    printf("[XDP] [ERROR] %s is a local address\n", dst_ip);
+    return -1;
+  }
+
+  // source address: the one the kernel would pick for a connected socket
+  int sock_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_in src = {0};
+  socklen_t len = sizeof(src);
+  if (sock_fd < 0 ||
+      connect(sock_fd, (struct sockaddr *)&dst, sizeof(dst)) < 0 ||
+      getsockname(sock_fd, (struct sockaddr *)&src, &len) < 0) {
+    printf("[XDP] [ERROR] No source address towards %s\n", dst_ip);
+    if (sock_fd >= 0) {
+      close(sock_fd);
+    }
+    return -1;
+  }
+  path->src_ip = src.sin_addr.s_addr;
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", path->ifname);
+  if (ioctl(sock_fd, SIOCGIFHWADDR, &ifr) == 0) {
+    memcpy(path->src_mac, ifr.ifr_hwaddr.sa_data, 6);
+  }
+
+  int found = lookup_neighbour(next_hop, path->ifname, path->dst_mac);
+  for (int waited = 0; found < 0 && waited < NEIGHBOUR_WAIT_US;
+       waited += 10000) {
+    if (waited == 0) {
+      send(sock_fd, "", 0, 0); // has the kernel resolve the next hop
+    }
+    usleep(10000);
+    found = lookup_neighbour(next_hop, path->ifname, path->dst_mac);
+  }
+  close(sock_fd);
+  if (found < 0) {
+    char hop[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &next_hop, hop, sizeof(hop));
+    printf("[XDP] [ERROR] No neighbour entry for %s on %s\n", hop,
+           path->ifname);
+    return -1;
+  }
+  return 0;
+}
+
+static int sys_bpf(int cmd, union bpf_attr *attr) {
+  return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+// Encodings of the few eBPF instructions the steering program needs
+#define INSN(code, dst, src, off, imm)                                        \
+  ((struct bpf_insn){(code), (dst), (src), (off), (imm)})
+#define MOV64_REG(dst, src) INSN(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0)
+#define MOV64_IMM(dst, imm) INSN(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm)
+#define ALU64_IMM(op, dst, imm) INSN(BPF_ALU64 | (op) | BPF_K, dst, 0, 0, imm)
+#define LDX_MEM(size, dst, src, off)                                          \
+  INSN(BPF_LDX | (size) | BPF_MEM, dst, src, off, 0)
+#define JMP_REG(op, dst, src, off)                                            \
+  INSN(BPF_JMP | (op) | BPF_X, dst, src, off, 0)
+#define JMP_IMM(op, dst, imm, off)                                            \
+  INSN(BPF_JMP | (op) | BPF_K, dst, 0, off, imm)
+#define CALL(func) INSN(BPF_JMP | BPF_CALL, 0, 0, 0, func)
+#define EXIT() INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+// Placeholder offset of the jumps to the XDP_PASS exit, patched once the
+// program is assembled
+#define TO_PASS 0x7fff
+
+// Assembles the steering program into insns and returns its length. It is
+// the equivalent of:
+//
+//   if (eth + ip + udp > data_end || ethertype != IPv4 || ihl != 5 ||
+//       protocol != UDP || fragment || udp->dest != port)
+//     return XDP_PASS;
+//   return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+//
+// Packets of queues without a socket in the map fall back to XDP_PASS too.
+static int assemble_program(struct bpf_insn *insns, int map_fd, int port) {
+  int n = 0;
+  insns[n++] = MOV64_REG(BPF_REG_6, BPF_REG_1); // ctx
+  insns[n++] = LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_1,
+                       offsetof(struct xdp_md, data));
+  insns[n++] = LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_1,
+                       offsetof(struct xdp_md, data_end));
+  insns[n++] = MOV64_REG(BPF_REG_4, BPF_REG_2);
+  insns[n++] = ALU64_IMM(BPF_ADD, BPF_REG_4, XDP_HEADERS_SIZE);
+  insns[n++] = JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, TO_PASS);
+  insns[n++] = LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, 12); // ethertype
+  insns[n++] = JMP_IMM(BPF_JNE, BPF_REG_5, htons(0x0800), TO_PASS);
+  insns[n++] = LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_2, 14); // version, ihl
+  insns[n++] = JMP_IMM(BPF_JNE, BPF_REG_5, 0x45, TO_PASS);
+  insns[n++] = LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_2, 23); // protocol
+  insns[n++] = JMP_IMM(BPF_JNE, BPF_REG_5, IPPROTO_UDP, TO_PASS);
+  insns[n++] = LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, 20); // MF, offset
+  insns[n++] = ALU64_IMM(BPF_AND, BPF_REG_5, htons(0x3fff));
+  insns[n++] = JMP_IMM(BPF_JNE, BPF_REG_5, 0, TO_PASS);
+  insns[n++] = LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, 36); // UDP dest
+  insns[n++] = JMP_IMM(BPF_JNE, BPF_REG_5, htons(port), TO_PASS);
+  insns[n++] = LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6,
+                       offsetof(struct xdp_md, rx_queue_index));
+  // 64-bit immediate load of the map, in two instructions
+  insns[n++] = INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD,
+                    0, map_fd);
+  insns[n++] = INSN(0, 0, 0, 0, 0);
+  insns[n++] = MOV64_IMM(BPF_REG_3, XDP_PASS);
+  insns[n++] = CALL(BPF_FUNC_redirect_map);
+  insns[n++] = EXIT();
+  int pass = n;
+  insns[n++] = MOV64_IMM(BPF_REG_0, XDP_PASS);
+  insns[n++] = EXIT();
+
+  for (int i = 0; i < pass; i++) {
+    if (BPF_CLASS(insns[i].code) == BPF_JMP && insns[i].off == TO_PASS) {
+      insns[i].off = pass - i - 1;
+    }
+  }
+  return n;
+}
+
+// Loads and attaches the steering program
+struct XdpSteering *xdp_steer_open(int ifindex, int port, int mode,
+                                   int queues) {
+  struct XdpSteering *steering = calloc(1, sizeof(struct XdpSteering));
+  if (steering == NULL) {
+    return NULL;
+  }
+  steering->prog_fd = -1;
+  steering->link_fd = -1;
+
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof(uint32_t);
+  attr.value_size = sizeof(uint32_t);
+  attr.max_entries = queues;
+  steering->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+  if (steering->map_fd < 0) {
+    perror("[XDP] [ERROR] Cannot create the socket map");
+    free(steering);
+    return NULL;
+  }
+
+  struct bpf_insn insns[32];
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = (uint64_t)(uintptr_t)insns;
+  attr.insn_cnt = assemble_program(insns, steering->map_fd, port);
+  attr.license = (uint64_t)(uintptr_t) "Dual MIT/GPL";
+  attr.log_buf = (uint64_t)(uintptr_t)steering->log;
+  attr.log_size = sizeof(steering->log);
+  attr.log_level = 1;
+  steering->prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+  if (steering->prog_fd < 0) {
+    printf("[XDP] [ERROR] Cannot load the steering program: %s\n%s",
+           strerror(errno), steering->log);
+    xdp_steer_close(steering);
+    return NULL;
+  }
+
+  // a BPF link detaches the program when its last descriptor is closed, so
+  // a crashed server leaves no program behind
+  memset(&attr, 0, sizeof(attr));
+  attr.link_create.prog_fd = steering->prog_fd;
+  attr.link_create.target_ifindex = ifindex;
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags =
+      mode == XDP_GENERIC ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+  steering->link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+  if (steering->link_fd < 0) {
+    printf("[XDP] [ERROR] Cannot attach the steering program to interface "
+           "%d in %s mode: %s\n",
+           ifindex, xdp_mode_name(mode), strerror(errno));
+    xdp_steer_close(steering);
+    return NULL;
+  }
+  return steering;
+}
+
+// Adds a socket to the map of the steering program
+int xdp_steer_add(struct XdpSteering *steering, int queue,
+                  struct XdpSocket *xsk) {
+  uint32_t key = queue;
+  uint32_t value = xsk->fd;
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = steering->map_fd;
+  attr.key = (uint64_t)(uintptr_t)&key;
+  attr.value = (uint64_t)(uintptr_t)&value;
+  attr.flags = BPF_ANY;
+  if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+    perror("[XDP] [ERROR] Cannot add a socket to the map");
+    return -1;
+  }
+  return 0;
+}
+
+// Detaches the steering program
+void xdp_steer_close(struct XdpSteering *steering) {
+  if (steering == NULL) {
+    return;
+  }
+  if (steering->link_fd >= 0) {
+    close(steering->link_fd);
+  }
+  if (steering->prog_fd >= 0) {
+    close(steering->prog_fd);
+  }
+  close(steering->map_fd);
+  free(steering);
+}
+
+// Name of an xdp mode
+const char *xdp_mode_name(int mode) {
+  return mode == XDP_NATIVE ? "native" : "generic";
+}